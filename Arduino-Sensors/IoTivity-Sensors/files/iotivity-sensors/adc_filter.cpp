@@ -0,0 +1,66 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "adc_filter.h"
+
+AdcFilter::AdcFilter()
+{
+	reset();
+}
+
+void AdcFilter::reset()
+{
+	m_next = 0;
+	m_count = 0;
+	m_state = 0;
+	m_value = -1;
+}
+
+unsigned int AdcFilter::median() const
+{
+	uint16_t sorted[ADC_WINDOW];
+	unsigned int n = m_count < ADC_WINDOW ? m_count : ADC_WINDOW;
+
+	// insertion sort, the window is tiny
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int j = i;
+		for (; j > 0 && sorted[j - 1] > m_ring[i]; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = m_ring[i];
+	}
+	return sorted[n / 2];
+}
+
+void AdcFilter::add(unsigned int raw)
+{
+	m_ring[m_next] = raw;
+	m_next = (m_next + 1) % ADC_WINDOW;
+	if (m_count < ADC_WINDOW)
+		m_count++;
+
+	int32_t target = (int32_t)median() << ADC_FRACTION;
+	// the first reading seeds the low pass, so it does not ramp up from 0
+	if (m_value.load(std::memory_order_relaxed) < 0)
+		m_state = target;
+	else
+		m_state += (target - m_state) >> ADC_IIR_SHIFT;
+
+	m_value.store((m_state + (1 << (ADC_FRACTION - 1))) >> ADC_FRACTION, std::memory_order_relaxed);
+}
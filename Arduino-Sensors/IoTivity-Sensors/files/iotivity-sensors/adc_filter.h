@@ -0,0 +1,62 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef ADC_FILTER_H_
+#define ADC_FILTER_H_
+
+#include <stdint.h>
+#include <atomic>
+
+// raw readings the median is taken over; odd
+#define ADC_WINDOW 5
+// the IIR stage moves 1/2^ADC_IIR_SHIFT of the way to each median
+#define ADC_IIR_SHIFT 3
+// fraction bits of the IIR state
+#define ADC_FRACTION 8
+
+// AdcFilter smooths raw ADC readings in two fixed-point stages: the
+// median of the last ADC_WINDOW readings, which drops single spikes
+// outright, then a first order IIR low pass over the medians for the
+// remaining noise. A step shows up after ADC_WINDOW / 2 readings and is
+// 63% through after about 2^ADC_IIR_SHIFT more.
+//
+// add() is meant for one acquisition thread; value() may be called from
+// any thread and never blocks.
+class AdcFilter
+{
+	public:
+	AdcFilter();
+
+	void add(unsigned int raw);
+	// The filtered reading in raw ADC units, or -1 before the first.
+	int value() const { return m_value.load(std::memory_order_relaxed); }
+	void reset();
+
+	private:
+	uint16_t m_ring[ADC_WINDOW];
+	unsigned int m_next;
+	unsigned int m_count;
+	int32_t m_state;
+	std::atomic<int> m_value;
+
+	unsigned int median() const;
+};
+
+#endif /* ADC_FILTER_H_ */
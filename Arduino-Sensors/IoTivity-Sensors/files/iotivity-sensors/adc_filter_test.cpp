@@ -0,0 +1,141 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Noise rejection and step latency of AdcFilter, built with
+// "scons TESTS=1" and run on the host. The noisy readings come from an
+// analog pin of the simulated HAL; the step is fed in directly so the
+// count of readings it takes is exact. Exits non-zero on the first
+// failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <memory>
+#include "hal.h"
+#include "adc_filter.h"
+
+#define TEST_PIN 0
+#define TEST_LEVEL 400
+#define TEST_NOISE 20
+// every 7th reading is full scale, a glitch on the line
+#define TEST_SCRIPT "aio 0 400 noise=20 spike=7\n"
+#define TEST_READINGS 20000
+#define TEST_SETTLE (ADC_WINDOW + 4 * (1 << ADC_IIR_SHIFT))
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+// Readings around TEST_LEVEL with noise and spikes: the spikes must never
+// get through and the noise must shrink well below that of the input.
+static int test_noise_rejection()
+{
+	char script[] = "/tmp/adc_filter_test.XXXXXX";
+	int fd = mkstemp(script);
+
+	CHECK(fd >= 0);
+	CHECK(write(fd, TEST_SCRIPT, sizeof(TEST_SCRIPT) - 1) == sizeof(TEST_SCRIPT) - 1);
+	close(fd);
+
+	std::unique_ptr<Hal> hal(hal_sim_create(script));
+	unlink(script);
+	CHECK(hal != nullptr);
+	std::unique_ptr<HalAio> pin(hal->aio(TEST_PIN));
+	CHECK(pin != nullptr);
+
+	AdcFilter filter;
+	double raw_squares = 0, filtered_squares = 0;
+	int worst = 0, spikes = 0;
+
+	CHECK(filter.value() == -1);
+	for (int i = 0; i < TEST_READINGS; i++) {
+		int raw = pin->read();
+		filter.add(raw);
+		spikes += raw > TEST_LEVEL + TEST_NOISE;
+		if (raw <= TEST_LEVEL + TEST_NOISE)
+			raw_squares += (raw - TEST_LEVEL) * (raw - TEST_LEVEL);
+
+		// the first reading seeds the filter as it comes
+		int error = abs(filter.value() - TEST_LEVEL);
+		filtered_squares += error * error;
+		if (i >= TEST_SETTLE && error > worst)
+			worst = error;
+	}
+
+	// the noise without the spikes, so the comparison favours the input
+	double raw_rms = sqrt(raw_squares / (TEST_READINGS - spikes));
+	double filtered_rms = sqrt(filtered_squares / TEST_READINGS);
+	printf("noise: %d spikes, rms %.2f in, %.2f out, worst %d\n", spikes, raw_rms, filtered_rms, worst);
+	CHECK(spikes > 0);
+	CHECK(worst < TEST_NOISE);
+	CHECK(filtered_rms < raw_rms / 2);
+	return 0;
+}
+
+// A step from 200 to 600: the median holds it back for ADC_WINDOW / 2
+// readings, then the low pass covers 63% of it in about 2^ADC_IIR_SHIFT
+// and settles within a unit in a few times that.
+static int test_step_latency()
+{
+	AdcFilter filter;
+	int half = -1, settled = -1;
+
+	for (int i = 0; i < 100; i++)
+		filter.add(200);
+	CHECK(filter.value() == 200);
+
+	for (int i = 1; i <= 200; i++) {
+		filter.add(600);
+		if (i <= ADC_WINDOW / 2)
+			CHECK(filter.value() == 200);
+		if (half < 0 && filter.value() >= 200 + 400 * 63 / 100)
+			half = i;
+		if (settled < 0 && filter.value() >= 599)
+			settled = i;
+	}
+	printf("step: 63%% after %d readings, settled after %d\n", half, settled);
+	CHECK(half > ADC_WINDOW / 2 && half <= ADC_WINDOW / 2 + (1 << ADC_IIR_SHIFT) + 1);
+	CHECK(settled > 0 && settled <= ADC_WINDOW / 2 + 8 * (1 << ADC_IIR_SHIFT));
+	CHECK(filter.value() == 600);
+
+	// a single spike in a steady signal is dropped by the median
+	filter.add(1023);
+	CHECK(filter.value() == 600);
+
+	// reset starts over from the next reading
+	filter.reset();
+	CHECK(filter.value() == -1);
+	filter.add(123);
+	CHECK(filter.value() == 123);
+	return 0;
+}
+
+int main()
+{
+	if (test_noise_rejection() || test_step_latency())
+		return 1;
+
+	printf("adc_filter_test passed\n");
+	return 0;
+}
@@ -20,11 +20,27 @@
 #include <signal.h>
 #include <glib.h>
 #include <thread>
+#include <chrono>
+#include <vector>
 #include <functional>
 #include "iotivity-sensors.h"
+#include "node_config.h"
+#include "async_log.h"
 #include <unistd.h>
 
-Resource::Resource() : inPresence(false), presenceTimer(0)
+// -p: notify every PRESENCE_CYCLE whether or not anything changed, as
+// before the on-change mode
+static bool periodic = false;
+
+static uint64_t monotonic_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Resource::Resource(const std::string &name, const std::string &uri, int pin) : inPresence(false),
+	presenceTimer(0), m_name(name), m_uri(uri), m_pinNumber(pin), m_version(0), m_notifiedVersion(0),
+	m_notifiedAt(0)
 {
 
 }
@@ -58,44 +74,41 @@ void Resource::stopPresence(void)
 OCEntityHandlerResult Resource::entityHandler(std::shared_ptr<OCResourceRequest> request)
 {
 	OCEntityHandlerResult ehResult = OC_EH_ERROR;
-	cout << "\tIn Resource entity handler:\n";
+	ALOG_DEBUG("\tIn Resource entity handler:");
 
 	if (request) {
 		std::string requestType = request->getRequestType();
 		int requestFlag = request->getRequestHandlerFlag();
 
 		if (requestFlag & RequestHandlerFlag::RequestFlag) {
-			cout << "\t\trequestFlag : Request\n";
+			ALOG_DEBUG("\t\trequestFlag : Request");
 			
 			if (requestType == "GET") {
-				cout << "\t\t\trequestType : GET\n";
+				ALOG_DEBUG("\t\t\trequestType : GET");
+				std::lock_guard<std::mutex> lock(m_lock);
+				sample();
 			}
 			else if (requestType == "PUT") {
-				cout << "\t\t\trequestType : PUT\nh";
+				ALOG_DEBUG("\t\t\trequestType : PUT");
 				OCRepresentation rep = request->getResourceRepresentation();
+				std::lock_guard<std::mutex> lock(m_lock);
 				put(rep);
 			}
 		}
 
 		if (requestFlag & RequestHandlerFlag::ObserverFlag) {
-			cout << "\t\trequestFlag : Observer\n";
+			ALOG_DEBUG("\t\trequestFlag : Observer");
 			ObservationInfo observationInfo = request->getObservationInfo();
+			std::lock_guard<std::mutex> lock(m_lock);
 			if (ObserveAction::ObserveRegister == observationInfo.action) {
-				cout << "\t\t\trequestType : Register Observer; ID = " << observationInfo.obsId << endl;
-				if (std::find(m_interestedObservers.begin(),
-						m_interestedObservers.end(),
-						observationInfo.obsId) == m_interestedObservers.end())
-					m_interestedObservers.push_back(observationInfo.obsId);
-				if (1 == m_interestedObservers.size())
+				ALOG_INFO("\t\t\trequestType : Register Observer; ID = {}", observationInfo.obsId);
+				m_interestedObservers.add(observationInfo.obsId);
+				if (1 == m_interestedObservers.size() && periodic)
 					startPresence(PRESENCE_CYCLE);
 			}
 			else if (ObserveAction::ObserveUnregister == observationInfo.action) {
-				cout << "\t\t\trequestType : UNregister Observer; ID = " << observationInfo.obsId << endl;
-				m_interestedObservers.erase(std::remove(
-									m_interestedObservers.begin(),
-									m_interestedObservers.end(),
-									observationInfo.obsId),
-									m_interestedObservers.end());
+				ALOG_INFO("\t\t\trequestType : UNregister Observer; ID = {}", observationInfo.obsId);
+				m_interestedObservers.remove(observationInfo.obsId);
 				if (0 == m_interestedObservers.size())
 					stopPresence();
 			}
@@ -107,10 +120,13 @@ OCEntityHandlerResult Resource::entityHandler(std::shared_ptr<OCResourceRequest>
 			pResponse->setResourceHandle(request->getResourceHandle());
 			pResponse->setErrorCode(200);
 			pResponse->setResponseResult(OC_EH_OK);
-			pResponse->setResourceRepresentation(get());
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				pResponse->setResourceRepresentation(get());
+			}
 			if (OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
 				ehResult = OC_EH_OK;
-				cout << "\t\t\tsendResponse successfully\n";
+				ALOG_DEBUG("\t\t\tsendResponse successfully");
 			}
 		}
 	}
@@ -118,39 +134,75 @@ OCEntityHandlerResult Resource::entityHandler(std::shared_ptr<OCResourceRequest>
 	return ehResult;
 }
 
+// Sends the current state; called with m_lock held. get() only runs when
+// the state changed since it was last encoded.
+OCStackResult Resource::send(uint64_t now)
+{
+	m_notifiedVersion = m_version;
+	m_notifiedAt = now;
+	return m_notify.notify(m_resourceHandle,
+						m_interestedObservers.ids(),
+						m_version,
+						[this]() { return get(); },
+						QualityOfService::LowQos);
+}
+
 OCStackResult Resource::notify()
 {
-	shared_ptr<OCResourceResponse> resourceResponse(
-					new OCResourceResponse());
-	resourceResponse->setErrorCode(200);
-	resourceResponse->setResourceRepresentation(get(), DEFAULT_INTERFACE);
+	std::lock_guard<std::mutex> lock(m_lock);
 
-	return OCPlatform::notifyListOfObservers(m_resourceHandle,
-						m_interestedObservers,
-						resourceResponse,
-						QualityOfService::LowQos);
+	sample();
+	return send(monotonic_ms());
+}
+
+void Resource::poll(uint64_t now, uint64_t heartbeat)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	sample();
+	if (m_interestedObservers.empty())
+		return;
+	if (m_version != m_notifiedVersion || now - m_notifiedAt >= heartbeat)
+		send(now);
+}
+
+void Resource::schedule(SampleScheduler &scheduler, bool onChange, unsigned int rate,
+	uint64_t heartbeat)
+{
+	if (onChange)
+		scheduler.add(rate, [this, heartbeat](uint64_t now) { poll(now, heartbeat); });
+}
+
+bool Resource::track(int &value, int reading, int deadband)
+{
+	if (abs(reading - value) <= deadband)
+		return false;
+
+	value = reading;
+	m_version++;
+	return true;
 }
 
-FanResource::FanResource() : 
-	m_fanState(false)
+FanResource::FanResource(const std::string &name, const std::string &uri, int pin) :
+	Resource(name, uri, pin), m_fanState(false), m_pin(NULL)
 {
-	m_rep.setUri(string(FAN_RESOURCE_URI));
-	m_rep.setValue("name", string("fan"));
+	m_rep.setUri(m_uri);
+	m_rep.setValue("name", m_name);
 	m_rep.setValue("fanstate", "off");
 }
 
 FanResource::~FanResource()
 {
 	if (m_pin != NULL){
-		mraa_gpio_write(m_pin, 0);
-		mraa_gpio_close(m_pin);
+		m_pin->write(0);
+		delete m_pin;
 	}
 }
 
 void FanResource::createResource()
 {
 	uint8_t resourceFlag = OC_DISCOVERABLE | OC_OBSERVABLE;
-	std::string resourceUri = FAN_RESOURCE_URI;
+	std::string resourceUri = m_uri;
 	std::string resourceType = FAN_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
 
@@ -166,7 +218,7 @@ void FanResource::createResource()
 		throw std::runtime_error(
 			std::string("Failed to register Fan Resource")+std::to_string(result));
 	} else {
-		cout << "Successfully created Fan resource " << m_resourceHandle << endl;
+		ALOG_INFO("Successfully created Fan resource {} at {}", m_resourceHandle, m_uri);
 	}
 }
 
@@ -182,49 +234,51 @@ void FanResource::put(OCRepresentation& rep)
 	
 	try {
 		rep.getValue("fanstate", fanState);
+		if (m_fanState != (fanState == "on"))
+			m_version++;
 		m_fanState = fanState == "on" ? true : false;
 	}
 	catch (OC::OCException& e) {
-		cout << "Exception in put: " << e.what() << endl;
+		ALOG_WARN("Exception in put: {}", e.what());
 	}
 
 	if (m_pin != NULL) {
 		if (m_fanState)
-			mraa_gpio_write(m_pin, 1);
+			m_pin->write(1);
 		else
-			mraa_gpio_write(m_pin, 0);
+			m_pin->write(0);
 	}
 }
 
-bool FanResource::setup_hardware(void)
+bool FanResource::setup_hardware(Hal *hal)
 {
-	m_pin = mraa_gpio_init(FANPIN);
+	m_pin = hal->gpio(m_pinNumber);
 	if (m_pin != NULL) {
-		mraa_gpio_dir(m_pin, MRAA_GPIO_OUT);
-		mraa_gpio_write(m_pin, 0);
+		m_pin->setOutput(true);
+		m_pin->write(0);
 		return true;
 	}
 	return false;
 }
 
-GasResource::GasResource() : 
-	m_density(0)
+GasResource::GasResource(const std::string &name, const std::string &uri, int pin) :
+	Resource(name, uri, pin), m_deadband(GAS_DEADBAND), m_adcRate(ADC_RATE), m_density(0), m_pin(NULL)
 {
-	m_rep.setUri(GAS_RESOURCE_URI);
-	m_rep.setValue("name", string("gas"));
+	m_rep.setUri(m_uri);
+	m_rep.setValue("name", m_name);
 	m_rep.setValue("density", (int)m_density);
 }
 
+// The sampling thread is stopped before the resources go.
 GasResource::~GasResource()
 {
-	if (m_pin != NULL)
-		mraa_aio_close(m_pin);
+	delete m_pin;
 }
 
 void GasResource::createResource()
 {
 	uint8_t resourceFlag = OC_DISCOVERABLE | OC_OBSERVABLE;
-	std::string resourceUri = GAS_RESOURCE_URI;
+	std::string resourceUri = m_uri;
 	std::string resourceType = GAS_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
 
@@ -240,45 +294,65 @@ void GasResource::createResource()
 		throw std::runtime_error(
 			std::string("Failed to register Gas Resource")+std::to_string(result));
 	} else {
-		cout << "Successfully created Gas resource " << m_resourceHandle << endl;
+		ALOG_INFO("Successfully created Gas resource {} at {}", m_resourceHandle, m_uri);
 	}
 }
 
+// The ADC task is the only reader of the ADC; requests and the readings
+// just load what it last filtered.
+void GasResource::schedule(SampleScheduler &scheduler, bool onChange, unsigned int rate,
+	uint64_t heartbeat)
+{
+	if (m_pin != NULL) {
+		m_filter.reset();
+		scheduler.add(m_adcRate, [this](uint64_t) { m_filter.add(m_pin->read()); });
+	}
+	Resource::schedule(scheduler, onChange, rate, heartbeat);
+}
+
+void GasResource::sample(void)
+{
+	int raw = m_filter.value();
+
+	if (raw >= 0)
+		track(m_density, raw * 500 / 1024, m_deadband);
+}
+
 OCRepresentation GasResource::get(void)
 {
-	if (m_pin != NULL)
-		m_density = mraa_aio_read(m_pin) * 500 / 1024;
 	m_rep.setValue("density", m_density);
 	return m_rep;
 }
 
-bool GasResource::setup_hardware(void)
+bool GasResource::setup_hardware(Hal *hal)
 {
-	m_pin = mraa_aio_init(GASPIN);
+	m_pin = hal->aio(m_pinNumber);
 	if (m_pin != NULL) {
-		mraa_aio_set_bit(m_pin, 10);
+		m_pin->setBits(10);
 		return true;
 	}
 	return false;
 }
 
-PirResource::PirResource() : m_motion(false)
+PirResource::PirResource(const std::string &name, const std::string &uri, int pin) :
+	Resource(name, uri, pin), m_motion(false), m_changedAt(0), m_timestamp(0), m_interrupts(false),
+	m_pin(NULL)
 {
-	m_rep.setUri(PIR_RESOURCE_URI);
-	m_rep.setValue("name", string("pri"));
+	m_rep.setUri(m_uri);
+	m_rep.setValue("name", m_name);
 	m_rep.setValue("motion", m_motion);
 }
 
 PirResource::~PirResource()
 {
-	if (m_pin != NULL)
-		mraa_gpio_close(m_pin);
+	// stops the edge handler first
+	delete m_pin;
 }
 
 void PirResource::createResource()
 {
 	uint8_t resourceFlag = OC_DISCOVERABLE | OC_OBSERVABLE;
-	std::string resourceUri = PIR_RESOURCE_URI;
+	std::string resourceUri = m_uri;
 	std::string resourceType = PIR_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
 
@@ -294,53 +368,82 @@ void PirResource::createResource()
 		throw std::runtime_error(
 			std::string("Failed to register Motion Resource")+std::to_string(result));
 	} else {
-		cout << "Successfully created Motion resource " << m_resourceHandle << endl;
+		ALOG_INFO("Successfully created Motion resource {} at {}", m_resourceHandle, m_uri);
 	}
 }
 
-OCRepresentation PirResource::get(void)
+// Takes the pin level as the motion state unless the state changed less
+// than PIR_DEBOUNCE ms ago; called with m_lock held.
+bool PirResource::update(bool motion, uint64_t now)
 {
-	if (m_pin != NULL) {
-		if (mraa_gpio_read(m_pin) > 0)
-			m_motion = true;
-		else
-			m_motion = false;
+	if (motion == m_motion || now - m_changedAt < PIR_DEBOUNCE)
+		return false;
+
+	m_motion = motion;
+	m_changedAt = now;
+	m_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	m_version++;
+	return true;
+}
+
+// Runs on the HAL's interrupt thread for every edge of the PIR pin and
+// publishes a change straight away.
+void PirResource::edge(void *context)
+{
+	PirResource *pir = (PirResource *)context;
+	uint64_t now = monotonic_ms();
+	std::lock_guard<std::mutex> lock(pir->m_lock);
+
+	if (pir->update(pir->m_pin->read() > 0, now) && !pir->m_interestedObservers.empty()) {
+		pir->send(now);
+		ALOG_DEBUG("Motion {} notified {} ms after the edge", pir->m_motion, monotonic_ms() - now);
 	}
+}
+
+// With interrupts this only catches an edge the debounce held back, as
+// the end of a pulse shorter than PIR_DEBOUNCE.
+void PirResource::sample(void)
+{
+	if (m_pin != NULL)
+		update(m_pin->read() > 0, monotonic_ms());
+}
+
+OCRepresentation PirResource::get(void)
+{
 	m_rep.setValue("motion", m_motion);
+	// ms since the epoch of the last change; a double keeps it exact
+	if (m_timestamp)
+		m_rep.setValue("timestamp", (double)m_timestamp);
 	return m_rep;
 }
 
-bool PirResource::setup_hardware(void)
+bool PirResource::setup_hardware(Hal *hal)
 {
-	m_pin = mraa_gpio_init(PIRPIN);
+	m_pin = hal->gpio(m_pinNumber);
 	if (m_pin != NULL) {
-		mraa_gpio_dir(m_pin, MRAA_GPIO_IN);
+		m_pin->setOutput(false);
+		if (m_pin->watch(HAL_EDGE_BOTH, &PirResource::edge, this))
+			m_interrupts = true;
+		else
+			ALOG_WARN("No interrupts on motion pin {}, polling it", m_pinNumber);
 		return true;
 	}
 	return true;
 }
 
-static void onFanRegister(const HeaderOptions& headerOptions,
-			const OCRepresentation& rep, const int eCode)
-{
-	if (eCode == OC_STACK_OK) {
-		cout << "Successfully regitered Fan resource.\n";
-	}
-}
+// The rest is the daemon around the resources; the host tests link the
+// resources without it.
+#ifndef IOTIVITY_SENSORS_NO_MAIN
 
-static void onGasRegister(const HeaderOptions& headerOptions,
-			const OCRepresentation& rep, const int eCode)
-{
-	if (eCode == OC_STACK_OK) {
-		cout << "Successfully regitered Gas resource.\n";
-	}
-}
+// name=type of every sensor, as the gateway takes them
+static std::string registration;
 
-static void onPirRegister(const HeaderOptions& headerOptions,
+static void onRegister(const HeaderOptions& headerOptions,
 			const OCRepresentation& rep, const int eCode)
 {
 	if (eCode == OC_STACK_OK) {
-		cout << "Successfully regitered Motion resource.\n";
+		ALOG_INFO("Successfully registered the node's sensors.");
 	}
 }
 
@@ -350,52 +453,119 @@ static void foundHG(std::shared_ptr<OCResource> resource)
 	string hostAddress;
 	try {
 		if (resource) {
-			cout << "Discovered resource: \n";
+			ALOG_INFO("Discovered resource:");
 			resourceURI = resource->uri();
-			cout << "\tURI: " << resourceURI << endl;
+			ALOG_INFO("\tURI: {}", resourceURI);
 
 			hostAddress = resource->host();
-			cout << "\tAddress: " << hostAddress << endl;
+			ALOG_INFO("\tAddress: {}", hostAddress);
 
 			for (auto &resourceTypes : resource->getResourceTypes()) {
-				cout << "\tType: " << resourceTypes << endl;
+				ALOG_INFO("\tType: {}", resourceTypes);
 				if (resourceTypes == HG_DISCOVER_RESOURCE_TYPE) {
-					OCRepresentation fanRep, gasRep, pirRep;
-					fanRep.setValue("name", string("fan"));
-					fanRep.setValue("address", string(FAN_RESOURCE_TYPE));
-					resource->put(fanRep, QueryParamsMap(), &onFanRegister);
-					
-					gasRep.setValue("name", string("gas"));
-					gasRep.setValue("address", string(GAS_RESOURCE_TYPE));
-					resource->put(gasRep, QueryParamsMap(), &onGasRegister);
-					
-					pirRep.setValue("name", string("pri"));
-					pirRep.setValue("address", string(PIR_RESOURCE_TYPE));
-					resource->put(pirRep, QueryParamsMap(), &onPirRegister);
+					// one PUT registers all of the node's sensors
+					OCRepresentation rep;
+					rep.setValue("sensors", registration);
+					resource->put(rep, QueryParamsMap(), &onRegister);
 				}
 			}
 		}
 	}
 	catch (OC::OCException& e) {
-		cout << "Exception in foundHG: " << e.what() << endl;
+		ALOG_WARN("Exception in foundHG: {}", e.what());
 	}
 }
 
 GMainLoop *loop;
 
+static Resource *resource_create(const sensor_config &config)
+{
+	if (config.type == "fan")
+		return new FanResource(config.name, config.uri, config.pin);
+	if (config.type == "gas") {
+		GasResource *gas = new GasResource(config.name, config.uri, config.pin);
+		gas->m_deadband = config.deadband;
+		gas->m_adcRate = config.adcRate;
+		return gas;
+	}
+	return new PirResource(config.name, config.uri, config.pin);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-c config] [-p] [-r rate] [-b heartbeat] [-d deadband] [-a adc rate]\n"
+		"  -c  file of the node's sensors, one per line, instead of a fan on pin %d,\n"
+		"      a gas sensor on analog pin %d and a motion sensor on pin %d:\n"
+		"      <type> <pin> [<uri>] [name=<name>] [rate=<hz>] [deadband=<n>] [adc=<hz>]\n"
+		"  -p  notify every %d s instead of on change\n"
+		"  -r  readings per second (%d)\n"
+		"  -b  seconds between notifications of an unchanged reading (%d)\n"
+		"  -d  change of the gas density that is notified (%d)\n"
+		"  -a  gas sensor ADC readings per second, filtered (%d)\n"
+		"The pins come from %s=mraa or %s=sim[:<script>] (%s).\n",
+		name, FANPIN, GASPIN, PIRPIN, PRESENCE_CYCLE, SAMPLE_RATE, HEARTBEAT, GAS_DEADBAND, ADC_RATE,
+		HAL_ENV, HAL_ENV, HAL_DEFAULT);
+}
+
 void handle_signal(int signal)
 {
 	g_main_loop_quit(loop);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+	unsigned int rate = SAMPLE_RATE, heartbeat = HEARTBEAT, adcRate = ADC_RATE;
+	int deadband = GAS_DEADBAND, opt;
+	std::string configPath, error;
+	std::vector<sensor_config> configs;
+
+	while ((opt = getopt(argc, argv, "c:pr:b:d:a:")) != -1) {
+		switch (opt) {
+		case 'c':
+			configPath = optarg;
+			break;
+		case 'p':
+			periodic = true;
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'b':
+			heartbeat = atoi(optarg);
+			break;
+		case 'd':
+			deadband = atoi(optarg);
+			break;
+		case 'a':
+			adcRate = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (rate == 0 || heartbeat == 0 || deadband < 0 || adcRate == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (configPath.empty())
+		configs = node_config_default();
+	else if (!node_config_load(configPath, configs, error)) {
+		ALOG_ERROR("Bad sensor config: {}", error);
+		return 1;
+	}
+	if (!node_config_resolve(configs, error)) {
+		ALOG_ERROR("Bad sensor config: {}", error);
+		return 1;
+	}
+
 	struct sigaction sa;
 	sigfillset(&sa.sa_mask);
 	sa.sa_flags = 0;
 	sa.sa_handler = handle_signal;
 	sigaction(SIGINT, &sa, NULL);
-	cout << "Press Ctrl-C to quit....\n";
+	ALOG_INFO("Press Ctrl-C to quit....");
 
 	PlatformConfig cfg
 	{
@@ -407,33 +577,56 @@ int main()
 	};
 	OCPlatform::Configure(cfg);
 	
-	FanResource fan;
-	if (!fan.setup_hardware())
-		cerr << "Failed to setup fan pin." << endl;
-	fan.createResource();
-
-	GasResource gas;
-	if (!gas.setup_hardware())
-		cerr << "Failed to setup gas pin." << endl;
-	gas.createResource();
-	
-	PirResource pir;
-	if (!pir.setup_hardware())
-		cerr << "Failed to setup motion pin." << endl;
-	pir.createResource();
-	
+	// declared ahead of the resources, so their pins go first
+	std::unique_ptr<Hal> hal(hal_create_default());
+	if (!hal) {
+		ALOG_ERROR("No hardware backend, see {}", HAL_ENV);
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<Resource> > resources;
+	for (auto &config : configs) {
+		if (config.rate == 0)
+			config.rate = rate;
+		if (config.deadband < 0)
+			config.deadband = deadband;
+		if (config.adcRate == 0)
+			config.adcRate = adcRate;
+
+		resources.emplace_back(resource_create(config));
+		if (!resources.back()->setup_hardware(hal.get()))
+			ALOG_ERROR("Failed to setup pin {} of {}.", config.pin, config.name);
+		resources.back()->createResource();
+
+		if (!registration.empty())
+			registration += ",";
+		registration += config.name + "=" + config.resourceType;
+	}
+
+	// declared after the resources, so it stops before they go
+	SampleScheduler scheduler;
+	for (size_t i = 0; i < resources.size(); i++)
+		resources[i]->schedule(scheduler, !periodic, configs[i].rate, heartbeat * 1000ULL);
+	ALOG_INFO("Sampling {} sensors with {} tasks, heartbeat every {} s", resources.size(),
+		scheduler.size(), heartbeat);
+	scheduler.start();
+
 	try {
 		std::ostringstream hgURI;
 		hgURI << OC_MULTICAST_DISCOVERY_URI << "?rt=" << HG_DISCOVER_RESOURCE_TYPE;
 		OCPlatform::findResource("", hgURI.str(), OC_ALL, &foundHG);
-		cout << "Finding HomeGateway.....\n";
+		ALOG_INFO("Finding HomeGateway.....");
 	}
 	catch (OC::OCException& e) {
-		cout << "Exception in main: " << e.what() << endl;
+		ALOG_ERROR("Exception in main: {}", e.what());
 	}
-	
+
 	loop = g_main_loop_new(NULL, FALSE);
 	g_main_loop_run(loop);
 
+	scheduler.stop();
+
 	return 0;
 }
+
+#endif /* IOTIVITY_SENSORS_NO_MAIN */
@@ -24,10 +24,16 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <glib.h>
 #include "ocstack.h"
 #include "OCPlatform.h"
 #include "OCApi.h"
-#include "mraa.h"
+#include "hal.h"
+#include "observer_set.h"
+#include "notify_mux.h"
+#include "adc_filter.h"
+#include "sample_scheduler.h"
 
 using namespace std;
 using namespace OC;
@@ -41,7 +47,19 @@ using namespace OC;
 #define HG_DISCOVER_RESOURCE_TYPE "gw.sensor"
 #define HG_CONFIGURATION_RESOURCE_TYPE "gw.config"
 #define PRESENCE_CYCLE 2
+// on-change mode: readings are taken SAMPLE_RATE times a second and only
+// a move past the deadband is notified, or HEARTBEAT seconds of quiet;
+// the gateway takes a sensor for gone after 5 s without a notification
+#define SAMPLE_RATE 20
+#define HEARTBEAT 4
+#define GAS_DEADBAND 5
+// the gas ADC is read this many times a second, on the sampling thread,
+// and filtered; the readings above take the latest filtered value
+#define ADC_RATE 200
+// motion edges closer than this to the last change are contact bounce
+#define PIR_DEBOUNCE 50
 
+// the sensors of a node without a config file, see node_config.h
 #define FANPIN 9
 #define GASPIN 0
 #define PIRPIN 2
@@ -49,17 +67,44 @@ using namespace OC;
 class Resource
 {
 public:
-	Resource();
+	Resource(const std::string &name, const std::string &uri, int pin);
+	virtual ~Resource() {}
+	virtual bool setup_hardware(Hal *hal) = 0;
+	virtual void createResource() = 0;
+	// Adds the resource's periodic work to the node's sampling thread,
+	// in on-change mode its readings 'rate' times a second.
+	virtual void schedule(SampleScheduler &scheduler, bool onChange, unsigned int rate,
+		uint64_t heartbeat);
 	OCStackResult notify(void);
+	// On-change mode, from the sampling thread: takes a reading and
+	// notifies the observers when it moved past its deadband or nothing
+	// was sent for 'heartbeat' ms.
+	void poll(uint64_t now, uint64_t heartbeat);
 	bool inPresence;
 	guint presenceTimer;
 	void startPresence(unsigned int interval);
 	void stopPresence(void);
+	std::string m_name;
+	std::string m_uri;
+	int m_pinNumber;
 protected:
 	OCResourceHandle m_resourceHandle;
 	OCRepresentation m_rep;
-	ObservationIds m_interestedObservers;
+	ObserverSet m_interestedObservers;
+	// bumped by the subclasses whenever get() would return something new
+	unsigned int m_version;
+	NotifyMux m_notify;
+	unsigned int m_notifiedVersion;
+	uint64_t m_notifiedAt;
+	// held around the readings, get(), put() and the observers; the
+	// stack's thread and the sampling thread both use them
+	std::mutex m_lock;
 	OCEntityHandlerResult entityHandler(std::shared_ptr<OCResourceRequest> request);
+	OCStackResult send(uint64_t now);
+	// Moves 'value' to 'reading' if that is more than 'deadband' away.
+	bool track(int &value, int reading, int deadband);
+	// Reads the hardware into what get() reports.
+	virtual void sample(void) {}
 	virtual OCRepresentation get(void) = 0;
 	virtual void put(OCRepresentation& rep) = 0;
 };
@@ -67,13 +112,13 @@ protected:
 class FanResource : public Resource
 {
 public:
-	FanResource();
+	FanResource(const std::string &name, const std::string &uri, int pin);
 	~FanResource();
-	bool setup_hardware(void);
+	bool setup_hardware(Hal *hal);
 	void createResource();
 private:
 	bool m_fanState;
-	mraa_gpio_context m_pin;
+	HalGpio *m_pin;
 protected:
 	OCRepresentation get(void);
 	void put(OCRepresentation& rep); 
@@ -82,14 +127,21 @@ protected:
 class GasResource : public Resource
 {
 public:
-	GasResource();
+	GasResource(const std::string &name, const std::string &uri, int pin);
 	~GasResource();
-	bool setup_hardware(void);
+	bool setup_hardware(Hal *hal);
 	void createResource();
+	// Also oversamples the ADC m_adcRate times a second.
+	void schedule(SampleScheduler &scheduler, bool onChange, unsigned int rate,
+		uint64_t heartbeat);
+	int m_deadband;
+	unsigned int m_adcRate;
 private:
 	int m_density;
-	mraa_aio_context m_pin;
+	HalAio *m_pin;
+	AdcFilter m_filter;
 protected:
+	void sample(void);
 	OCRepresentation get(void);
 	void put(OCRepresentation& rep){};
 };
@@ -97,14 +149,20 @@ protected:
 class PirResource : public Resource
 {
 public:
-	PirResource();
+	PirResource(const std::string &name, const std::string &uri, int pin);
 	~PirResource();
-	bool setup_hardware(void);
+	bool setup_hardware(Hal *hal);
 	void createResource();
 private:
 	bool m_motion;
-	mraa_gpio_context m_pin;
+	uint64_t m_changedAt;
+	int64_t m_timestamp;
+	bool m_interrupts;
+	HalGpio *m_pin;
+	bool update(bool motion, uint64_t now);
+	static void edge(void *context);
 protected:
+	void sample(void);
 	OCRepresentation get(void);
 	void put(OCRepresentation& rep){};
 };
@@ -0,0 +1,184 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include "node_config.h"
+#include "iotivity-sensors.h"
+
+static const struct
+{
+	const char *type;
+	const char *uri;
+	const char *name;
+	const char *resourceType;
+	// analog, so its pin numbers are apart from the GPIOs'
+	bool analog;
+} sensor_types[] = {
+	{ "fan", FAN_RESOURCE_URI, "fan", FAN_RESOURCE_TYPE, false },
+	{ "gas", GAS_RESOURCE_URI, "gas", GAS_RESOURCE_TYPE, true },
+	{ "pir", PIR_RESOURCE_URI, "pri", PIR_RESOURCE_TYPE, false },
+};
+
+static bool config_option(const std::string &word, const char *key, std::string &value)
+{
+	size_t length = strlen(key);
+
+	if (word.compare(0, length, key) != 0)
+		return false;
+	value = word.substr(length);
+	return true;
+}
+
+static bool config_line(std::istringstream &words, sensor_config &sensor)
+{
+	std::string word, value;
+	char *end;
+
+	if (!(words >> sensor.type >> sensor.pin) || sensor.pin < 0)
+		return false;
+	sensor.rate = 0;
+	sensor.deadband = -1;
+	sensor.adcRate = 0;
+	while (words >> word) {
+		if (word[0] == '/' && sensor.uri.empty()) {
+			sensor.uri = word;
+		}
+		else if (config_option(word, "name=", value) && !value.empty()) {
+			sensor.name = value;
+		}
+		else if (config_option(word, "rate=", value)) {
+			sensor.rate = strtoul(value.c_str(), &end, 10);
+			if (*end || sensor.rate == 0)
+				return false;
+		}
+		else if (config_option(word, "deadband=", value)) {
+			sensor.deadband = strtol(value.c_str(), &end, 10);
+			if (*end || sensor.deadband < 0)
+				return false;
+		}
+		else if (config_option(word, "adc=", value)) {
+			sensor.adcRate = strtoul(value.c_str(), &end, 10);
+			if (*end || sensor.adcRate == 0)
+				return false;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool node_config_load(const std::string &path, std::vector<sensor_config> &sensors, std::string &error)
+{
+	std::ifstream file(path.c_str());
+	std::string line;
+	int number = 0;
+
+	if (!file) {
+		error = "cannot read " + path;
+		return false;
+	}
+	while (std::getline(file, line)) {
+		std::string text = line.substr(0, line.find('#'));
+		std::istringstream words(text);
+		sensor_config sensor;
+
+		number++;
+		if (text.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		if (!config_line(words, sensor)) {
+			error = path + ":" + std::to_string(number) + ": cannot make sense of \"" + line + "\"";
+			return false;
+		}
+		sensors.push_back(sensor);
+	}
+	if (sensors.empty()) {
+		error = path + " has no sensors";
+		return false;
+	}
+	return true;
+}
+
+std::vector<sensor_config> node_config_default()
+{
+	std::vector<sensor_config> sensors;
+
+	sensors.push_back(sensor_config{"fan", FANPIN, "", "", "", 0, -1, 0});
+	sensors.push_back(sensor_config{"gas", GASPIN, "", "", "", 0, -1, 0});
+	sensors.push_back(sensor_config{"pir", PIRPIN, "", "", "", 0, -1, 0});
+	return sensors;
+}
+
+bool node_config_resolve(std::vector<sensor_config> &sensors, std::string &error)
+{
+	std::map<std::string, int> counts;
+	std::set<std::string> uris, names;
+	std::set<std::pair<bool, int> > pins;
+
+	for (auto &sensor : sensors) {
+		const char *uri = NULL, *name = NULL, *resourceType = NULL;
+		bool analog = false;
+
+		for (auto &known : sensor_types) {
+			if (sensor.type == known.type) {
+				uri = known.uri;
+				name = known.name;
+				resourceType = known.resourceType;
+				analog = known.analog;
+			}
+		}
+		if (uri == NULL) {
+			error = "unknown sensor type " + sensor.type;
+			return false;
+		}
+
+		sensor.resourceType = resourceType;
+		int count = ++counts[sensor.type];
+		if (sensor.uri.empty())
+			sensor.uri = count == 1 ? uri : std::string(uri) + "/" + std::to_string(count);
+		if (sensor.name.empty())
+			sensor.name = count == 1 ? name : std::string(name) + std::to_string(count);
+
+		// the gateway takes the sensors of a node as name=type,...
+		if (sensor.name.find_first_of(",=") != std::string::npos) {
+			error = "sensor name " + sensor.name + " has a ',' or '='";
+			return false;
+		}
+		if (!pins.insert(std::make_pair(analog, sensor.pin)).second) {
+			error = std::string(analog ? "analog" : "digital") + " pin " + std::to_string(sensor.pin) +
+				" is taken twice";
+			return false;
+		}
+		if (!uris.insert(sensor.uri).second) {
+			error = "URI " + sensor.uri + " is taken twice";
+			return false;
+		}
+		if (!names.insert(sensor.name).second) {
+			error = "sensor name " + sensor.name + " is taken twice";
+			return false;
+		}
+	}
+	return true;
+}
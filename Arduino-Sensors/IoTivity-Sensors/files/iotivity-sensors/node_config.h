@@ -0,0 +1,61 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef NODE_CONFIG_H_
+#define NODE_CONFIG_H_
+
+#include <string>
+#include <vector>
+
+// One sensor of the node, from a line of the node's config file:
+//
+//   <type> <pin> [<uri>] [name=<name>] [rate=<hz>] [deadband=<n>] [adc=<hz>]
+//
+// 'type' is fan, gas or pir; a gas sensor's pin is an analog input, the
+// others' digital pins. The first sensor of a type defaults to the URI
+// and name of the original node (/sensor/gas and "gas"), the n-th to
+// <uri>/<n> and <name><n>. The name is what the gateway registers the
+// sensor as and its rules refer to it by. 'rate' and 'deadband' set how
+// often the sensor is read in on-change mode and what change of it is
+// notified, 'adc' how often a gas sensor's ADC is oversampled; each
+// falls back to the daemon's option. '#' starts a comment.
+struct sensor_config
+{
+	std::string type;
+	int pin;
+	std::string uri;
+	std::string name;
+	// the OIC resource type, filled in from 'type'
+	std::string resourceType;
+	// 0 or -1 for the daemon's default
+	unsigned int rate;
+	int deadband;
+	unsigned int adcRate;
+};
+
+bool node_config_load(const std::string &path, std::vector<sensor_config> &sensors, std::string &error);
+// The fan, gas and motion sensors of the original node on FANPIN, GASPIN
+// and PIRPIN.
+std::vector<sensor_config> node_config_default();
+// Fills in the default URIs and names and checks that no two sensors
+// share a pin, URI or name.
+bool node_config_resolve(std::vector<sensor_config> &sensors, std::string &error);
+
+#endif /* NODE_CONFIG_H_ */
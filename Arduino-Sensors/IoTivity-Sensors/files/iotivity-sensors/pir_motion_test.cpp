@@ -0,0 +1,153 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Edge-to-notify latency and debouncing of PirResource on the simulated
+// HAL, built with "scons TESTS=1" and run on the host. The motion pin
+// gets a long pulse and then one shorter than PIR_DEBOUNCE, both with
+// contact bounce. Every change that goes out is caught where the
+// notification is encoded. The test checks that each edge of the long
+// pulse and the rise of the short one are notified within
+// TEST_MAX_LATENCY of the edge, and that the bounce is not notified. The
+// fall of the short pulse must wait for the next poll. Exits non-zero on
+// the first failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "iotivity-sensors.h"
+
+#define TEST_PIN 2
+// rise at 100 ms, fall at 250, a 20 ms pulse from 450, then quiet
+#define TEST_SCRIPT "gpio 2 0@100 1@150 0@200 1@20 0 bounce=3\n"
+#define TEST_MAX_LATENCY 20
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+typedef std::chrono::steady_clock test_clock;
+
+struct notified
+{
+	test_clock::time_point at;
+	bool motion;
+	double timestamp;
+};
+
+// A PirResource with an observer, which records every state it encodes
+// for a notification instead of registering with the stack.
+class TestPir : public PirResource
+{
+	public:
+	std::vector<notified> m_notified;
+
+	TestPir() : PirResource("pir", PIR_RESOURCE_URI, TEST_PIN)
+	{
+		m_resourceHandle = NULL;
+		m_interestedObservers.add(1);
+	}
+
+	protected:
+	OCRepresentation get(void)
+	{
+		OCRepresentation rep = PirResource::get();
+		notified n;
+
+		n.at = test_clock::now();
+		rep.getValue("motion", n.motion);
+		n.timestamp = 0;
+		rep.getValue("timestamp", n.timestamp);
+		m_notified.push_back(n);
+		return rep;
+	}
+};
+
+static double since_ms(test_clock::time_point from, test_clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+int main()
+{
+	char script[] = "/tmp/pir_motion_test.XXXXXX";
+	int fd = mkstemp(script);
+
+	CHECK(fd >= 0);
+	CHECK(write(fd, TEST_SCRIPT, sizeof(TEST_SCRIPT) - 1) == sizeof(TEST_SCRIPT) - 1);
+	close(fd);
+
+	std::unique_ptr<Hal> hal(hal_sim_create(script));
+	unlink(script);
+	CHECK(hal != nullptr);
+
+	int result;
+	{
+		TestPir pir;
+		// the wave starts when the pin is opened
+		test_clock::time_point start = test_clock::now();
+		CHECK(pir.setup_hardware(hal.get()));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(600));
+		// a pulse shorter than the debounce ends at the next poll
+		pir.poll(std::chrono::duration_cast<std::chrono::milliseconds>(
+			test_clock::now().time_since_epoch()).count(), HEARTBEAT * 1000);
+
+		const double edges[] = { 100, 250, 450 };
+		const bool levels[] = { true, false, true };
+		result = 0;
+		for (size_t i = 0; i < pir.m_notified.size(); i++)
+			printf("notified motion=%d %7.2f ms after the start\n",
+				pir.m_notified[i].motion, since_ms(start, pir.m_notified[i].at));
+
+		if (pir.m_notified.size() != 4) {
+			fprintf(stderr, "%d notifications, expected 4\n", (int)pir.m_notified.size());
+			result = 1;
+		}
+		for (size_t i = 0; result == 0 && i < 3; i++) {
+			double latency = since_ms(start, pir.m_notified[i].at) - edges[i];
+			printf("edge at %3.0f ms notified after %5.2f ms\n", edges[i], latency);
+			if (pir.m_notified[i].motion != levels[i] || latency < -1 || latency > TEST_MAX_LATENCY) {
+				fprintf(stderr, "edge at %.0f ms: motion=%d after %.2f ms\n", edges[i],
+					pir.m_notified[i].motion, latency);
+				result = 1;
+			}
+			if (pir.m_notified[i].timestamp <= 0
+					|| (i > 0 && pir.m_notified[i].timestamp < pir.m_notified[i - 1].timestamp)) {
+				fprintf(stderr, "edge at %.0f ms: bad timestamp %.0f\n", edges[i],
+					pir.m_notified[i].timestamp);
+				result = 1;
+			}
+		}
+		if (result == 0 && pir.m_notified[3].motion) {
+			fprintf(stderr, "the poll did not end the short pulse\n");
+			result = 1;
+		}
+	}
+
+	if (result == 0)
+		printf("pir_motion_test passed\n");
+	return result;
+}
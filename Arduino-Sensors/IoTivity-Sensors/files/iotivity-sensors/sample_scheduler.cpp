@@ -0,0 +1,80 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "sample_scheduler.h"
+
+SampleScheduler::SampleScheduler() : m_running(false)
+{
+}
+
+SampleScheduler::~SampleScheduler()
+{
+	stop();
+}
+
+void SampleScheduler::add(unsigned int rate, SampleTask task)
+{
+	if (rate == 0)
+		return;
+	m_tasks.push_back(task);
+	m_periods.push_back(std::chrono::duration_cast<Clock::duration>(
+		std::chrono::microseconds(1000000 / rate)));
+}
+
+void SampleScheduler::start()
+{
+	Clock::time_point now = Clock::now();
+
+	if (m_running || m_tasks.empty())
+		return;
+	for (size_t i = 0; i < m_tasks.size(); i++)
+		m_queue.push(due_task{now, i});
+	m_running = true;
+	m_thread = std::thread(&SampleScheduler::run, this);
+}
+
+void SampleScheduler::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+	m_queue = decltype(m_queue)();
+}
+
+void SampleScheduler::run()
+{
+	while (m_running) {
+		due_task next = m_queue.top();
+
+		std::this_thread::sleep_until(next.due);
+		if (!m_running)
+			break;
+		m_queue.pop();
+
+		Clock::time_point now = Clock::now();
+		m_tasks[next.task](std::chrono::duration_cast<std::chrono::milliseconds>(
+			now.time_since_epoch()).count());
+
+		next.due += m_periods[next.task];
+		if (next.due < now)
+			next.due = now + m_periods[next.task];
+		m_queue.push(next);
+	}
+}
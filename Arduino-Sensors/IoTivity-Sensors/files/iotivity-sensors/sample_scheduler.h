@@ -0,0 +1,74 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef SAMPLE_SCHEDULER_H_
+#define SAMPLE_SCHEDULER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+typedef std::function<void(uint64_t now)> SampleTask;
+
+// SampleScheduler runs the periodic work of every sensor of the node,
+// readings and ADC oversampling alike, on one thread. Each task has its
+// own rate; the thread sleeps until the earliest one is due. A task that
+// falls more than a period behind skips the runs it missed rather than
+// running them back to back.
+class SampleScheduler
+{
+	public:
+	SampleScheduler();
+	~SampleScheduler();
+
+	// Calls 'task' 'rate' times a second, with the monotonic time in ms.
+	// Tasks are added before start().
+	void add(unsigned int rate, SampleTask task);
+	void start();
+	// No task runs once stop() returns.
+	void stop();
+
+	size_t size() const { return m_tasks.size(); }
+
+	private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct due_task
+	{
+		Clock::time_point due;
+		size_t task;
+
+		bool operator>(const due_task &other) const { return due > other.due; }
+	};
+
+	std::vector<SampleTask> m_tasks;
+	std::vector<Clock::duration> m_periods;
+	std::priority_queue<due_task, std::vector<due_task>, std::greater<due_task> > m_queue;
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+
+	void run();
+};
+
+#endif /* SAMPLE_SCHEDULER_H_ */
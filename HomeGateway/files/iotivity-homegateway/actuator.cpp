@@ -0,0 +1,181 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "actuator.h"
+#include "gateway_stats.h"
+
+static bool same_value(const rule_action &a, const rule_action &b)
+{
+	return a.type == b.type && a.i_value == b.i_value && a.s_value == b.s_value;
+}
+
+#define ACTUATOR_TICK 50
+
+static uint64_t to_ms(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+Actuator::Actuator(SendCallback send, unsigned int timeout_ms) : m_send(send), m_timeout(timeout_ms),
+	m_deadlines(ACTUATOR_TICK, to_ms(clock::now()))
+{
+}
+
+Actuator::target_state &Actuator::state(int target, const std::string &attribute)
+{
+	if ((size_t)target >= m_targets.size())
+		m_targets.resize(target + 1);
+
+	std::vector<target_state> &states = m_targets[target];
+	for (auto &state : states) {
+		if (state.attribute == attribute)
+			return state;
+	}
+
+	target_state state;
+	state.attribute = attribute;
+	state.has_sent = false;
+	state.has_pending = false;
+	state.in_flight = false;
+	state.timer = m_timers.size();
+	m_timers.push_back(std::make_pair(target, (int)states.size()));
+	states.push_back(state);
+	return states.back();
+}
+
+bool Actuator::ready(const target_state &state, clock::time_point now, int dwell_ms) const
+{
+	if (state.in_flight)
+		return false;
+	if (!state.has_sent)
+		return true;
+
+	return now - state.sent_at >= std::chrono::milliseconds(dwell_ms);
+}
+
+void Actuator::send(int target, target_state &state, const rule_action &action, clock::time_point now)
+{
+	if (!m_send(target, action)) {
+		// the target went away; what it shows once back is unknown
+		state.has_sent = false;
+		state.in_flight = false;
+		m_deadlines.cancel(state.timer);
+		gw_stats.puts_dropped++;
+		return;
+	}
+
+	state.sent = action;
+	state.has_sent = true;
+	state.in_flight = true;
+	state.sent_at = now;
+	m_deadlines.schedule(state.timer, m_timeout);
+	gw_stats.puts_sent++;
+}
+
+void Actuator::release(int target, target_state &state, clock::time_point now)
+{
+	state.has_pending = false;
+	if (state.has_sent && same_value(state.sent, state.pending))
+		gw_stats.puts_saved++;
+	else
+		send(target, state, state.pending, now);
+}
+
+void Actuator::request(int target, const rule_action &action, int dwell_ms)
+{
+	target_state &state = this->state(target, action.attribute);
+	clock::time_point now = clock::now();
+
+	if (state.has_pending) {
+		// the older pending request is superseded
+		gw_stats.puts_saved++;
+		state.has_pending = false;
+	}
+
+	if (state.has_sent && same_value(state.sent, action)) {
+		gw_stats.puts_saved++;
+		return;
+	}
+
+	if (ready(state, now, dwell_ms)) {
+		send(target, state, action, now);
+	}
+	else {
+		state.pending = action;
+		state.has_pending = true;
+	}
+}
+
+void Actuator::acknowledge(int target, const std::string &attribute, bool success, int dwell_ms)
+{
+	target_state &state = this->state(target, attribute);
+
+	state.in_flight = false;
+	m_deadlines.cancel(state.timer);
+	if (!success) {
+		// the device state is unknown, let the next request through
+		state.has_sent = false;
+	}
+
+	clock::time_point now = clock::now();
+	if (state.has_pending && ready(state, now, dwell_ms)) {
+		release(target, state, now);
+	}
+}
+
+// The PUT of deadline 'timer' got no response in time. The device may or
+// may not have applied it, so the newest wanted value is sent again.
+void Actuator::expired(int timer, int dwell_ms)
+{
+	int target = m_timers[timer].first;
+	target_state &state = m_targets[target][m_timers[timer].second];
+
+	if (!state.in_flight)
+		return;
+
+	gw_stats.puts_timed_out++;
+	state.in_flight = false;
+	if (!state.has_pending) {
+		state.pending = state.sent;
+		state.has_pending = true;
+	}
+	state.has_sent = false;
+
+	clock::time_point now = clock::now();
+	if (ready(state, now, dwell_ms))
+		release(target, state, now);
+}
+
+void Actuator::flush(int dwell_ms)
+{
+	clock::time_point now = clock::now();
+
+	m_deadlines.advance(to_ms(now), [this, dwell_ms](int timer) {
+		expired(timer, dwell_ms);
+	});
+
+	for (size_t target = 0; target < m_targets.size(); target++) {
+		for (auto &state : m_targets[target]) {
+			if (state.has_pending && ready(state, now, dwell_ms)) {
+				release(target, state, now);
+			}
+		}
+	}
+}
@@ -0,0 +1,84 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef ACTUATOR_H_
+#define ACTUATOR_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+#include "rule_engine.h"
+#include "timer_wheel.h"
+
+// Actuator sits between the rule engine and the PUTs sent to devices.
+// For every target attribute it keeps at most one PUT in flight, and it
+// leaves at least a minimum dwell time between two PUTs. It also drops
+// a request that would not change the last value sent. While a PUT is in
+// flight or dwelling, newer requests overwrite a single pending slot, so
+// only the latest desired state goes out once the target is free again.
+// A PUT that is not acknowledged within the in-flight timeout is given
+// up on and sent again, so a lost response cannot wedge its target.
+class Actuator
+{
+	public:
+	// Returns false when 'target' can no longer be sent to; the request
+	// is then dropped.
+	typedef std::function<bool(int target, const rule_action &action)> SendCallback;
+
+	Actuator(SendCallback send, unsigned int timeout_ms);
+
+	void request(int target, const rule_action &action, int dwell_ms);
+	void acknowledge(int target, const std::string &attribute, bool success, int dwell_ms);
+	// Sends pending requests whose dwell time has elapsed and retries
+	// the PUTs that timed out.
+	void flush(int dwell_ms);
+
+	private:
+	typedef std::chrono::steady_clock clock;
+
+	struct target_state
+	{
+		std::string attribute;
+		rule_action sent;
+		rule_action pending;
+		bool has_sent;
+		bool has_pending;
+		bool in_flight;
+		clock::time_point sent_at;
+		// id of the in-flight deadline in m_deadlines
+		int timer;
+	};
+
+	target_state &state(int target, const std::string &attribute);
+	bool ready(const target_state &state, clock::time_point now, int dwell_ms) const;
+	void send(int target, target_state &state, const rule_action &action, clock::time_point now);
+	void release(int target, target_state &state, clock::time_point now);
+	void expired(int timer, int dwell_ms);
+
+	SendCallback m_send;
+	unsigned int m_timeout;
+	std::vector<std::vector<target_state> > m_targets;
+	TimerWheel m_deadlines;
+	// target and index in m_targets[target] of each deadline id
+	std::vector<std::pair<int, int> > m_timers;
+};
+
+#endif /* ACTUATOR_H_ */
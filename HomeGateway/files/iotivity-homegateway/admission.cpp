@@ -0,0 +1,200 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "admission.h"
+#include "homegateway.h"
+#include "gateway_stats.h"
+
+#define WORKER_IDLE_WAIT 10
+#define LATENCY_WINDOW 10000000		// us
+#define MAX_CLIENTS 1024
+#define ANONYMOUS_CLIENT ""
+
+static uint64_t monotonic_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AdmissionControl::AdmissionControl(size_t capacity, int rate, int burst)
+	: m_rate(rate), m_burst(burst), m_queue(capacity), m_running(true), m_sleeping(false),
+	m_windowStart(monotonic_us())
+{
+	for (auto &count : m_latency)
+		count = 0;
+
+	m_thread = std::thread(&AdmissionControl::run, this);
+}
+
+AdmissionControl::~AdmissionControl()
+{
+	stop();
+}
+
+void AdmissionControl::stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_running = false;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_wakeup.notify_one();
+	}
+	m_thread.join();
+}
+
+EntityHandler AdmissionControl::wrap(EntityHandler handler)
+{
+	m_handlers.push_back(handler);
+	const EntityHandler *wrapped = &m_handlers.back();
+
+	return std::bind(&AdmissionControl::admit, this, wrapped, PH::_1);
+}
+
+OCEntityHandlerResult AdmissionControl::admit(const EntityHandler *handler, std::shared_ptr<OCResourceRequest> request)
+{
+	uint64_t now = monotonic_us();
+
+	if (!request)
+		return (*handler)(request);
+
+	QueryParamsMap query = request->getQueryParameters();
+	auto client = query.find("client");
+	if (!takeToken(client != query.end() ? client->second : ANONYMOUS_CLIENT, now)) {
+		gw_stats.requests_limited++;
+		reject(request, 429);
+		return OC_EH_ERROR;
+	}
+
+	if ((request->getRequestHandlerFlag() & RequestHandlerFlag::ObserverFlag) ||
+		!(request->getRequestHandlerFlag() & RequestHandlerFlag::RequestFlag)) {
+		return (*handler)(request);
+	}
+
+	if (!m_queue.push(admitted_request{handler, request, now})) {
+		gw_stats.requests_rejected++;
+		reject(request, 503);
+		return OC_EH_ERROR;
+	}
+	gw_stats.requests_queued++;
+
+	if (m_sleeping.load()) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_wakeup.notify_one();
+	}
+
+	return OC_EH_SLOW;
+}
+
+bool AdmissionControl::takeToken(const std::string &client, uint64_t now_us)
+{
+	std::lock_guard<std::mutex> lock(m_bucketLock);
+
+	auto iter = m_buckets.find(client);
+	if (iter == m_buckets.end() && m_buckets.size() >= MAX_CLIENTS) {
+		// forget the clients whose buckets have refilled, they would
+		// start over with a full bucket anyway
+		for (auto idle = m_buckets.begin(); idle != m_buckets.end(); ) {
+			if (idle->second.tokens + (now_us - idle->second.updated_us) * m_rate / 1e6 >= m_burst)
+				idle = m_buckets.erase(idle);
+			else
+				idle++;
+		}
+		// still too many, charge the newcomer to the shared bucket
+		if (m_buckets.size() >= MAX_CLIENTS)
+			iter = m_buckets.find(ANONYMOUS_CLIENT);
+	}
+	if (iter == m_buckets.end()) {
+		iter = m_buckets.insert(std::make_pair(client, token_bucket{(double)m_burst, now_us})).first;
+	}
+
+	token_bucket &bucket = iter->second;
+	bucket.tokens += (now_us - bucket.updated_us) * m_rate / 1e6;
+	if (bucket.tokens > m_burst)
+		bucket.tokens = m_burst;
+	bucket.updated_us = now_us;
+
+	if (bucket.tokens < 1)
+		return false;
+	bucket.tokens -= 1;
+	return true;
+}
+
+void AdmissionControl::reject(std::shared_ptr<OCResourceRequest> request, int code)
+{
+	auto pResponse = std::make_shared<OC::OCResourceResponse>();
+	pResponse->setRequestHandle(request->getRequestHandle());
+	pResponse->setResourceHandle(request->getResourceHandle());
+	pResponse->setErrorCode(code);
+	pResponse->setResponseResult(OC_EH_ERROR);
+	OCPlatform::sendResponse(pResponse);
+}
+
+void AdmissionControl::record(uint64_t latency_us, uint64_t now_us)
+{
+	int bucket = 0;
+
+	while (latency_us > 1 && bucket < LATENCY_BUCKETS - 1) {
+		latency_us >>= 1;
+		bucket++;
+	}
+	m_latency[bucket]++;
+
+	if (now_us - m_windowStart < LATENCY_WINDOW)
+		return;
+
+	uint32_t total = 0, seen = 0;
+	for (auto count : m_latency)
+		total += count;
+	for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += m_latency[bucket];
+		if (seen * 100 >= total * 99)
+			break;
+	}
+	gw_stats.request_p99_us = 1 << (bucket + 1);
+
+	for (auto &count : m_latency)
+		count = 0;
+	m_windowStart = now_us;
+}
+
+void AdmissionControl::run()
+{
+	admitted_request admitted;
+
+	while (m_running) {
+		if (m_queue.pop(admitted)) {
+			gw_stats.requests_queued--;
+			(*admitted.handler)(admitted.request);
+			admitted.request.reset();
+
+			uint64_t now = monotonic_us();
+			record(now - admitted.admitted_us, now);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_sleeping = true;
+		if (m_queue.size() == 0 && m_running)
+			m_wakeup.wait_for(lock, std::chrono::milliseconds(WORKER_IDLE_WAIT));
+		m_sleeping = false;
+	}
+}
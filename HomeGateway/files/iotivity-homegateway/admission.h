@@ -0,0 +1,94 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef ADMISSION_H_
+#define ADMISSION_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <unordered_map>
+#include <condition_variable>
+#include "resource.h"
+#include "observe_pipeline.h"
+
+#define LATENCY_BUCKETS 30
+
+struct admitted_request
+{
+	const EntityHandler *handler;
+	std::shared_ptr<OCResourceRequest> request;
+	uint64_t admitted_us;
+};
+
+// AdmissionControl sits in front of the gateway's entity handlers. Each
+// client, named by the "client" query parameter, gets a token bucket;
+// clients that do not name themselves share one. Admitted GET and PUT
+// requests are queued for a worker thread and answered later (OC_EH_SLOW),
+// so the stack thread is never held up by a handler. Requests over the
+// rate are answered 429 and requests finding the queue full 503, both
+// without running the handler. Observe registrations are handled inline,
+// since the stack only adds the observer on an immediate OC_EH_OK.
+class AdmissionControl
+{
+	public:
+	// 'capacity' must be a power of two; 'rate' and 'burst' are per client.
+	AdmissionControl(size_t capacity, int rate, int burst);
+	~AdmissionControl();
+
+	// Wraps 'handler' for registration with OCPlatform::registerResource.
+	EntityHandler wrap(EntityHandler handler);
+	// Joins the worker; the handlers' resources may go away afterwards.
+	void stop();
+
+	private:
+	struct token_bucket
+	{
+		double tokens;
+		uint64_t updated_us;
+	};
+
+	OCEntityHandlerResult admit(const EntityHandler *handler, std::shared_ptr<OCResourceRequest> request);
+	bool takeToken(const std::string &client, uint64_t now_us);
+	void reject(std::shared_ptr<OCResourceRequest> request, int code);
+	void record(uint64_t latency_us, uint64_t now_us);
+	void run();
+
+	int m_rate;
+	int m_burst;
+	std::deque<EntityHandler> m_handlers;
+	std::mutex m_bucketLock;
+	std::unordered_map<std::string, token_bucket> m_buckets;
+	BoundedQueue<admitted_request> m_queue;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_sleeping;
+	std::mutex m_lock;
+	std::condition_variable m_wakeup;
+	// log2 histogram of queueing plus handling time, in microseconds,
+	// published as a p99 once per LATENCY_WINDOW
+	uint32_t m_latency[LATENCY_BUCKETS];
+	uint64_t m_windowStart;
+	std::thread m_thread;
+};
+
+#endif /* ADMISSION_H_ */
@@ -0,0 +1,197 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Load generator for the gateway's admission control, built with
+// "scons TESTS=1" and run next to a running homegateway. A probe client
+// GETs /gw/sensor within its rate limit and records the latency of each
+// answer, first on an idle gateway and then while flooding clients,
+// each naming itself with the "client" query parameter, send GETs far
+// over their rate. Prints the probe's p50 and p99 for both phases and
+// how the flood was answered; with admission control the probe's p99
+// should stay where it was on the idle gateway.
+//
+//	admission_load [host] [flooders] [seconds] [rate per flooder]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "OCPlatform.h"
+#include "OCApi.h"
+#include "homegateway.h"
+
+using namespace OC;
+
+#define LOAD_HOST "coap://127.0.0.1:8888"
+#define LOAD_FLOODERS 8
+#define LOAD_SECONDS 10
+#define LOAD_RATE 500
+// the probe stays inside ADMISSION_RATE
+#define PROBE_INTERVAL 100
+#define PROBE_TIMEOUT 2000
+
+typedef std::chrono::steady_clock load_clock;
+
+// Answers by result code, for the probe or the flood.
+struct answer_counts
+{
+	std::mutex lock;
+	std::map<int, int> codes;
+
+	void add(int eCode)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		codes[eCode]++;
+	}
+
+	void print(const char *who)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		printf("%-6s answers:", who);
+		for (auto &code : codes)
+			printf("  %s %d", code.first == OC_STACK_OK ? "ok" : std::to_string(code.first).c_str(),
+				code.second);
+		printf("\n");
+	}
+};
+
+static std::shared_ptr<OCResource> gateway_resource(const std::string &host)
+{
+	return OCPlatform::constructResourceObject(host, SENSOR_RESOURCE_ENDPOINT, OC_ALL, true,
+		std::vector<std::string>(1, SENSOR_RESOURCE_TYPE), std::vector<std::string>(1, DEFAULT_INTERFACE));
+}
+
+static double percentile(std::vector<double> &samples, double p)
+{
+	if (samples.empty())
+		return 0;
+	std::sort(samples.begin(), samples.end());
+	return samples[std::min(samples.size() - 1, (size_t)(samples.size() * p))];
+}
+
+// One GET at a time for 'seconds', every PROBE_INTERVAL; returns the
+// latencies in milliseconds and counts the answers and the timeouts.
+static std::vector<double> probe(std::shared_ptr<OCResource> resource, int seconds,
+	answer_counts &answers, int &timeouts)
+{
+	std::vector<double> latencies;
+	load_clock::time_point end = load_clock::now() + std::chrono::seconds(seconds);
+	QueryParamsMap query;
+
+	query["client"] = "probe";
+	while (load_clock::now() < end) {
+		auto state = std::make_shared<std::pair<std::mutex, std::condition_variable> >();
+		auto answered = std::make_shared<bool>(false);
+		load_clock::time_point start = load_clock::now();
+
+		resource->get(query, [state, answered, &answers](const HeaderOptions &,
+				const OCRepresentation &, const int eCode) {
+			answers.add(eCode);
+			std::lock_guard<std::mutex> lock(state->first);
+			*answered = true;
+			state->second.notify_one();
+		});
+
+		std::unique_lock<std::mutex> lock(state->first);
+		if (state->second.wait_for(lock, std::chrono::milliseconds(PROBE_TIMEOUT),
+				[answered]() { return *answered; }))
+			latencies.push_back(std::chrono::duration<double, std::milli>(load_clock::now() - start).count());
+		else
+			timeouts++;
+		lock.unlock();
+
+		std::this_thread::sleep_until(start + std::chrono::milliseconds(PROBE_INTERVAL));
+	}
+	return latencies;
+}
+
+static void report(const char *phase, std::vector<double> &latencies, int timeouts)
+{
+	double p50 = percentile(latencies, 0.50);
+	double p99 = percentile(latencies, 0.99);
+
+	printf("%-9s %5d GETs  p50 %8.2f ms  p99 %8.2f ms  %d timed out\n",
+		phase, (int)latencies.size(), p50, p99, timeouts);
+}
+
+int main(int argc, char *argv[])
+{
+	std::string host = argc > 1 ? argv[1] : LOAD_HOST;
+	int flooders = argc > 2 ? atoi(argv[2]) : LOAD_FLOODERS;
+	int seconds = argc > 3 ? atoi(argv[3]) : LOAD_SECONDS;
+	int rate = argc > 4 ? atoi(argv[4]) : LOAD_RATE;
+	answer_counts probe_answers, flood_answers;
+	std::atomic<bool> flooding(true);
+	std::atomic<int> sent(0);
+	std::vector<std::thread> threads;
+	int idle_timeouts = 0, loaded_timeouts = 0;
+
+	if (flooders <= 0 || seconds <= 0 || rate <= 0) {
+		fprintf(stderr, "usage: %s [host] [flooders] [seconds] [rate per flooder]\n", argv[0]);
+		return 1;
+	}
+
+	PlatformConfig cfg(ServiceType::InProc, ModeType::Client, "0.0.0.0", 0, QualityOfService::LowQos);
+	OCPlatform::Configure(cfg);
+
+	std::shared_ptr<OCResource> resource = gateway_resource(host);
+	std::vector<double> idle = probe(resource, seconds, probe_answers, idle_timeouts);
+
+	for (int i = 0; i < flooders; i++)
+		threads.push_back(std::thread([&, i]() {
+			std::shared_ptr<OCResource> flood = gateway_resource(host);
+			std::chrono::microseconds interval(1000000 / rate);
+			load_clock::time_point next = load_clock::now();
+			QueryParamsMap query;
+
+			query["client"] = "flood" + std::to_string(i);
+			while (flooding) {
+				// the answers are only counted, the flood never waits
+				flood->get(query, [&flood_answers](const HeaderOptions &,
+						const OCRepresentation &, const int eCode) {
+					flood_answers.add(eCode);
+				});
+				sent++;
+				next += interval;
+				std::this_thread::sleep_until(next);
+			}
+		}));
+
+	std::vector<double> loaded = probe(resource, seconds, probe_answers, loaded_timeouts);
+	flooding = false;
+	for (auto &thread : threads)
+		thread.join();
+	// let the last answers of the flood come in
+	std::this_thread::sleep_for(std::chrono::milliseconds(PROBE_TIMEOUT));
+
+	printf("%s, %d flooders at %d GET/s each, %d s per phase\n", host.c_str(), flooders, rate, seconds);
+	report("idle", idle, idle_timeouts);
+	report("flooded", loaded, loaded_timeouts);
+	probe_answers.print("probe");
+	printf("flood  sent %d\n", sent.load());
+	flood_answers.print("flood");
+	return 0;
+}
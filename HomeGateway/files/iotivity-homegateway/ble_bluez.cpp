@@ -0,0 +1,359 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Corporation.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// BlueZ over D-Bus ("bluez" transport). The gateway does not scan or
+// pair; it follows the peripherals bluetoothd has connected. A peripheral
+// is reported connected once its GATT services are resolved and it has
+// a Heart Rate Measurement characteristic, and disconnected when BlueZ
+// drops the link. Notifications arrive as PropertiesChanged signals on
+// the characteristic and go to the subscriber without a copy.
+//
+// Everything, the signal handlers included, runs on the thread of the
+// main loop that start() is called from.
+
+#include <gio/gio.h>
+#include <string>
+#include <unordered_map>
+#include "ble_transport.h"
+#include "async_log.h"
+
+#define BLUEZ_SERVICE "org.bluez"
+#define BLUEZ_DEVICE "org.bluez.Device1"
+#define BLUEZ_CHARACTERISTIC "org.bluez.GattCharacteristic1"
+#define HEART_RATE_MEASUREMENT_UUID "00002a37-0000-1000-8000-00805f9b34fb"
+
+class BluezTransport : public BleTransport
+{
+	public:
+	BluezTransport();
+	~BluezTransport();
+
+	virtual bool start(BleConnectionHandler handler);
+	virtual void stop();
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context);
+	virtual void unsubscribe(const std::string &address);
+
+	private:
+	struct device
+	{
+		std::string address;
+		bool connected;
+		bool resolved;
+		bool reported;
+		// the Heart Rate Measurement characteristic, if found
+		std::string measurement;
+	};
+
+	struct subscription
+	{
+		BleNotificationHandler changed;
+		void *context;
+	};
+
+	static void propertiesChanged(GDBusConnection *bus, const gchar *sender, const gchar *path,
+			const gchar *interface, const gchar *signal, GVariant *parameters, gpointer user_data);
+	static void interfacesAdded(GDBusConnection *bus, const gchar *sender, const gchar *path,
+			const gchar *interface, const gchar *signal, GVariant *parameters, gpointer user_data);
+	static void interfacesRemoved(GDBusConnection *bus, const gchar *sender, const gchar *path,
+			const gchar *interface, const gchar *signal, GVariant *parameters, gpointer user_data);
+
+	void addInterfaces(const std::string &path, GVariant *interfaces);
+	void updateDevice(const std::string &path, GVariant *properties);
+	void addCharacteristic(const std::string &path, GVariant *properties);
+	void removeDevice(const std::string &path);
+	void report(device &peripheral);
+	void callCharacteristic(const std::string &path, const char *method);
+
+	BleConnectionHandler m_handler;
+	GDBusConnection *m_bus;
+	guint m_signals[3];
+	std::unordered_map<std::string, device> m_devices;
+	std::unordered_map<std::string, std::string> m_byAddress;
+	// by characteristic path
+	std::unordered_map<std::string, subscription> m_subscriptions;
+};
+
+BluezTransport::BluezTransport() : m_bus(NULL)
+{
+}
+
+BluezTransport::~BluezTransport()
+{
+	stop();
+}
+
+bool BluezTransport::start(BleConnectionHandler handler)
+{
+	GError *error = NULL;
+	GVariant *objects;
+	GVariantIter *iter;
+	const gchar *path;
+	GVariant *interfaces;
+
+	m_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (!m_bus) {
+		ALOG_ERROR("Could not connect to the system bus: {}", error->message);
+		g_error_free(error);
+		return false;
+	}
+	m_handler = handler;
+
+	// subscribe before listing, so nothing falls in between
+	m_signals[0] = g_dbus_connection_signal_subscribe(m_bus, BLUEZ_SERVICE,
+		"org.freedesktop.DBus.Properties", "PropertiesChanged", NULL, NULL,
+		G_DBUS_SIGNAL_FLAGS_NONE, propertiesChanged, this, NULL);
+	m_signals[1] = g_dbus_connection_signal_subscribe(m_bus, BLUEZ_SERVICE,
+		"org.freedesktop.DBus.ObjectManager", "InterfacesAdded", NULL, NULL,
+		G_DBUS_SIGNAL_FLAGS_NONE, interfacesAdded, this, NULL);
+	m_signals[2] = g_dbus_connection_signal_subscribe(m_bus, BLUEZ_SERVICE,
+		"org.freedesktop.DBus.ObjectManager", "InterfacesRemoved", NULL, NULL,
+		G_DBUS_SIGNAL_FLAGS_NONE, interfacesRemoved, this, NULL);
+
+	objects = g_dbus_connection_call_sync(m_bus, BLUEZ_SERVICE, "/",
+		"org.freedesktop.DBus.ObjectManager", "GetManagedObjects", NULL,
+		G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+	if (!objects) {
+		// bluetoothd may come up later; its InterfacesAdded tell us then
+		ALOG_WARN("Could not list BlueZ objects: {}", error->message);
+		g_error_free(error);
+		return true;
+	}
+
+	g_variant_get(objects, "(a{oa{sa{sv}}})", &iter);
+	while (g_variant_iter_next(iter, "{&o@a{sa{sv}}}", &path, &interfaces)) {
+		addInterfaces(path, interfaces);
+		g_variant_unref(interfaces);
+	}
+	g_variant_iter_free(iter);
+	g_variant_unref(objects);
+
+	ALOG_INFO("BlueZ transport started, {} devices known", m_devices.size());
+	return true;
+}
+
+void BluezTransport::stop()
+{
+	if (!m_bus)
+		return;
+
+	for (guint signal : m_signals)
+		g_dbus_connection_signal_unsubscribe(m_bus, signal);
+	for (auto &entry : m_subscriptions)
+		callCharacteristic(entry.first, "StopNotify");
+	m_subscriptions.clear();
+	g_dbus_connection_flush_sync(m_bus, NULL, NULL);
+	g_object_unref(m_bus);
+	m_bus = NULL;
+}
+
+void BluezTransport::addInterfaces(const std::string &path, GVariant *interfaces)
+{
+	GVariantIter iter;
+	const gchar *interface;
+	GVariant *properties;
+
+	g_variant_iter_init(&iter, interfaces);
+	while (g_variant_iter_next(&iter, "{&s@a{sv}}", &interface, &properties)) {
+		if (!g_strcmp0(interface, BLUEZ_DEVICE))
+			updateDevice(path, properties);
+		else if (!g_strcmp0(interface, BLUEZ_CHARACTERISTIC))
+			addCharacteristic(path, properties);
+		g_variant_unref(properties);
+	}
+}
+
+void BluezTransport::updateDevice(const std::string &path, GVariant *properties)
+{
+	device &peripheral = m_devices[path];
+	const gchar *address;
+	gboolean flag;
+
+	if (g_variant_lookup(properties, "Address", "&s", &address)) {
+		peripheral.address = address;
+		m_byAddress[peripheral.address] = path;
+	}
+	if (g_variant_lookup(properties, "Connected", "b", &flag))
+		peripheral.connected = flag;
+	if (g_variant_lookup(properties, "ServicesResolved", "b", &flag))
+		peripheral.resolved = flag;
+	report(peripheral);
+}
+
+// A characteristic lives at <device>/serviceXXXX/charXXXX.
+void BluezTransport::addCharacteristic(const std::string &path, GVariant *properties)
+{
+	const gchar *uuid;
+	size_t service = path.rfind('/');
+	size_t owner = service == std::string::npos || service == 0 ? std::string::npos :
+		path.rfind('/', service - 1);
+
+	if (!g_variant_lookup(properties, "UUID", "&s", &uuid) ||
+		g_ascii_strcasecmp(uuid, HEART_RATE_MEASUREMENT_UUID) || owner == std::string::npos)
+		return;
+
+	device &peripheral = m_devices[path.substr(0, owner)];
+	peripheral.measurement = path;
+	report(peripheral);
+}
+
+void BluezTransport::report(device &peripheral)
+{
+	bool ready = peripheral.connected && peripheral.resolved && !peripheral.measurement.empty()
+		&& !peripheral.address.empty();
+
+	if (ready == peripheral.reported)
+		return;
+	peripheral.reported = ready;
+	ALOG_INFO("Device {} {}", peripheral.address, ready ? "connected" : "disconnected");
+	m_handler(peripheral.address, ready);
+}
+
+void BluezTransport::removeDevice(const std::string &path)
+{
+	auto iter = m_devices.find(path);
+
+	if (iter == m_devices.end())
+		return;
+	if (iter->second.reported) {
+		iter->second.connected = false;
+		report(iter->second);
+	}
+	m_byAddress.erase(iter->second.address);
+	m_devices.erase(iter);
+}
+
+void BluezTransport::propertiesChanged(GDBusConnection *bus, const gchar *sender,
+	const gchar *path, const gchar *interface, const gchar *signal, GVariant *parameters,
+	gpointer user_data)
+{
+	BluezTransport *transport = (BluezTransport *)user_data;
+	const gchar *changedInterface;
+	GVariant *changed;
+
+	g_variant_get(parameters, "(&s@a{sv}@as)", &changedInterface, &changed, NULL);
+
+	if (!g_strcmp0(changedInterface, BLUEZ_CHARACTERISTIC)) {
+		auto iter = transport->m_subscriptions.find(path);
+		GVariant *value;
+		if (iter != transport->m_subscriptions.end() &&
+			(value = g_variant_lookup_value(changed, "Value", G_VARIANT_TYPE_BYTESTRING))) {
+			gsize length;
+			const uint8_t *bytes = (const uint8_t *)g_variant_get_fixed_array(value,
+				&length, sizeof(uint8_t));
+			iter->second.changed(iter->second.context, bytes, length);
+			g_variant_unref(value);
+		}
+	}
+	else if (!g_strcmp0(changedInterface, BLUEZ_DEVICE)) {
+		transport->updateDevice(path, changed);
+	}
+
+	g_variant_unref(changed);
+}
+
+void BluezTransport::interfacesAdded(GDBusConnection *bus, const gchar *sender,
+	const gchar *path, const gchar *interface, const gchar *signal, GVariant *parameters,
+	gpointer user_data)
+{
+	BluezTransport *transport = (BluezTransport *)user_data;
+	const gchar *object;
+	GVariant *interfaces;
+
+	g_variant_get(parameters, "(&o@a{sa{sv}})", &object, &interfaces);
+	transport->addInterfaces(object, interfaces);
+	g_variant_unref(interfaces);
+}
+
+void BluezTransport::interfacesRemoved(GDBusConnection *bus, const gchar *sender,
+	const gchar *path, const gchar *interface, const gchar *signal, GVariant *parameters,
+	gpointer user_data)
+{
+	BluezTransport *transport = (BluezTransport *)user_data;
+	const gchar *object;
+	GVariantIter *iter;
+	const gchar *removed;
+
+	g_variant_get(parameters, "(&oas)", &object, &iter);
+	while (g_variant_iter_next(iter, "&s", &removed)) {
+		if (!g_strcmp0(removed, BLUEZ_DEVICE))
+			transport->removeDevice(object);
+		else if (!g_strcmp0(removed, BLUEZ_CHARACTERISTIC))
+			transport->m_subscriptions.erase(object);
+	}
+	g_variant_iter_free(iter);
+}
+
+static void characteristic_call_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	gchar *path = (gchar *)user_data;
+	GError *error = NULL;
+	GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+
+	if (reply) {
+		g_variant_unref(reply);
+	}
+	else {
+		ALOG_WARN("BlueZ call on {} failed: {}", path, error->message);
+		g_error_free(error);
+	}
+	g_free(path);
+}
+
+void BluezTransport::callCharacteristic(const std::string &path, const char *method)
+{
+	g_dbus_connection_call(m_bus, BLUEZ_SERVICE, path.c_str(), BLUEZ_CHARACTERISTIC, method,
+		NULL, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, characteristic_call_done,
+		g_strdup(path.c_str()));
+}
+
+bool BluezTransport::subscribe(const std::string &address, BleNotificationHandler handler,
+	void *context)
+{
+	auto iter = m_byAddress.find(address);
+
+	if (iter == m_byAddress.end())
+		return false;
+
+	const std::string &measurement = m_devices[iter->second].measurement;
+	if (measurement.empty())
+		return false;
+
+	m_subscriptions[measurement] = subscription{handler, context};
+	callCharacteristic(measurement, "StartNotify");
+	return true;
+}
+
+void BluezTransport::unsubscribe(const std::string &address)
+{
+	auto iter = m_byAddress.find(address);
+
+	if (iter == m_byAddress.end())
+		return;
+
+	const std::string &measurement = m_devices[iter->second].measurement;
+	if (m_subscriptions.erase(measurement))
+		callCharacteristic(measurement, "StopNotify");
+}
+
+BleTransport *ble_bluez_create()
+{
+	return new BluezTransport();
+}
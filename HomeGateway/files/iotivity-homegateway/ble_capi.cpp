@@ -0,0 +1,164 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Corporation.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// The platform Bluetooth API ("capi" transport), as the gateway used it
+// before BlueZ: connection changes come from the adapter and a
+// peripheral's heart rate service is looked up among its primary
+// services when it is subscribed.
+
+#include <glib.h>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include "bluetooth.h"
+#include "ble_transport.h"
+#include "async_log.h"
+
+#define HEART_RATE_UUID "0000180d-0000-1000-8000-00805f9b34fb"
+
+class CapiTransport : public BleTransport
+{
+	public:
+	virtual ~CapiTransport();
+
+	virtual bool start(BleConnectionHandler handler);
+	virtual void stop();
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context);
+	virtual void unsubscribe(const std::string &address);
+
+	private:
+	struct subscription
+	{
+		bt_gatt_attribute_h service;
+		BleNotificationHandler changed;
+		void *context;
+	};
+
+	static void connectionChanged(bool connected, bt_device_connection_info_s *conn_info,
+			void *user_data);
+	static bool primaryService(bt_gatt_attribute_h service, void *user_data);
+	static void characteristicChanged(bt_gatt_attribute_h characteristic, unsigned char *value,
+			int value_length, void *user_data);
+
+	BleConnectionHandler m_handler;
+	std::mutex m_lock;
+	std::unordered_map<std::string, std::unique_ptr<subscription> > m_subscriptions;
+};
+
+CapiTransport::~CapiTransport()
+{
+	stop();
+}
+
+bool CapiTransport::start(BleConnectionHandler handler)
+{
+	if (bt_initialize() != BT_ERROR_NONE) {
+		ALOG_ERROR("Could not initialize Bluetooth");
+		return false;
+	}
+	m_handler = handler;
+	bt_device_set_connection_state_changed_cb(connectionChanged, this);
+	return true;
+}
+
+void CapiTransport::stop()
+{
+	if (!m_handler)
+		return;
+
+	bt_device_unset_connection_state_changed_cb();
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (auto &entry : m_subscriptions)
+			bt_gatt_unset_characteristic_changed_cb(entry.second->service);
+		m_subscriptions.clear();
+	}
+	bt_deinitialize();
+	m_handler = nullptr;
+}
+
+void CapiTransport::connectionChanged(bool connected, bt_device_connection_info_s *conn_info,
+	void *user_data)
+{
+	CapiTransport *transport = (CapiTransport *)user_data;
+
+	ALOG_INFO("Device {} {}", conn_info->remote_address, connected ? "connected" : "disconnected");
+	transport->m_handler(conn_info->remote_address, connected);
+}
+
+bool CapiTransport::primaryService(bt_gatt_attribute_h service, void *user_data)
+{
+	bt_gatt_attribute_h *heartRate = (bt_gatt_attribute_h *)user_data;
+	char *uuid = NULL;
+
+	bt_gatt_get_service_uuid(service, &uuid);
+	ALOG_INFO("UUID: {}", uuid ? uuid : "");
+
+	if (!g_strcmp0(uuid, HEART_RATE_UUID)) {
+		*heartRate = service;
+		g_free(uuid);
+		return false;
+	}
+
+	g_free(uuid);
+	return true;
+}
+
+void CapiTransport::characteristicChanged(bt_gatt_attribute_h characteristic, unsigned char *value,
+	int value_length, void *user_data)
+{
+	subscription *entry = (subscription *)user_data;
+
+	entry->changed(entry->context, value, value_length > 0 ? value_length : 0);
+}
+
+bool CapiTransport::subscribe(const std::string &address, BleNotificationHandler handler,
+	void *context)
+{
+	bt_gatt_attribute_h service = NULL;
+
+	bt_gatt_foreach_primary_services(address.c_str(), primaryService, &service);
+	if (service == NULL)
+		return false;
+
+	std::unique_ptr<subscription> entry(new subscription{service, handler, context});
+	bt_gatt_set_characteristic_changed_cb(service, characteristicChanged, entry.get());
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_subscriptions[address] = std::move(entry);
+	return true;
+}
+
+void CapiTransport::unsubscribe(const std::string &address)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	auto iter = m_subscriptions.find(address);
+
+	if (iter == m_subscriptions.end())
+		return;
+	bt_gatt_unset_characteristic_changed_cb(iter->second->service);
+	m_subscriptions.erase(iter);
+}
+
+BleTransport *ble_capi_create()
+{
+	return new CapiTransport();
+}
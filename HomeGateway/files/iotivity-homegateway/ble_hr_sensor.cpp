@@ -17,18 +17,34 @@
 // limitations under the License.
 //
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-#include <signal.h>
-#include <glib.h>
 #include <thread>
 #include <functional>
 #include "sensor_resource.h"
 #include "ble_hr_sensor.h"
+#include "gateway_stats.h"
+#include "async_log.h"
 
-static SensorResource *sensor = NULL;
+static uint64_t monotonic_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-BLE_hrSensor::BLE_hrSensor() : m_address("NO CONNECTION"), m_connected(false), m_hr(0)
+BLE_hrSensor::BLE_hrSensor(const string &address, int slot, SensorResource *gateway) :
+	m_samples(BLE_HR_QUEUE_SIZE), m_spilling(false), m_hasPending(false), m_hrv(BLE_HR_HRV_WINDOW), m_version(0), m_published(-1),
+	m_notifiedAt(0), m_address(address), m_slot(slot), m_gateway(gateway),
+	m_connected(true), m_hr(0), m_contact(-1), m_energy(-1), m_rr(-1), m_rmssd(0), m_sdnn(0),
+	m_notifyInterval(BLE_HR_NOTIFY_INTERVAL),
+	m_notifyDelta(BLE_HR_NOTIFY_DELTA)
 {
-	cout << "Running BLE_hrSensor constructor" << endl;
+	ALOG_INFO("Running BLE_hrSensor constructor");
+
+	m_name = BLE_HR_SENSOR_NAME;
+	m_uri = BLE_HR_SENSOR_RESOURCE_ENDPOINT;
+	if (slot > 0) {
+		m_name += std::to_string(slot);
+		m_uri += "/" + std::to_string(slot);
+	}
 
 	m_hrRepresentation.setValue("address", "NO CONNECTION");
 	m_hrRepresentation.setValue("heartRate", 0);
@@ -36,110 +52,176 @@ BLE_hrSensor::BLE_hrSensor() : m_address("NO CONNECTION"), m_connected(false), m
 
 BLE_hrSensor::~BLE_hrSensor()
 {
-    cout << "Running BLE_hrSensor destructor" << endl;
+    ALOG_INFO("Running BLE_hrSensor destructor");
 }
 
-void BLE_hrSensor::createResource()
+bool BLE_hrSensor::createResource()
 {
 	uint8_t resourceFlag = OC_DISCOVERABLE | OC_OBSERVABLE;
-	std::string resourceURI = BLE_HR_SENSOR_RESOURCE_ENDPOINT; // URI of the resource
+	std::string resourceURI = m_uri; // URI of the resource
 	std::string resourceTypeName = BLE_HR_SENSOR_RESOURCE_TYPE; // resource type name.
 	std::string resourceInterface = DEFAULT_INTERFACE; // resource interface.
 
 	EntityHandler cb = bind(&BLE_hrSensor::hrEntityHandler, this, placeholders::_1);
 	OCStackResult result = OCPlatform::registerResource(m_hrResource, resourceURI, resourceTypeName,
                                                                 resourceInterface, cb, resourceFlag);
-	if (result != OC_STACK_OK)
-		cerr << "Could not create " << m_hrResource << " resource" << endl;
-	else {
-		cout << "Successfully created " << m_hrResource << " resource" << endl;
-		//register resource server on Home Gateway;
-		if (sensor != NULL) {
-			cout << "register resource " << sensor << endl;
-			sensor->registerBle(BLE_HR_SENSOR_RESOURCE_ENDPOINT);
-		}
+	if (result != OC_STACK_OK) {
+		ALOG_ERROR("Could not create {} resource", m_uri);
+		return false;
 	}
+
+	ALOG_INFO("Successfully created {} resource", m_uri);
+	//register resource server on Home Gateway;
+	if (m_gateway != NULL)
+		m_gateway->registerBle(m_name);
+	return true;
 }
 
 void BLE_hrSensor::destroyResource()
 {
-	cout << "Destroy BLE Heart Rate sensor resource" << endl;
+	ALOG_INFO("Destroy BLE Heart Rate sensor resource {}", m_uri);
 
 	OCStackResult result = OCPlatform::unregisterResource(m_hrResource);
 	if (result != OC_STACK_OK) {
-		cerr << "Could not destroy: " << m_hrResource << endl;
+		ALOG_ERROR("Could not destroy: {}", m_uri);
 		return;
 	} else {
+		std::lock_guard<std::mutex> lock(m_observerLock);
 		m_hrObservers.clear();
-		cout << "Successfully destroy: " << m_hrResource<< endl;
+		ALOG_INFO("Successfully destroy: {}", m_uri);
 		//ungister resource server on Home Gateway;
-		if (sensor != NULL)
-			sensor->unregisterBle();
+		if (m_gateway != NULL)
+			m_gateway->unregisterBle(m_name);
 	}
 }
 
 OCRepresentation BLE_hrSensor::getRep()
 {
-        m_hrRepresentation.setUri(BLE_HR_SENSOR_RESOURCE_ENDPOINT);
-        m_hrRepresentation.setValue("address", m_address);
-        m_hrRepresentation.setValue("heartRate", m_hr);
-	return m_hrRepresentation;
+	// built afresh as the publisher and the entity handler both call it
+	OCRepresentation rep = m_hrRepresentation;
+
+	rep.setUri(m_uri);
+	rep.setValue("address", m_address);
+	rep.setValue("heartRate", m_hr.load());
+	if (m_contact >= 0)
+		rep.setValue("contact", m_contact == 1);
+	if (m_energy >= 0)
+		rep.setValue("energyExpended", m_energy.load());
+	if (m_rr >= 0) {
+		rep.setValue("rrInterval", m_rr.load());
+		rep.setValue("rmssd", m_rmssd.load());
+		rep.setValue("sdnn", m_sdnn.load());
+	}
+	return rep;
 }
 
 OCStackResult BLE_hrSensor::notify()
 {
-	shared_ptr<OCResourceResponse> resourceResponse(
-					new OCResourceResponse());
-
-        resourceResponse->setErrorCode(200);
-
-        resourceResponse->setResourceRepresentation(
-					getRep(), DEFAULT_INTERFACE);
+	ObservationIds observers;
+	{
+		std::lock_guard<std::mutex> lock(m_observerLock);
+		if (m_hrObservers.empty())
+			return OC_STACK_OK;
+		observers = m_hrObservers.ids();
+	}
 
-	return OCPlatform::notifyListOfObservers(m_hrResource,
-					m_hrObservers, resourceResponse);
+	gw_stats.ble_notifies++;
+	return m_notify.notify(m_hrResource, observers, m_version,
+					[this]() { return getRep(); }, GATEWAY_QOS);
 }
 
-static BLE_hrSensor hrSensor;
-static bt_gatt_attribute_h att_hr_hdl = NULL;
-
-static void _gatt_characteristic_changed_cb(
-					bt_gatt_attribute_h characteristic,
-					unsigned char *value,
-					int value_length,
-					void *user_data)
+// Called from the transport with every Heart Rate Measurement the
+// device sends, on the main loop for the GATT transports. Only decodes
+// and queues it; when the queue is full the sample spills to the
+// overflow list, which takes a lock only the publisher contends for,
+// rather than block the loop or lose a sample of the history.
+void BLE_hrSensor::ingest(const uint8_t *value, size_t length)
 {
-	int i;
+	hr_measurement_view view;
+	hr_sample sample;
 
-	//cout << "Heart Rate Value: " << (int) value[1] << endl;
+	if (!parse_hr_measurement(value, length, view)) {
+		ALOG_WARN("Malformed heart rate measurement from {}", m_address);
+		return;
+	}
+	ALOG_DEBUG("Heart Rate Value: {}", view.heart_rate);
 
-	hrSensor.m_hr = (int) value[1];
+	hr_sample_from_view(view, sample);
+	if (!m_spilling.load(std::memory_order_acquire) && m_samples.push(sample))
+		return;
 
-	hrSensor.notify();
+	std::lock_guard<std::mutex> lock(m_overflowLock);
+	m_overflow.push_back(sample);
+	m_spilling.store(true, std::memory_order_release);
+	gw_stats.ble_spilled++;
+}
 
-	if (sensor != NULL)
-		sensor->executeJumpingRule(hrSensor.m_hr);
+// Publisher side: the queue first, then the overflow. While spilling the
+// transport only adds to the overflow, so everything in the queue is
+// older; once both are empty the transport goes back to the queue.
+bool BLE_hrSensor::nextSample(hr_sample &sample)
+{
+	if (m_samples.pop(sample))
+		return true;
+	if (!m_spilling.load(std::memory_order_acquire))
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_overflowLock);
+	if (m_overflow.empty()) {
+		m_spilling.store(false, std::memory_order_release);
+		return false;
+	}
+	sample = m_overflow.front();
+	m_overflow.pop_front();
+	return true;
 }
 
-static void start_observe()
+bool BLE_hrSensor::queued()
 {
-	cout << "Start observer for BLE Heart Rate sensor" << endl;
-	hrSensor.m_hr = 80;
-
-	hrSensor.notify();
-	char * kk = (char *)att_hr_hdl;
-	cout << "hdl is" << kk << endl;
-	// bt_gatt_set_characteristic_changed_cb(att_hr_hdl,
-	// 			_gatt_characteristic_changed_cb, NULL);
+	return m_hasPending || m_samples.size() != 0 || m_spilling.load(std::memory_order_acquire);
 }
 
-static void stop_observe()
+// Hands every queued sample to the gateway's rule pipeline and history,
+// keeping it queued while the pipeline is full, and notifies the
+// observers of the heart rate resource at a bounded rate.
+bool BLE_hrSensor::drain(uint64_t now)
 {
-	cout << "Stop observer for BLE Heart Rate sensor" << endl;
-	char * kk = (char *)att_hr_hdl;
-	cout << "hdl is" << kk << endl;
+	// read before draining so samples queued up to the disconnect count
+	bool connected = m_connected;
+
+	for (;;) {
+		if (!m_hasPending && !nextSample(m_pending))
+			break;
+		m_hasPending = true;
+		if (m_gateway != NULL && !m_gateway->observeValue(m_name, BLE_HR_SENSOR_NAME,
+				"heartRate", m_pending.heart_rate))
+			break;
+		m_hasPending = false;
+		m_hr = m_pending.heart_rate;
+		if (m_pending.flags & HR_FLAG_CONTACT_SUPPORTED)
+			m_contact = (m_pending.flags & HR_FLAG_CONTACT_DETECTED) ? 1 : 0;
+		if (m_pending.flags & HR_FLAG_ENERGY)
+			m_energy = m_pending.energy;
+		for (int i = 0; i < m_pending.rr_count; i++)
+			m_hrv.add(m_pending.rr[i]);
+		if (m_pending.rr_count) {
+			m_rr = m_pending.rr[m_pending.rr_count - 1] * 1000 / 1024;
+			m_rmssd = m_hrv.rmssd();
+			m_sdnn = m_hrv.sdnn();
+		}
+		m_version++;
+		gw_stats.ble_samples++;
+	}
 
-	// bt_gatt_unset_characteristic_changed_cb(att_hr_hdl);
+	int hr = m_hr;
+	if (hr != m_published && (abs(hr - m_published) >= m_notifyDelta
+		|| now - m_notifiedAt >= (uint64_t)m_notifyInterval)) {
+		m_published = hr;
+		m_notifiedAt = now;
+		notify();
+	}
+
+	return !connected && !queued();
 }
 
 OCEntityHandlerResult BLE_hrSensor::hrEntityHandler(shared_ptr<OCResourceRequest> Request)
@@ -150,10 +232,10 @@ OCEntityHandlerResult BLE_hrSensor::hrEntityHandler(shared_ptr<OCResourceRequest
 		return result;
 
 	string requestType = Request->getRequestType();
-	cout << "requestType " << requestType << endl;
+	ALOG_DEBUG("requestType {}", requestType);
 
 	int requestFlag = Request->getRequestHandlerFlag();
-	cout << "requestFlag " << requestFlag << endl;
+	ALOG_DEBUG("requestFlag {}", requestFlag);
 
 	if (requestFlag & RequestHandlerFlag::RequestFlag) {
 
@@ -171,10 +253,10 @@ OCEntityHandlerResult BLE_hrSensor::hrEntityHandler(shared_ptr<OCResourceRequest
 
 			if (OCPlatform::sendResponse(Response) == OC_STACK_OK) {
 				result = OC_EH_OK;
-				cout << "SendResponse Successfully" << endl;
+				ALOG_DEBUG("SendResponse Successfully");
 			}
 			else
-				cout << "SendResponse error" << endl;
+				ALOG_ERROR("SendResponse error");
 
 		} else {
 
@@ -182,7 +264,7 @@ OCEntityHandlerResult BLE_hrSensor::hrEntityHandler(shared_ptr<OCResourceRequest
 
 			OCPlatform::sendResponse(Response);
 
-			cerr << "Unsupported request type" << endl;
+			ALOG_WARN("Unsupported request type");
 
 			return result;
 
@@ -195,100 +277,173 @@ OCEntityHandlerResult BLE_hrSensor::hrEntityHandler(shared_ptr<OCResourceRequest
 
 		if (ObserveAction::ObserveRegister == observationInfo.action) {
 
-			cout << "Register observer" << observationInfo.obsId << endl;
-
-			m_hrObservers.push_back(observationInfo.obsId);
+			ALOG_INFO("Register observer {} on {}", observationInfo.obsId, m_uri);
 
-			if(1 == m_hrObservers.size())
-				start_observe();
+			std::lock_guard<std::mutex> lock(m_observerLock);
+			m_hrObservers.add(observationInfo.obsId);
 
 		}else if (ObserveAction::ObserveUnregister ==
 						observationInfo.action) {
-			m_hrObservers.erase(
-				remove(m_hrObservers.begin(), m_hrObservers.end(),
-				observationInfo.obsId),
-				m_hrObservers.end());
+			std::lock_guard<std::mutex> lock(m_observerLock);
+			m_hrObservers.remove(observationInfo.obsId);
 
-			cout << "Unregister observer" << observationInfo.obsId << endl;
-
-			if(0 == m_hrObservers.size())
-				stop_observe();
+			ALOG_INFO("Unregister observer {} on {}", observationInfo.obsId, m_uri);
 		}
 	}
 
 	return result;
 }
 
-#define HEART_RATE_UUID "0000180d-0000-1000-8000-00805f9b34fb"
-
-bool bt_gatt_pri_src_cb(bt_gatt_attribute_h service, void *user_data)
+BLE_hrSensors::BLE_hrSensors() : m_transport(NULL), m_gateway(NULL), m_running(false)
 {
-	bt_device_connection_info_s *conn_info =
-		(bt_device_connection_info_s *)user_data;
-	char *uuid;
-
-	// bt_gatt_get_service_uuid(service, &uuid);
+}
 
-	cout << "UUID: " << uuid << endl;
+BLE_hrSensors::~BLE_hrSensors()
+{
+	stop();
+}
 
-	if (!g_strcmp0(uuid, HEART_RATE_UUID)) {
-		att_hr_hdl = service;
-		hrSensor.createResource();
-		hrSensor.m_address = conn_info->remote_address;
-		hrSensor.m_connected = true;
-		g_free(uuid);
+bool BLE_hrSensors::start(BleTransport *transport, SensorResource *gateway)
+{
+	m_transport = transport;
+	m_gateway = gateway;
+	m_running = true;
+	m_publisher = std::thread(&BLE_hrSensors::publish, this);
+
+	if (!transport->start(std::bind(&BLE_hrSensors::connectionChanged, this,
+			placeholders::_1, placeholders::_2))) {
+		stop();
 		return false;
 	}
-
-	g_free(uuid);
-
 	return true;
 }
 
-void get_hr_att_hdl(bt_device_connection_info_s *conn_info)
+void BLE_hrSensors::stop()
 {
-	att_hr_hdl = NULL;
+	// no more connections or notifications after this
+	if (m_transport)
+		m_transport->stop();
+	m_transport = NULL;
+	m_running = false;
+	if (m_publisher.joinable())
+		m_publisher.join();
+}
 
-	cout<<"get_hr_att_hdl"<<endl;
+void BLE_hrSensors::notification(void *context, const uint8_t *value, size_t length)
+{
+	((BLE_hrSensor *)context)->ingest(value, length);
+}
 
-//	if (conn_info->link != BT_DEVICE_CONNECTION_LINK_LE)
-//		return;
+void BLE_hrSensors::connected(const string &address)
+{
+	shared_ptr<BLE_hrSensor> hrSensor;
+	int slot;
 
-	// bt_gatt_foreach_primary_services(conn_info->remote_address,
-	//				bt_gatt_pri_src_cb, conn_info);
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_devices.count(address)) {
+			ALOG_INFO("Device {} already connected", address);
+			return;
+		}
+		if (!m_freeSlots.empty()) {
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else {
+			slot = m_slots.size();
+			m_slots.push_back(nullptr);
+		}
+		hrSensor = std::make_shared<BLE_hrSensor>(address, slot, m_gateway);
+		m_devices[address] = hrSensor;
+	}
+
+	// samples queue up until the publisher sees the sensor
+	bool subscribed = m_transport->subscribe(address, notification, hrSensor.get());
+	if (!subscribed)
+		ALOG_WARN("Device {} has no heart rate service", address);
+
+	if (!subscribed || !hrSensor->createResource()) {
+		if (subscribed)
+			m_transport->unsubscribe(address);
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_devices.erase(address);
+		m_freeSlots.push_back(slot);
+		return;
+	}
 
-	return;
+	// only now the publisher may see it
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_slots[slot] = hrSensor;
 }
 
+void BLE_hrSensors::connectionChanged(const string &address, bool connected)
+{
+	if (connected)
+		this->connected(address);
+	else
+		disconnected(address);
+}
 
-void bt_conn_state_changed_cb(bool connected,
-				bt_device_connection_info_s *conn_info,
-							void *user_data)
+void BLE_hrSensors::disconnected(const string &address)
 {
-	if(connected){
-		cout << "Device " << conn_info->remote_address << "connected" << endl;
-		sensor = (SensorResource *) user_data;
-		cout << "gateway sensor handle " << sensor << endl;
+	shared_ptr<BLE_hrSensor> hrSensor;
 
-		if (hrSensor.m_connected) {
-			cout << "Device " << hrSensor.m_address << "alread connected" << endl;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto iter = m_devices.find(address);
+		if (iter == m_devices.end())
 			return;
-		}
+		hrSensor = iter->second;
+		m_devices.erase(iter);
+	}
 
-		get_hr_att_hdl(conn_info);
-        	
-	} else {
-		cout << "Device " << conn_info->remote_address << "disconnected"<< endl;
+	m_transport->unsubscribe(address);
+	// the publisher releases it once its samples are through
+	hrSensor->m_connected = false;
+}
 
-		if (hrSensor.m_address.compare(conn_info->remote_address))
-			return;
+void BLE_hrSensors::publish()
+{
+	std::vector<shared_ptr<BLE_hrSensor> > slots;
+
+	for (bool running = true, queued = false; running || queued; ) {
+		// after stop(), passes go on until what is queued is through
+		running = m_running;
+		queued = false;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			slots = m_slots;
+		}
 
-		
-        	hrSensor.destroyResource();
-		hrSensor.m_address = "NO CONNECTION";
-		hrSensor.m_connected = false;
-		stop_observe();
+		uint64_t now = monotonic_ms();
+		for (auto &hrSensor : slots) {
+			if (!hrSensor)
+				continue;
+			if (!hrSensor->drain(now)) {
+				queued = queued || hrSensor->queued();
+				continue;
+			}
 
-		sensor = NULL;
+			hrSensor->destroyResource();
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_slots[hrSensor->m_slot] = nullptr;
+			m_freeSlots.push_back(hrSensor->m_slot);
+		}
+		slots.clear();
+
+		if (running || queued)
+			std::this_thread::sleep_for(std::chrono::milliseconds(BLE_HR_DRAIN_INTERVAL));
 	}
 }
+
+static BLE_hrSensors hrSensors;
+
+bool ble_hr_sensors_start(BleTransport *transport, SensorResource *gateway)
+{
+	return hrSensors.start(transport, gateway);
+}
+
+void ble_hr_sensors_stop()
+{
+	hrSensors.stop();
+}
@@ -24,39 +24,136 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <unordered_map>
 #include "ocstack.h"
 #include "OCPlatform.h"
 #include "OCApi.h"
 
-#include "bluetooth.h"
+#include "ble_transport.h"
+#include "observe_pipeline.h"
+#include "hr_measurement.h"
+#include "observer_set.h"
+#include "notify_mux.h"
 using namespace std;
 using namespace OC;
 
 #define BLE_HR_SENSOR_RESOURCE_ENDPOINT "/sensor/heartrate"
 #define BLE_HR_SENSOR_RESOURCE_TYPE "sensor.heartrate"
+#define BLE_HR_SENSOR_NAME "heartRate"
+#define BLE_HR_QUEUE_SIZE 1024
+// RMSSD and SDNN cover the RR intervals of the last minute
+#define BLE_HR_HRV_WINDOW 60000	// ms
+#define BLE_HR_DRAIN_INTERVAL 20	// ms
+// observers hear of a new heart rate at most once per interval, unless
+// it moved by at least the delta
+#define BLE_HR_NOTIFY_INTERVAL 1000	// ms
+#define BLE_HR_NOTIFY_DELTA 5
 
-void bt_conn_state_changed_cb(bool connected,
-				bt_device_connection_info_s *conn_info,
-						void *user_data);
+class SensorResource;
+
+// Follows the heart rate peripherals of 'transport' and publishes them
+// on 'gateway'.
+bool ble_hr_sensors_start(BleTransport *transport, SensorResource *gateway);
+// Stops the transport, hands the samples still queued to the gateway and
+// stops publishing; call before the gateway's SensorResource goes away.
+void ble_hr_sensors_stop();
+
+// One connected heart rate peripheral. The first one keeps the names the
+// gateway always used, "heartRate" on /sensor/heartrate; the one in slot
+// n is "heartRate<n>" on /sensor/heartrate/<n>. Rules naming "heartRate"
+// match all of them.
 class BLE_hrSensor
 {
     shared_ptr<PlatformConfig> m_platformConfig;
     OCRepresentation m_hrRepresentation;
     OCResourceHandle m_hrResource;
-    ObservationIds m_hrObservers;
+    ObserverSet m_hrObservers;
+    std::mutex m_observerLock;
+    // filled by the transport, drained by the publisher thread
+    SpscQueue<hr_sample> m_samples;
+    // where samples go while m_samples is full, and after it until the
+    // publisher caught up, so they keep their order and none is lost
+    std::deque<hr_sample> m_overflow;
+    std::mutex m_overflowLock;
+    std::atomic<bool> m_spilling;
+    hr_sample m_pending;
+    bool m_hasPending;
+    HrvWindow m_hrv;
+    // counts the samples taken in, so the state is encoded once per change
+    uint64_t m_version;
+    NotifyMux m_notify;
+    int m_published;
+    uint64_t m_notifiedAt;
 
     OCRepresentation getRep();
+    bool nextSample(hr_sample &sample);
 
     OCEntityHandlerResult hrEntityHandler(shared_ptr<OCResourceRequest>);
 public:
     string m_address;
-    bool m_connected;
-    int m_hr;
-    BLE_hrSensor();
-    void createResource();
+    string m_name;
+    string m_uri;
+    int m_slot;
+    SensorResource *m_gateway;
+    atomic<bool> m_connected;
+    atomic<int> m_hr;
+    // -1 while the peripheral has not sent them
+    atomic<int> m_contact;
+    atomic<int> m_energy;
+    atomic<int> m_rr;
+    atomic<double> m_rmssd;
+    atomic<double> m_sdnn;
+    int m_notifyInterval;
+    int m_notifyDelta;
+    BLE_hrSensor(const string &address, int slot, SensorResource *gateway);
+    bool createResource();
     void destroyResource();
+    void ingest(const uint8_t *value, size_t length);
+    // Publisher side; returns true once the sensor is disconnected and
+    // every sample it sent has been handed to the gateway.
+    bool drain(uint64_t now);
+    // Whether samples are still waiting for the gateway.
+    bool queued();
     OCStackResult notify();
     virtual ~BLE_hrSensor();
 };
 
+// The connected heart rate peripherals, by remote address. Connecting
+// and disconnecting are O(1); a GATT notification goes straight to its
+// sensor through the subscription's context. One publisher thread drains
+// all sensors, and a disconnected sensor's slot and resource are only
+// released once its queued samples are through.
+class BLE_hrSensors
+{
+	public:
+	BLE_hrSensors();
+	~BLE_hrSensors();
+
+	bool start(BleTransport *transport, SensorResource *gateway);
+	void stop();
+
+	private:
+	void connectionChanged(const string &address, bool connected);
+	void connected(const string &address);
+	void disconnected(const string &address);
+	void publish();
+	static void notification(void *context, const uint8_t *value, size_t length);
+
+	BleTransport *m_transport;
+	SensorResource *m_gateway;
+
+	std::mutex m_lock;
+	std::unordered_map<string, shared_ptr<BLE_hrSensor> > m_devices;
+	// what the publisher walks; a slot stays taken until drained
+	std::vector<shared_ptr<BLE_hrSensor> > m_slots;
+	std::vector<int> m_freeSlots;
+	std::atomic<bool> m_running;
+	std::thread m_publisher;
+};
+
 #endif /* SERVER_H_ */
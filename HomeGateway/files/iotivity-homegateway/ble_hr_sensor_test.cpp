@@ -0,0 +1,122 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Checks that BLE heart rate samples reach the history however far the
+// transport runs ahead of the publisher, built with "scons TESTS=1" and
+// run on the host. A thread standing in for the GATT callback ingests a
+// burst far larger than the sample queue while the publisher drains at
+// its usual interval; every sample must end up in the history, in
+// order. Exits non-zero on the first failure.
+//
+//	ble_hr_sensor_test [samples]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include "sensor_resource.h"
+#include "ble_hr_sensor.h"
+#include "gateway_stats.h"
+
+#define TEST_SAMPLES 20000
+#define TEST_STORE "/tmp/ble_hr_sensor_test.reg"
+#define TEST_TIMEOUT 10000
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+static uint64_t monotonic_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int run(SensorResource &gateway, SensorHistory &history, int count)
+{
+	BLE_hrSensor sensor("00:11:22:33:44:55", 0, &gateway);
+	std::vector<history_point> points;
+	bool truncated;
+
+	// 16 bit heart rates, so each sample carries its index
+	std::thread transport([&sensor, count]() {
+		for (int i = 0; i < count; i++) {
+			uint8_t value[3] = { HR_FLAG_UINT16, (uint8_t)(i & 0xff), (uint8_t)(i >> 8) };
+			sensor.ingest(value, sizeof(value));
+		}
+	});
+
+	uint64_t deadline = monotonic_ms() + TEST_TIMEOUT;
+	bool done = false;
+	while (!done && monotonic_ms() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(BLE_HR_DRAIN_INTERVAL));
+		sensor.drain(monotonic_ms());
+		done = gw_stats.ble_samples == count;
+	}
+	transport.join();
+	CHECK(done);
+	CHECK(!sensor.queued());
+
+	// the pipeline workers append to the history
+	do {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		points.clear();
+		history.query(BLE_HR_SENSOR_NAME, "heartRate", 0, INT64_MAX, 0, count + 1, points, truncated);
+	} while ((int)points.size() < count && monotonic_ms() < deadline);
+
+	printf("%d samples, %d spilled past the queue, %d in the history\n",
+		count, gw_stats.ble_spilled.load(), (int)points.size());
+	CHECK(gw_stats.ble_spilled > 0);
+	CHECK((int)points.size() == count && !truncated);
+	for (int i = 0; i < count; i++)
+		CHECK(points[i].value == i);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : TEST_SAMPLES;
+	PlatformConfig cfg(ServiceType::InProc, ModeType::Both, "127.0.0.1", 0, GATEWAY_QOS);
+
+	// enough to overflow the queue, few enough for 16 bit heart rates
+	if (count <= BLE_HR_QUEUE_SIZE || count > 65535)
+		count = TEST_SAMPLES;
+
+	OCPlatform::Configure(cfg);
+	unlink(TEST_STORE);
+
+	RegistryStore store(TEST_STORE);
+	AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+	SensorHistory history(16 * 1024 * 1024);
+	ConfigResource config(&admission);
+	RulesResource rules(&store);
+	SensorResource gateway(&rules, &config, &store, &history, &admission);
+	int result = run(gateway, history, count);
+
+	admission.stop();
+	unlink(TEST_STORE);
+	if (result == 0)
+		printf("ble_hr_sensor_test passed\n");
+	return result;
+}
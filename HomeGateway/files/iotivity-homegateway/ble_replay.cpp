@@ -0,0 +1,344 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Corporation.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Recorded heart rate peripherals ("replay" transport) and the recorder
+// that writes such recordings. A recording is a text file with a line
+// per event, the time in ms since the recording started, the peripheral
+// and what happened:
+//
+//   0 00:1A:7D:DA:71:13 connect
+//   1012 00:1A:7D:DA:71:13 164803
+//   60500 00:1A:7D:DA:71:13 disconnect
+//
+// where a notification is its value in hex. Lines starting with '#' are
+// comments. Replaying a recording gives every run the same input.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include "ble_transport.h"
+#include "async_log.h"
+
+#define BLE_REPLAY_LINE_MAX 1024
+
+class ReplayTransport : public BleTransport
+{
+	public:
+	ReplayTransport(const std::string &path, double speed);
+	~ReplayTransport();
+
+	virtual bool start(BleConnectionHandler handler);
+	virtual void stop();
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context);
+	virtual void unsubscribe(const std::string &address);
+
+	private:
+	struct subscription
+	{
+		BleNotificationHandler changed;
+		void *context;
+	};
+
+	void run();
+	bool wait(int64_t time_ms, std::chrono::steady_clock::time_point started);
+
+	std::string m_path;
+	double m_speed;
+	FILE *m_file;
+	BleConnectionHandler m_handler;
+	std::mutex m_lock;
+	std::unordered_map<std::string, subscription> m_subscriptions;
+	std::set<std::string> m_connected;
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+};
+
+ReplayTransport::ReplayTransport(const std::string &path, double speed) : m_path(path),
+	m_speed(speed), m_file(NULL), m_running(false)
+{
+}
+
+ReplayTransport::~ReplayTransport()
+{
+	stop();
+}
+
+bool ReplayTransport::start(BleConnectionHandler handler)
+{
+	m_file = fopen(m_path.c_str(), "r");
+	if (!m_file) {
+		ALOG_ERROR("Could not open BLE recording {}", m_path);
+		return false;
+	}
+
+	m_handler = handler;
+	m_running = true;
+	m_thread = std::thread(&ReplayTransport::run, this);
+	return true;
+}
+
+void ReplayTransport::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+	if (m_file) {
+		fclose(m_file);
+		m_file = NULL;
+	}
+}
+
+// Sleeps until the event at 'time_ms' is due, in slices so stop() is not
+// held up by a long gap in the recording.
+bool ReplayTransport::wait(int64_t time_ms, std::chrono::steady_clock::time_point started)
+{
+	if (m_speed <= 0)
+		return m_running;
+
+	auto due = started + std::chrono::microseconds((int64_t)(time_ms * 1000 / m_speed));
+	while (m_running) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= due)
+			return true;
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now,
+			std::chrono::milliseconds(100)));
+	}
+	return false;
+}
+
+static bool parse_hex(const char *text, std::vector<uint8_t> &value)
+{
+	size_t length = strlen(text);
+
+	if (length == 0 || length % 2)
+		return false;
+
+	value.clear();
+	for (size_t i = 0; i < length; i += 2) {
+		char byte[3] = { text[i], text[i + 1], 0 };
+		char *end;
+		value.push_back((uint8_t)strtoul(byte, &end, 16));
+		if (*end)
+			return false;
+	}
+	return true;
+}
+
+void ReplayTransport::run()
+{
+	auto started = std::chrono::steady_clock::now();
+	char line[BLE_REPLAY_LINE_MAX];
+	char address[BLE_REPLAY_LINE_MAX], event[BLE_REPLAY_LINE_MAX];
+	long long time_ms;
+	std::vector<uint8_t> value;
+	size_t events = 0, lineNo = 0;
+
+	ALOG_INFO("Replaying BLE recording {} at {}x", m_path, m_speed);
+
+	while (fgets(line, sizeof(line), m_file)) {
+		lineNo++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%lld %s %s", &time_ms, address, event) != 3) {
+			ALOG_WARN("{}:{}: malformed line", m_path, lineNo);
+			continue;
+		}
+		if (!wait(time_ms, started))
+			break;
+
+		events++;
+		if (!strcmp(event, "connect")) {
+			if (m_connected.insert(address).second)
+				m_handler(address, true);
+		}
+		else if (!strcmp(event, "disconnect")) {
+			if (m_connected.erase(address))
+				m_handler(address, false);
+		}
+		else if (parse_hex(event, value)) {
+			std::lock_guard<std::mutex> lock(m_lock);
+			auto iter = m_subscriptions.find(address);
+			if (iter != m_subscriptions.end())
+				iter->second.changed(iter->second.context, value.data(), value.size());
+		}
+		else {
+			ALOG_WARN("{}:{}: unknown event {}", m_path, lineNo, event);
+		}
+	}
+
+	// the recording is over, so are its connections
+	for (auto &peripheral : m_connected)
+		m_handler(peripheral, false);
+	m_connected.clear();
+	ALOG_INFO("BLE recording {} done, {} events", m_path, events);
+}
+
+bool ReplayTransport::subscribe(const std::string &address, BleNotificationHandler handler,
+	void *context)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_subscriptions[address] = subscription{handler, context};
+	return true;
+}
+
+void ReplayTransport::unsubscribe(const std::string &address)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_subscriptions.erase(address);
+}
+
+BleTransport *ble_replay_create(const std::string &path, double speed)
+{
+	return new ReplayTransport(path, speed);
+}
+
+// Passes everything through to the transport it wraps and writes it down.
+class RecorderTransport : public BleTransport
+{
+	public:
+	RecorderTransport(BleTransport *transport, const std::string &path);
+	~RecorderTransport();
+
+	virtual bool start(BleConnectionHandler handler);
+	virtual void stop();
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context);
+	virtual void unsubscribe(const std::string &address);
+
+	private:
+	struct subscription
+	{
+		RecorderTransport *recorder;
+		std::string address;
+		BleNotificationHandler changed;
+		void *context;
+	};
+
+	static void notification(void *context, const uint8_t *value, size_t length);
+	void record(const std::string &address, const char *event);
+
+	std::unique_ptr<BleTransport> m_transport;
+	std::string m_path;
+	FILE *m_file;
+	std::chrono::steady_clock::time_point m_started;
+	std::mutex m_fileLock;
+	std::mutex m_lock;
+	std::unordered_map<std::string, std::unique_ptr<subscription> > m_subscriptions;
+};
+
+RecorderTransport::RecorderTransport(BleTransport *transport, const std::string &path) :
+	m_transport(transport), m_path(path), m_file(NULL)
+{
+}
+
+RecorderTransport::~RecorderTransport()
+{
+	stop();
+}
+
+bool RecorderTransport::start(BleConnectionHandler handler)
+{
+	m_file = fopen(m_path.c_str(), "w");
+	if (!m_file) {
+		ALOG_ERROR("Could not create BLE recording {}", m_path);
+		return false;
+	}
+
+	ALOG_INFO("Recording BLE to {}", m_path);
+	m_started = std::chrono::steady_clock::now();
+	return m_transport->start([this, handler](const std::string &address, bool connected) {
+		record(address, connected ? "connect" : "disconnect");
+		handler(address, connected);
+	});
+}
+
+void RecorderTransport::stop()
+{
+	m_transport->stop();
+
+	std::lock_guard<std::mutex> lock(m_fileLock);
+	if (m_file) {
+		fclose(m_file);
+		m_file = NULL;
+	}
+}
+
+void RecorderTransport::record(const std::string &address, const char *event)
+{
+	long long time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - m_started).count();
+
+	std::lock_guard<std::mutex> lock(m_fileLock);
+	if (m_file)
+		fprintf(m_file, "%lld %s %s\n", time_ms, address.c_str(), event);
+}
+
+void RecorderTransport::notification(void *context, const uint8_t *value, size_t length)
+{
+	subscription *entry = (subscription *)context;
+	char hex[BLE_REPLAY_LINE_MAX];
+	size_t used = 0;
+
+	for (size_t i = 0; i < length && used + 3 <= sizeof(hex); i++)
+		used += snprintf(hex + used, sizeof(hex) - used, "%02x", value[i]);
+	hex[used] = 0;
+
+	entry->recorder->record(entry->address, hex);
+	entry->changed(entry->context, value, length);
+}
+
+bool RecorderTransport::subscribe(const std::string &address, BleNotificationHandler handler,
+	void *context)
+{
+	subscription *entry = new subscription{this, address, handler, context};
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_subscriptions[address].reset(entry);
+	}
+	if (m_transport->subscribe(address, notification, entry))
+		return true;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_subscriptions.erase(address);
+	return false;
+}
+
+void RecorderTransport::unsubscribe(const std::string &address)
+{
+	m_transport->unsubscribe(address);
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_subscriptions.erase(address);
+}
+
+BleTransport *ble_recorder_create(BleTransport *transport, const std::string &path)
+{
+	return new RecorderTransport(transport, path);
+}
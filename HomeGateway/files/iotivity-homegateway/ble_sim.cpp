@@ -0,0 +1,200 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Simulated heart rate peripherals ("sim" transport). It connects a
+// number of them that send a notification each period and, to exercise
+// connect and disconnect, drops and reconnects one of them now and then.
+// The notifications carry an 8 bit heart rate and one RR interval.
+//
+//   HG_BLE_SIM_DEVICES  peripherals to connect (BLE_SIM_DEVICES)
+//   HG_BLE_SIM_RATE     notifications per second per device (1)
+//   HG_BLE_SIM_CHURN    seconds between reconnects, 0 for none (10)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include "ble_transport.h"
+#include "async_log.h"
+
+#define BLE_SIM_DEVICES 100
+
+class SimTransport : public BleTransport
+{
+	public:
+	SimTransport();
+	~SimTransport();
+
+	virtual bool start(BleConnectionHandler handler);
+	virtual void stop();
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context);
+	virtual void unsubscribe(const std::string &address);
+
+	private:
+	struct device
+	{
+		std::string address;
+		int hr;
+		bool connected;
+		BleNotificationHandler changed;
+		void *context;
+	};
+
+	void run();
+	void connect(device &peripheral, bool connected);
+
+	std::mutex m_lock;
+	std::vector<device> m_devices;
+	std::unordered_map<std::string, size_t> m_byAddress;
+	BleConnectionHandler m_handler;
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+};
+
+static int sim_setting(const char *name, int fallback)
+{
+	const char *value = getenv(name);
+
+	return value ? atoi(value) : fallback;
+}
+
+SimTransport::SimTransport() : m_running(false)
+{
+	int count = sim_setting("HG_BLE_SIM_DEVICES", BLE_SIM_DEVICES);
+	char address[18];
+
+	m_devices.resize(count > 0 ? count : 0);
+	for (int i = 0; i < count; i++) {
+		device &peripheral = m_devices[i];
+		snprintf(address, sizeof(address), "00:1A:7D:DA:%02X:%02X", (i >> 8) & 0xff, i & 0xff);
+		peripheral.address = address;
+		peripheral.hr = 60 + rand() % 60;
+		peripheral.connected = false;
+		peripheral.changed = NULL;
+		peripheral.context = NULL;
+		m_byAddress[peripheral.address] = i;
+	}
+}
+
+SimTransport::~SimTransport()
+{
+	stop();
+}
+
+bool SimTransport::start(BleConnectionHandler handler)
+{
+	m_handler = handler;
+	m_running = true;
+	m_thread = std::thread(&SimTransport::run, this);
+	return true;
+}
+
+void SimTransport::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void SimTransport::connect(device &peripheral, bool connected)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		peripheral.connected = connected;
+	}
+	m_handler(peripheral.address, connected);
+}
+
+void SimTransport::run()
+{
+	int rate = sim_setting("HG_BLE_SIM_RATE", 1);
+	int churn = sim_setting("HG_BLE_SIM_CHURN", 10) * 1000;
+	int period = rate > 0 ? 1000 / rate : 1000;
+	int sinceChurn = 0;
+	device *dropped = NULL;
+
+	for (auto &peripheral : m_devices)
+		connect(peripheral, true);
+	ALOG_INFO("BLE simulator: {} devices, {} notifications/s each", m_devices.size(), rate);
+
+	while (m_running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(period));
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			for (auto &peripheral : m_devices) {
+				if (!peripheral.connected || !peripheral.changed)
+					continue;
+				// wander between 50 and 190 bpm
+				peripheral.hr += rand() % 5 - 2;
+				if (peripheral.hr < 50 || peripheral.hr > 190)
+					peripheral.hr = 120;
+				// contact detected, one RR interval (1/1024 s) with some jitter
+				int rr = 60 * 1024 / peripheral.hr + rand() % 41 - 20;
+				uint8_t value[4] = { 0x16, (uint8_t)peripheral.hr,
+					(uint8_t)(rr & 0xff), (uint8_t)(rr >> 8) };
+				peripheral.changed(peripheral.context, value, sizeof(value));
+			}
+		}
+
+		sinceChurn += period;
+		if (churn > 0 && sinceChurn >= churn && !m_devices.empty()) {
+			sinceChurn = 0;
+			if (dropped)
+				connect(*dropped, true);
+			dropped = &m_devices[rand() % m_devices.size()];
+			connect(*dropped, false);
+		}
+	}
+}
+
+bool SimTransport::subscribe(const std::string &address, BleNotificationHandler handler,
+	void *context)
+{
+	auto iter = m_byAddress.find(address);
+	if (iter == m_byAddress.end())
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_devices[iter->second].changed = handler;
+	m_devices[iter->second].context = context;
+	return true;
+}
+
+void SimTransport::unsubscribe(const std::string &address)
+{
+	auto iter = m_byAddress.find(address);
+	if (iter == m_byAddress.end())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_devices[iter->second].changed = NULL;
+	m_devices[iter->second].context = NULL;
+}
+
+BleTransport *ble_sim_create()
+{
+	return new SimTransport();
+}
@@ -0,0 +1,63 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdlib.h>
+#include "ble_transport.h"
+#include "async_log.h"
+
+BleTransport *ble_transport_create(const std::string &spec, const std::string &record)
+{
+	BleTransport *transport = NULL;
+
+	if (spec == "bluez") {
+		transport = ble_bluez_create();
+	}
+	else if (spec == "capi") {
+		transport = ble_capi_create();
+	}
+	else if (spec == "sim") {
+		transport = ble_sim_create();
+	}
+	else if (spec.compare(0, 7, "replay:") == 0) {
+		std::string path = spec.substr(7);
+		double speed = 1;
+		size_t at = path.rfind('@');
+		if (at != std::string::npos) {
+			speed = atof(path.c_str() + at + 1);
+			path.erase(at);
+		}
+		transport = ble_replay_create(path, speed);
+	}
+	else if (!spec.empty()) {
+		ALOG_ERROR("Unknown BLE transport {}", spec);
+	}
+
+	if (transport && !record.empty())
+		transport = ble_recorder_create(transport, record);
+	return transport;
+}
+
+#ifndef HAVE_BT_CAPI
+BleTransport *ble_capi_create()
+{
+	ALOG_ERROR("Built without the platform Bluetooth API");
+	return NULL;
+}
+#endif
@@ -0,0 +1,71 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef BLE_TRANSPORT_H_
+#define BLE_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <functional>
+
+typedef void (*BleNotificationHandler)(void *context, const uint8_t *value, size_t length);
+typedef std::function<void(const std::string &address, bool connected)> BleConnectionHandler;
+
+// Where heart rate peripherals come from. A transport reports the
+// peripherals that connect and disconnect and, once one is subscribed,
+// passes on each of its Heart Rate Measurement notifications. subscribe
+// and unsubscribe are called from the connection handler; notifications
+// of one peripheral always come from the same thread.
+class BleTransport
+{
+	public:
+	virtual ~BleTransport() {}
+
+	virtual bool start(BleConnectionHandler handler) = 0;
+	// No handler is called once stop() returns.
+	virtual void stop() = 0;
+
+	// Returns false when 'address' has no heart rate service.
+	virtual bool subscribe(const std::string &address, BleNotificationHandler handler,
+			void *context) = 0;
+	virtual void unsubscribe(const std::string &address) = 0;
+};
+
+// Creates the transport 'spec' names:
+//
+//   bluez                       BlueZ over D-Bus
+//   capi                        the platform Bluetooth API, when built in
+//   sim                         generated peripherals, see ble_sim.cpp
+//   replay:<file>[@<speed>]     a recording, 'speed' times as fast as it
+//                               happened (1); 0 for as fast as possible
+//
+// With 'record' set, the connections and notifications of the transport
+// are also written to that file, in the format replay reads. Returns
+// NULL for an empty or unknown spec.
+BleTransport *ble_transport_create(const std::string &spec, const std::string &record);
+
+BleTransport *ble_bluez_create();
+BleTransport *ble_capi_create();
+BleTransport *ble_sim_create();
+BleTransport *ble_replay_create(const std::string &path, double speed);
+BleTransport *ble_recorder_create(BleTransport *transport, const std::string &path);
+
+#endif /* BLE_TRANSPORT_H_ */
@@ -20,13 +20,23 @@
 
 #include "config_resource.h"
 #include "homegateway.h"
+#include "async_log.h"
+#include "sensor_registry.h"
 
-ConfigResource::ConfigResource() : m_ledState(false), m_ledColor(BLUE)
+static std::string timeout_attribute(int kind)
 {
+	return sensor_kind_name((sensor_kind)kind) + (kind == SENSOR_UNKNOWN ? "timeout" : "Timeout");
+}
+
+ConfigResource::ConfigResource(AdmissionControl *admission) : m_ledState(false), m_ledColor(BLUE)
+{
+	for (auto &timeout : m_timeouts)
+		timeout = DEFAULT_TIMEOUT;
+
 	std::string resourceURI = CONFIG_RESOURCE_ENDPOINT;
 	std::string resourceTypeName = CONFIG_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
-	EntityHandler cb = std::bind(&ConfigResource::entityHandler, this,PH::_1);
+	EntityHandler cb = admission->wrap(std::bind(&ConfigResource::entityHandler, this,PH::_1));
 	uint8_t resourceProperty = OC_DISCOVERABLE;
 	OCStackResult result = OCPlatform::registerResource(m_resourceHandle,
 	resourceURI,
@@ -45,6 +55,8 @@ OCRepresentation ConfigResource::get()
 	m_rep.setUri(CONFIG_RESOURCE_ENDPOINT);
 	m_rep.setValue("ledState", m_ledState);
 	m_rep.setValue("ledColor", m_ledColor);
+	for (int kind = 0; kind < SENSOR_KIND_MAX; kind++)
+		m_rep.setValue(timeout_attribute(kind), m_timeouts[kind].load());
 	return m_rep;
 }
 
@@ -52,14 +64,18 @@ void ConfigResource::put(OCRepresentation rep)
 {
 	rep.getValue("ledState", m_ledState);
 	rep.getValue("ledColor", m_ledColor);
+	for (int kind = 0; kind < SENSOR_KIND_MAX; kind++) {
+		int timeout;
+		if (rep.getValue(timeout_attribute(kind), timeout) && timeout > 0)
+			m_timeouts[kind] = timeout;
+	}
 }
 
 OCEntityHandlerResult ConfigResource::entityHandler(std::shared_ptr<OCResourceRequest> request)
  {
 	OCEntityHandlerResult ehResult = OC_EH_ERROR;
 	if(request) {
-		std::cout << "In entity handler for Config Resource, URI is : "
-			<< request->getResourceUri() << std::endl;
+		ALOG_DEBUG("In entity handler for Config Resource, URI is : {}", request->getResourceUri());
 
 		if(request->getRequestHandlerFlag() == RequestHandlerFlag::RequestFlag) {
 			auto pResponse = std::make_shared<OC::OCResourceResponse>();
@@ -67,7 +83,7 @@ OCEntityHandlerResult ConfigResource::entityHandler(std::shared_ptr<OCResourceRe
 			pResponse->setResourceHandle(request->getResourceHandle());
 
 			if(request->getRequestType() == "GET") {
-				std::cout<<"Configuration Get Request"<<std::endl;
+				ALOG_DEBUG("Configuration Get Request");
 				pResponse->setErrorCode(200);
 				pResponse->setResourceRepresentation(get(), "");
 				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
@@ -75,7 +91,7 @@ OCEntityHandlerResult ConfigResource::entityHandler(std::shared_ptr<OCResourceRe
 				}
 			}
 			else if(request->getRequestType() == "PUT") {
-				std::cout <<"Configuration Put Request"<<std::endl;
+				ALOG_DEBUG("Configuration Put Request");
 				put(request->getResourceRepresentation());
 				pResponse->setErrorCode(200);
 				pResponse->setResourceRepresentation(get(), "");
@@ -84,15 +100,14 @@ OCEntityHandlerResult ConfigResource::entityHandler(std::shared_ptr<OCResourceRe
 				}
 			}
 			else {
-				std::cout << "Configuration unsupported request type"
-				<< request->getRequestType() << std::endl;
+				ALOG_WARN("Configuration unsupported request type {}", request->getRequestType());
 				pResponse->setResponseResult(OC_EH_ERROR);
 				OCPlatform::sendResponse(pResponse);
 				ehResult = OC_EH_ERROR;
 			}
 		}
 		else {
-			std::cout << "Configuration unsupported request flag" <<std::endl;
+			ALOG_WARN("Configuration unsupported request flag");
 		}
 	}
 
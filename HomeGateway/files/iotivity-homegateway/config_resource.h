@@ -20,14 +20,20 @@
 
 #ifndef CONFIG_RESOURCE_H_
 #define CONFIG_RESOURCE_H_
+#include <atomic>
 #include "resource.h"
+#include "homegateway.h"
+#include "admission.h"
 
 class ConfigResource : public Resource
 {
 	public:
 	bool m_ledState;
 	int m_ledColor;
-	ConfigResource();
+	// seconds of silence after which a sensor of each kind is offline;
+	// read by the main loop while a PUT may change it
+	std::atomic<int> m_timeouts[SENSOR_KIND_MAX];
+	ConfigResource(AdmissionControl *admission);
 	private:
 	OCRepresentation get();
 	void put(OCRepresentation rep);
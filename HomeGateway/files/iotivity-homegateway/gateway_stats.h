@@ -0,0 +1,49 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef GATEWAY_STATS_H_
+#define GATEWAY_STATS_H_
+
+#include <atomic>
+
+// Counters published through the /gw/stat resource.
+struct gateway_stats
+{
+	std::atomic<int> puts_sent;
+	std::atomic<int> puts_saved;
+	std::atomic<int> puts_dropped;
+	std::atomic<int> puts_timed_out;
+	std::atomic<int> events_processed;
+	std::atomic<int> events_dropped;
+	std::atomic<int> multicast_discoveries;
+	std::atomic<int> multicasts_per_minute;
+	std::atomic<int> unicast_observes;
+	std::atomic<int> requests_queued;
+	std::atomic<int> requests_rejected;
+	std::atomic<int> requests_limited;
+	std::atomic<int> request_p99_us;
+	std::atomic<int> ble_samples;
+	std::atomic<int> ble_spilled;
+	std::atomic<int> ble_notifies;
+};
+
+extern gateway_stats gw_stats;
+
+#endif /* GATEWAY_STATS_H_ */
@@ -0,0 +1,144 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "history_resource.h"
+#include "homegateway.h"
+#include "async_log.h"
+
+#define DEFAULT_HISTORY_RANGE 3600000	// ms
+
+static int64_t query_time(const QueryParamsMap &query, const char *name, int64_t fallback)
+{
+	auto iter = query.find(name);
+
+	return iter == query.end() ? fallback : strtoll(iter->second.c_str(), NULL, 10);
+}
+
+HistoryResource::HistoryResource(SensorHistory *history, AdmissionControl *admission) : m_history(history)
+{
+	std::string resourceURI = HISTORY_RESOURCE_ENDPOINT;
+	std::string resourceTypeName = HISTORY_RESOURCE_TYPE;
+	std::string resourceInterface = DEFAULT_INTERFACE;
+	EntityHandler cb = admission->wrap(std::bind(&HistoryResource::entityHandler, this,PH::_1));
+	uint8_t resourceProperty = OC_DISCOVERABLE;
+	OCStackResult result = OCPlatform::registerResource(m_resourceHandle,
+	resourceURI,
+	resourceTypeName,
+	resourceInterface,
+	cb,
+	resourceProperty);
+
+	if(OC_STACK_OK != result) {
+		throw std::runtime_error(
+		std::string("History Resource failed to start")+std::to_string(result));
+	}
+}
+
+// GET /gw/history lists the recorded series as "series". With source and
+// attribute it returns their samples between from and to (ms since the
+// epoch, or before now when negative; the last hour by default) as comma
+// separated "times" and "values". Samples are averaged over step ms long
+// buckets, widened so that at most HISTORY_MAX_POINTS come back. Raw
+// samples are cut off after HISTORY_MAX_POINTS, with "truncated" set, as
+// several may share a second.
+OCRepresentation HistoryResource::get(const QueryParamsMap &query)
+{
+	OCRepresentation rep;
+	auto source = query.find("source");
+	auto attribute = query.find("attribute");
+	std::vector<history_point> points;
+	bool truncated = false;
+	std::string times, values;
+	char value[32];
+
+	rep.setUri(HISTORY_RESOURCE_ENDPOINT);
+	if (source == query.end() || attribute == query.end()) {
+		std::string series;
+		for (auto &name : m_history->series()) {
+			if (!series.empty())
+				series += ",";
+			series += name;
+		}
+		rep.setValue("series", series);
+		return rep;
+	}
+
+	int64_t now = SensorHistory::now_ms();
+	int64_t to = query_time(query, "to", now);
+	if (to < 0)
+		to += now;
+	int64_t from = query_time(query, "from", to - DEFAULT_HISTORY_RANGE);
+	if (from < 0)
+		from += now;
+	int64_t step = query_time(query, "step", 0);
+	int64_t minStep = (to - from + HISTORY_MAX_POINTS - 1) / HISTORY_MAX_POINTS;
+	if (minStep > HISTORY_RESOLUTION_MS && step < minStep)
+		step = minStep;
+
+	m_history->query(source->second, attribute->second, from, to, step, HISTORY_MAX_POINTS,
+		points, truncated);
+	for (auto &point : points) {
+		if (!times.empty()) {
+			times += ",";
+			values += ",";
+		}
+		times += std::to_string(point.time_ms);
+		snprintf(value, sizeof(value), "%g", point.value);
+		values += value;
+	}
+
+	rep.setValue("source", source->second);
+	rep.setValue("attribute", attribute->second);
+	rep.setValue("from", std::to_string(from));
+	rep.setValue("to", std::to_string(to));
+	rep.setValue("step", (int)step);
+	rep.setValue("times", times);
+	rep.setValue("values", values);
+	rep.setValue("truncated", truncated);
+	return rep;
+}
+
+OCEntityHandlerResult HistoryResource::entityHandler(std::shared_ptr<OCResourceRequest> request)
+{
+	OCEntityHandlerResult ehResult = OC_EH_ERROR;
+	if(request) {
+		if(request->getRequestHandlerFlag() == RequestHandlerFlag::RequestFlag) {
+			auto pResponse = std::make_shared<OC::OCResourceResponse>();
+			pResponse->setRequestHandle(request->getRequestHandle());
+			pResponse->setResourceHandle(request->getResourceHandle());
+
+			if(request->getRequestType() == "GET") {
+				pResponse->setErrorCode(200);
+				pResponse->setResourceRepresentation(get(request->getQueryParameters()), "");
+				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
+					ehResult = OC_EH_OK;
+				}
+			}
+			else {
+				ALOG_WARN("History unsupported request type {}", request->getRequestType());
+				pResponse->setResponseResult(OC_EH_ERROR);
+				OCPlatform::sendResponse(pResponse);
+				ehResult = OC_EH_ERROR;
+			}
+		}
+	}
+
+	return ehResult;
+}
@@ -0,0 +1,38 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef HISTORY_RESOURCE_H_
+#define HISTORY_RESOURCE_H_
+#include "resource.h"
+#include "admission.h"
+#include "sensor_history.h"
+
+class HistoryResource : public Resource
+{
+	public:
+	SensorHistory *m_history;
+	HistoryResource(SensorHistory *history, AdmissionControl *admission);
+	private:
+	OCRepresentation get(const QueryParamsMap &query);
+	protected:
+	virtual OCEntityHandlerResult entityHandler(std::shared_ptr<OCResourceRequest> request);
+};
+
+#endif /* HISTORY_RESOURCE_H_ */
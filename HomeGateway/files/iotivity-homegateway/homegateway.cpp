@@ -25,25 +25,24 @@
 #include "config_resource.h"
 #include "sensor_resource.h"
 #include "rules_resource.h"
+#include "stats_resource.h"
+#include "registry_store.h"
+#include "admission.h"
+#include "sensor_history.h"
+#include "history_resource.h"
 
-gboolean active_check_cb(gpointer user_data)
+gboolean liveness_tick_cb(gpointer user_data)
 {
 	SensorResource *sensor = (SensorResource *)user_data;
-	sensor->activeCheck();
+	sensor->livenessTick();
 
-	return false;
+	return true;
 }
 
-gboolean sensor_expire_cb(gpointer user_data)
+gboolean actuation_flush_cb(gpointer user_data)
 {
 	SensorResource *sensor = (SensorResource *)user_data;
-	sensor->resetStatus();
-
-	//by default we reset the status every 5 seconds and 
-	//the sensor will send active notification every 1.5 seconds
-	//the active check interval is 4 seconds, then we may have
-	//at lease receive two active notificaiton form the sensor
-	g_timeout_add_seconds(ACTIVE_INTERVAL, active_check_cb, sensor);
+	sensor->flushActuations();
 
 	return true;
 }
@@ -64,32 +63,51 @@ int main ()
 	sigaction(SIGINT, &sa, NULL);
 	cout << "Press Ctrl-C to quit...." << endl;
 
-	// bt_initialize();
-
 	PlatformConfig cfg
 	{
 		ServiceType::InProc,
 		ModeType::Both,
 		"0.0.0.0", // By setting to "0.0.0.0", it binds to all available interfaces
 		8888,         // Uses 8888 for homegateway
-		QualityOfService::HighQos
+		GATEWAY_QOS
 	};
 
 	std::cout << "Initializing gateway platform config" << endl;
 	OCPlatform::Configure(cfg);
 
-	ConfigResource config;
-	RulesResource rule;
-	SensorResource sensor(&rule);
-
-	rule.registerResource();
-
-	// bt_device_set_connection_state_changed_cb(bt_conn_state_changed_cb, &sensor);
+	RegistryStore store(REGISTRY_STORE_PATH);
+	AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+	// HG_HISTORY_MB sizes the sample history, see HISTORY_BUDGET_MB
+	const char *historyMb = getenv("HG_HISTORY_MB");
+	size_t historyBudget = historyMb ? strtoul(historyMb, NULL, 10) : 0;
+	if (historyBudget == 0)
+		historyBudget = HISTORY_BUDGET_MB;
+	SensorHistory history(historyBudget * 1024 * 1024);
+	ConfigResource config(&admission);
+	RulesResource rule(&store);
+	SensorResource sensor(&rule, &config, &store, &history, &admission);
+	StatsResource stats;
+	HistoryResource historyResource(&history, &admission);
+
+	rule.registerResource(&admission);
+	sensor.restore();
+
+	// HG_BLE picks the transport heart rate peripherals come from, see
+	// ble_transport.h; HG_BLE_RECORD records them for a later replay
+	const char *bleSpec = getenv("HG_BLE");
+	const char *bleRecord = getenv("HG_BLE_RECORD");
+	std::unique_ptr<BleTransport> ble(ble_transport_create(bleSpec ? bleSpec : BLE_TRANSPORT_DEFAULT,
+		bleRecord ? bleRecord : ""));
+	if (ble && !ble_hr_sensors_start(ble.get(), &sensor))
+		std::cout << "BLE transport failed to start" << std::endl;
 
 	loop = g_main_loop_new(NULL, FALSE);
 
-	g_timeout_add_seconds(DEFAULT_TIMEOUT, sensor_expire_cb, &sensor);
+	g_timeout_add(LIVENESS_TICK, liveness_tick_cb, &sensor);
+	g_timeout_add(ACTUATION_FLUSH_INTERVAL, actuation_flush_cb, &sensor);
 	g_main_loop_run(loop);
+	ble_hr_sensors_stop();
+	admission.stop();
 
 	return 0;
 }
@@ -28,9 +28,9 @@
 #include <map>
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "ble_hr_sensor.h"
-#include "bluetooth.h"
 
 #include "OCPlatform.h"
 #include "OCApi.h"
@@ -38,7 +38,30 @@
 #include "resource.h"
 
 #define DEFAULT_TIMEOUT 5
-#define ACTIVE_INTERVAL 4
+// QoS of the platform and of every observe notification
+#define GATEWAY_QOS QualityOfService::HighQos
+#define LIVENESS_TICK 100
+#define OBSERVE_QUEUE_SIZE 1024
+#define ACTUATION_FLUSH_INTERVAL 250
+// a PUT without a response after this long is sent again
+#define ACTUATION_TIMEOUT 5000
+#define SENSOR_CHANGE_LOG 256
+#define ADMISSION_QUEUE_SIZE 256
+#define ADMISSION_RATE 20
+#define ADMISSION_BURST 40
+#define DISCOVERY_BACKOFF_MIN 1000
+#define DISCOVERY_BACKOFF_MAX 300000
+#define REGISTRY_STORE_PATH "/var/lib/homegateway.reg"
+// Memory of the sample history in MB; HG_HISTORY_MB overrides it at
+// startup. The default keeps a week of HISTORY_BUDGET_SERIES series
+// sampled at 1 Hz whose value moves a few counts about one sample in
+// four, which the packed columns store in 0.22 MB a week. A series
+// that changes with every sample, like a heart rate, takes 0.45 to 0.7
+// MB a week and plain noise 1 MB.
+#define HISTORY_BUDGET_MB 128
+#define HISTORY_BUDGET_SERIES 500
+#define HISTORY_MAX_POINTS 1000
+#define BLE_TRANSPORT_DEFAULT "bluez"
 
 #define CONFIG_RESOURCE_ENDPOINT "/gw/con"
 #define CONFIG_RESOURCE_TYPE "gw.config"
@@ -46,6 +69,10 @@
 #define RULES_RESOURCE_TYPE "gw.rule"
 #define SENSOR_RESOURCE_ENDPOINT "/gw/sensor"
 #define SENSOR_RESOURCE_TYPE "gw.sensor"
+#define STATS_RESOURCE_ENDPOINT "/gw/stat"
+#define STATS_RESOURCE_TYPE "gw.stat"
+#define HISTORY_RESOURCE_ENDPOINT "/gw/history"
+#define HISTORY_RESOURCE_TYPE "gw.history"
 
 #define RED 9
 #define BLUE 10
@@ -58,11 +85,45 @@ typedef std::vector<std::string> SensorVector;
 using namespace OC;
 namespace PH = std::placeholders;
 
+enum sensor_kind
+{
+	SENSOR_UNKNOWN = 0,
+	SENSOR_GAS,
+	SENSOR_FAN,
+	SENSOR_LED,
+	SENSOR_PIR,
+	SENSOR_KIND_MAX
+};
+
 struct sensor_data
 {
 	std::string s_name;
+	std::string s_type;
+	std::string s_uri;
+	sensor_kind s_kind;
+	uint32_t s_sourceId;
+	const std::string *s_source;
 	std::shared_ptr<OCResource> s_resource;
 	bool s_active;
+	// endpoint the sensor was last bound to, kept after it goes offline
+	std::string s_host;
+	std::string s_path;
+	SensorVector s_resourceTypes;
+	SensorVector s_interfaces;
+	// set while a unicast re-observe of the cached endpoint is unanswered
+	bool s_reobserving;
+	int s_discoveryBackoff;
+	uint64_t s_nextDiscovery;
+};
+
+// One entry of the /gw/sensor change log, replayed to delta observers and
+// to clients catching up with GET ?since=<version>.
+struct sensor_change
+{
+	int c_version;
+	std::string c_name;
+	std::string c_address;
+	bool c_removed;
 };
 
 #endif /* GATEWAY_H_ */
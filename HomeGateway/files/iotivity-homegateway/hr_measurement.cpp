@@ -0,0 +1,128 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <math.h>
+#include "hr_measurement.h"
+
+bool parse_hr_measurement(const uint8_t *value, size_t length, hr_measurement_view &view)
+{
+	size_t at = 1;
+
+	if (length < 2)
+		return false;
+
+	view.flags = value[0];
+	if (view.flags & HR_FLAG_UINT16) {
+		if (length < 3)
+			return false;
+		view.heart_rate = value[1] | (value[2] << 8);
+		at = 3;
+	}
+	else {
+		view.heart_rate = value[1];
+		at = 2;
+	}
+
+	view.energy = 0;
+	if (view.flags & HR_FLAG_ENERGY) {
+		if (length < at + 2)
+			return false;
+		view.energy = value[at] | (value[at + 1] << 8);
+		at += 2;
+	}
+
+	view.rr_data = value + at;
+	view.rr_count = 0;
+	if (view.flags & HR_FLAG_RR) {
+		if ((length - at) % 2)
+			return false;
+		view.rr_count = (length - at) / 2;
+	}
+
+	return true;
+}
+
+void hr_sample_from_view(const hr_measurement_view &view, hr_sample &sample)
+{
+	sample.flags = view.flags;
+	sample.heart_rate = view.heart_rate;
+	sample.energy = view.energy;
+	sample.rr_count = view.rr_count < HR_MAX_RR ? view.rr_count : HR_MAX_RR;
+	for (size_t i = 0; i < sample.rr_count; i++)
+		sample.rr[i] = view.rr(i);
+}
+
+HrvWindow::HrvWindow(uint32_t window_ms) : m_window((uint64_t)window_ms * 1024 / 1000),
+	m_first(0), m_count(0), m_sum(0), m_squares(0), m_differences(0)
+{
+}
+
+static inline uint64_t squared_difference(uint16_t a, uint16_t b)
+{
+	int64_t difference = (int64_t)a - b;
+	return difference * difference;
+}
+
+// Drops the oldest interval.
+void HrvWindow::evict()
+{
+	uint16_t oldest = m_rr[m_first];
+
+	m_sum -= oldest;
+	m_squares -= (uint64_t)oldest * oldest;
+	m_first = (m_first + 1) % HRV_MAX_INTERVALS;
+	m_count--;
+	if (m_count > 0)
+		m_differences -= squared_difference(m_rr[m_first], oldest);
+}
+
+void HrvWindow::add(uint16_t rr)
+{
+	if (rr < HRV_MIN_RR || rr > HRV_MAX_RR)
+		return;
+
+	if (m_count == HRV_MAX_INTERVALS)
+		evict();
+	if (m_count > 0)
+		m_differences += squared_difference(rr, m_rr[(m_first + m_count - 1) % HRV_MAX_INTERVALS]);
+	m_rr[(m_first + m_count) % HRV_MAX_INTERVALS] = rr;
+	m_count++;
+	m_sum += rr;
+	m_squares += (uint64_t)rr * rr;
+
+	// keep the newest interval even when it alone is longer than the window
+	while (m_count > 1 && m_sum > m_window)
+		evict();
+}
+
+double HrvWindow::rmssd() const
+{
+	if (m_count < 2)
+		return 0;
+	return sqrt((double)m_differences / (m_count - 1)) * 1000 / 1024;
+}
+
+double HrvWindow::sdnn() const
+{
+	if (m_count < 2)
+		return 0;
+	double variance = ((double)m_squares - (double)m_sum * m_sum / m_count) / (m_count - 1);
+	return sqrt(variance > 0 ? variance : 0) * 1000 / 1024;
+}
@@ -0,0 +1,105 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef HR_MEASUREMENT_H_
+#define HR_MEASUREMENT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Flags of the Heart Rate Measurement characteristic (0x2A37)
+#define HR_FLAG_UINT16 0x01
+#define HR_FLAG_CONTACT_DETECTED 0x02
+#define HR_FLAG_CONTACT_SUPPORTED 0x04
+#define HR_FLAG_ENERGY 0x08
+#define HR_FLAG_RR 0x10
+
+// RR intervals that fit a 20 byte notification with an 8 bit heart rate
+// and no energy field; longer notifications have theirs truncated.
+#define HR_MAX_RR 9
+
+// One decoded Heart Rate Measurement. The RR intervals are not copied;
+// rr() reads them from the notification the view was parsed from.
+struct hr_measurement_view
+{
+	uint8_t flags;
+	uint16_t heart_rate;
+	uint16_t energy;	// kJ, valid with HR_FLAG_ENERGY
+	const uint8_t *rr_data;
+	size_t rr_count;
+
+	// RR interval 'i' in 1/1024 s
+	uint16_t rr(size_t i) const
+	{
+		return rr_data[2 * i] | (rr_data[2 * i + 1] << 8);
+	}
+};
+
+// Parses 'value' as sent by the peripheral. Returns false when it is
+// shorter than its flags say or ends in half an RR interval.
+bool parse_hr_measurement(const uint8_t *value, size_t length, hr_measurement_view &view);
+
+// What the GATT callback queues for the publisher: the view with its RR
+// intervals copied out, as the notification buffer does not outlive the
+// callback.
+struct hr_sample
+{
+	uint8_t flags;
+	uint8_t rr_count;
+	uint16_t heart_rate;
+	uint16_t energy;
+	uint16_t rr[HR_MAX_RR];
+};
+
+void hr_sample_from_view(const hr_measurement_view &view, hr_sample &sample);
+
+#define HRV_MAX_INTERVALS 512
+// intervals outside this range are artifacts and left out (1/1024 s)
+#define HRV_MIN_RR 256
+#define HRV_MAX_RR 2048
+
+// Heart rate variability over the RR intervals of the last window_ms.
+// Keeps running sums of the intervals, their squares and their squared
+// successive differences, so adding an interval and reading RMSSD or
+// SDNN are O(1) (amortised over the intervals that leave the window).
+class HrvWindow
+{
+	public:
+	HrvWindow(uint32_t window_ms);
+
+	// 'rr' in 1/1024 s
+	void add(uint16_t rr);
+
+	size_t size() const { return m_count; }
+	// both in ms, 0 until there are two intervals
+	double rmssd() const;
+	double sdnn() const;
+
+	private:
+	void evict();
+
+	uint64_t m_window;	// 1/1024 s
+	uint16_t m_rr[HRV_MAX_INTERVALS];
+	size_t m_first, m_count;
+	// m_sum is also the time the intervals span
+	uint64_t m_sum, m_squares, m_differences;
+};
+
+#endif /* HR_MEASUREMENT_H_ */
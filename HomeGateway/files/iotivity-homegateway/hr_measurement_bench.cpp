@@ -0,0 +1,108 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Throughput of the Heart Rate Measurement parser and the HRV window,
+// built with "scons TESTS=1" and run on the host. The notifications mix
+// the layouts straps send: 8 bit rates with and without RR intervals,
+// 16 bit rates and the energy field, all cycled from one buffer.
+//
+//	hr_measurement_bench [notifications]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "hr_measurement.h"
+
+#define BENCH_NOTIFICATIONS 10000000
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_s(bench_clock::time_point start)
+{
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static const std::vector<std::vector<uint8_t> > notifications = {
+	{ HR_FLAG_CONTACT_SUPPORTED | HR_FLAG_CONTACT_DETECTED, 72 },
+	{ HR_FLAG_RR, 75, 0x40, 0x03 },
+	{ HR_FLAG_RR | HR_FLAG_CONTACT_SUPPORTED, 68, 0x80, 0x03, 0x70, 0x03 },
+	{ HR_FLAG_UINT16 | HR_FLAG_RR, 0x2c, 0x01, 0xd0, 0x00, 0xc8, 0x00, 0xd4, 0x00 },
+	{ HR_FLAG_ENERGY | HR_FLAG_RR, 90, 0x10, 0x02, 0xa0, 0x02 },
+	{ HR_FLAG_RR, 60, 0x00, 0x04, 0x10, 0x04, 0x08, 0x04, 0x00, 0x04, 0xf0, 0x03,
+		0x00, 0x04, 0x08, 0x04, 0x10, 0x04, 0x00, 0x04 },
+};
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_NOTIFICATIONS;
+	size_t bytes = 0, intervals = 0;
+	uint64_t checksum = 0;
+	int failed = 0;
+
+	if (count <= 0)
+		count = BENCH_NOTIFICATIONS;
+
+	bench_clock::time_point start = bench_clock::now();
+	for (int n = 0; n < count; n++) {
+		const std::vector<uint8_t> &value = notifications[n % notifications.size()];
+		hr_measurement_view view;
+
+		if (!parse_hr_measurement(value.data(), value.size(), view)) {
+			failed++;
+			continue;
+		}
+		checksum += view.heart_rate + view.energy;
+		for (size_t i = 0; i < view.rr_count; i++)
+			checksum += view.rr(i);
+		bytes += value.size();
+		intervals += view.rr_count;
+	}
+	double parse = elapsed_s(start);
+
+	// every interval of the stream through a 5 minute window, read back
+	// after each notification as the publisher does
+	HrvWindow window(300000);
+	double hrv = 0;
+	start = bench_clock::now();
+	for (int n = 0; n < count; n++) {
+		const std::vector<uint8_t> &value = notifications[n % notifications.size()];
+		hr_measurement_view view;
+
+		parse_hr_measurement(value.data(), value.size(), view);
+		for (size_t i = 0; i < view.rr_count; i++)
+			window.add(view.rr(i));
+		hrv += window.rmssd() + window.sdnn();
+	}
+	double analyse = elapsed_s(start);
+
+	printf("parse  %10.0f notifications/s  %8.1f MB/s  %6.1f ns/notification\n",
+		count / parse, bytes / parse / 1e6, parse * 1e9 / count);
+	printf("+hrv   %10.0f notifications/s  %8.0f intervals/s\n",
+		count / analyse, intervals / analyse);
+	// keeps the loops from being optimised away
+	fprintf(stderr, "checksum %llu %.0f\n", (unsigned long long)checksum, hrv);
+
+	if (failed) {
+		fprintf(stderr, "%d notifications failed to parse\n", failed);
+		return 1;
+	}
+	return 0;
+}
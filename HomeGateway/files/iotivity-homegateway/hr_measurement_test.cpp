@@ -0,0 +1,194 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Fuzz and property checks of the Heart Rate Measurement parser and the
+// HRV window, built with "scons TESTS=1" and run on the host. Exits
+// non-zero on the first failure.
+//
+//	hr_measurement_test [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include "hr_measurement.h"
+
+#define TEST_ITERATIONS 200000
+#define TEST_SEED 2014
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+// The length a notification with 'flags' and 'rr_count' intervals has.
+static size_t encoded_length(uint8_t flags, size_t rr_count)
+{
+	return 1 + ((flags & HR_FLAG_UINT16) ? 2 : 1) + ((flags & HR_FLAG_ENERGY) ? 2 : 0)
+		+ ((flags & HR_FLAG_RR) ? 2 * rr_count : 0);
+}
+
+// Random bytes of every length a notification can have, each in a
+// buffer of exactly that size: the parser must accept exactly the
+// lengths the flags allow and keep the RR intervals inside the buffer.
+static int test_random_bytes(std::mt19937 &random, int iterations)
+{
+	for (int n = 0; n < iterations; n++) {
+		std::vector<uint8_t> value(random() % 24);
+		for (auto &byte : value)
+			byte = random();
+
+		hr_measurement_view view;
+		bool parsed = parse_hr_measurement(value.data(), value.size(), view);
+
+		bool valid = false;
+		if (value.size() >= 2) {
+			size_t fixed = encoded_length(value[0], 0);
+			valid = value.size() >= fixed
+				&& (!(value[0] & HR_FLAG_RR) || (value.size() - fixed) % 2 == 0);
+		}
+		CHECK(parsed == valid);
+		if (!parsed)
+			continue;
+
+		CHECK(view.flags == value[0]);
+		CHECK(view.rr_data >= value.data());
+		CHECK(view.rr_data + 2 * view.rr_count <= value.data() + value.size());
+		CHECK((view.flags & HR_FLAG_RR) || view.rr_count == 0);
+	}
+	return 0;
+}
+
+// Valid notifications for every flag combination, encoded and parsed
+// back, and queued as a sample.
+static int test_round_trip(std::mt19937 &random, int iterations)
+{
+	for (int n = 0; n < iterations; n++) {
+		uint8_t flags = random() & 0x1f;
+		uint16_t heart_rate = (flags & HR_FLAG_UINT16) ? random() : random() & 0xff;
+		uint16_t energy = random();
+		std::vector<uint16_t> rr((flags & HR_FLAG_RR) ? random() % (HR_MAX_RR + 3) : 0);
+		std::vector<uint8_t> value;
+
+		value.push_back(flags);
+		value.push_back(heart_rate & 0xff);
+		if (flags & HR_FLAG_UINT16)
+			value.push_back(heart_rate >> 8);
+		if (flags & HR_FLAG_ENERGY) {
+			value.push_back(energy & 0xff);
+			value.push_back(energy >> 8);
+		}
+		for (auto &interval : rr) {
+			interval = random();
+			value.push_back(interval & 0xff);
+			value.push_back(interval >> 8);
+		}
+		CHECK(value.size() == encoded_length(flags, rr.size()));
+
+		hr_measurement_view view;
+		CHECK(parse_hr_measurement(value.data(), value.size(), view));
+		CHECK(view.flags == flags);
+		CHECK(view.heart_rate == heart_rate);
+		CHECK(view.energy == ((flags & HR_FLAG_ENERGY) ? energy : 0));
+		CHECK(view.rr_count == rr.size());
+		for (size_t i = 0; i < rr.size(); i++)
+			CHECK(view.rr(i) == rr[i]);
+
+		// the sample keeps at most HR_MAX_RR of them
+		hr_sample sample;
+		hr_sample_from_view(view, sample);
+		CHECK(sample.heart_rate == heart_rate);
+		CHECK(sample.rr_count == (rr.size() < HR_MAX_RR ? rr.size() : HR_MAX_RR));
+		for (size_t i = 0; i < sample.rr_count; i++)
+			CHECK(sample.rr[i] == rr[i]);
+
+		// cut short, it must be refused
+		if (value.size() > 2 && (flags & (HR_FLAG_UINT16 | HR_FLAG_ENERGY | HR_FLAG_RR)))
+			CHECK(!parse_hr_measurement(value.data(), encoded_length(flags, 0) - 1, view));
+	}
+	return 0;
+}
+
+// The running sums of HrvWindow against RMSSD and SDNN computed from the
+// intervals it should be holding.
+static int test_hrv_window(std::mt19937 &random, int iterations)
+{
+	const uint32_t window_ms = 30000;
+	HrvWindow window(window_ms);
+	std::vector<uint16_t> kept;
+
+	for (int n = 0; n < iterations / 10; n++) {
+		// mostly plausible intervals, now and then an artifact
+		uint16_t rr = (random() % 50 == 0) ? random() % 4096 : 700 + random() % 400;
+		window.add(rr);
+
+		if (rr >= HRV_MIN_RR && rr <= HRV_MAX_RR) {
+			kept.push_back(rr);
+			uint64_t sum = 0;
+			for (auto interval : kept)
+				sum += interval;
+			while (kept.size() > 1 && (sum > (uint64_t)window_ms * 1024 / 1000
+					|| kept.size() > HRV_MAX_INTERVALS)) {
+				sum -= kept.front();
+				kept.erase(kept.begin());
+			}
+		}
+		CHECK(window.size() == kept.size());
+		if (kept.size() < 2) {
+			CHECK(window.rmssd() == 0 && window.sdnn() == 0);
+			continue;
+		}
+
+		double mean = 0, differences = 0, deviations = 0;
+		for (size_t i = 0; i < kept.size(); i++) {
+			mean += kept[i];
+			if (i > 0)
+				differences += ((double)kept[i] - kept[i - 1]) * ((double)kept[i] - kept[i - 1]);
+		}
+		mean /= kept.size();
+		for (auto interval : kept)
+			deviations += (interval - mean) * (interval - mean);
+
+		double rmssd = sqrt(differences / (kept.size() - 1)) * 1000 / 1024;
+		double sdnn = sqrt(deviations / (kept.size() - 1)) * 1000 / 1024;
+		CHECK(fabs(window.rmssd() - rmssd) < 1e-6 * (1 + rmssd));
+		CHECK(fabs(window.sdnn() - sdnn) < 1e-6 * (1 + sdnn));
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : TEST_ITERATIONS;
+	std::mt19937 random(TEST_SEED);
+
+	if (iterations <= 0)
+		iterations = TEST_ITERATIONS;
+
+	if (test_random_bytes(random, iterations) || test_round_trip(random, iterations)
+			|| test_hrv_window(random, iterations))
+		return 1;
+
+	printf("hr_measurement_test: %d iterations passed\n", iterations);
+	return 0;
+}
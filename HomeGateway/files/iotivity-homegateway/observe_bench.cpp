@@ -0,0 +1,196 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Notifications per second through SensorResource::onObserve, built with
+// "scons TESTS=1" and run on the host. A fleet of gas, fan, LED and PIR
+// sensors is bound to locally constructed resources and fed synthetic
+// representations, some of them with an attribute no handler reads.
+// For comparison the same stream goes through a copy of the attribute
+// chain onObserve had before the handler table, which printed every hit,
+// once printing with std::cout as it did and once through ALOG.
+// The results go to stderr and the log lines to stdout; send those to a
+// file or a pipe, as on the device, to see what the logging costs.
+//
+//	observe_bench [notifications]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include "sensor_resource.h"
+#include "async_log.h"
+
+#define BENCH_SENSORS_PER_KIND 250
+#define BENCH_NOTIFICATIONS 1000000
+#define BENCH_STORE "/tmp/observe_bench.reg"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *kind_uris[] = { "/sensor/gas", "/a/fan", "/intel/chainable_led_edison", "/sensor/pri" };
+
+// The payloads of each kind, and one with an attribute nobody reads.
+static std::vector<OCRepresentation> make_payloads()
+{
+	std::vector<OCRepresentation> payloads(5);
+
+	payloads[0].setValue("density", 42);
+	payloads[1].setValue("fanstate", std::string("on"));
+	payloads[2].setValue("ledColor", 3);
+	payloads[3].setValue("motion", false);
+	payloads[4].setValue("temperature", 21);
+	return payloads;
+}
+
+// onObserve before the handler table: every payload is checked for every
+// known attribute, and every hit is printed, with std::cout unless 'alog'.
+struct legacy_observer
+{
+	bool alog;
+	bool gas, fan, led, pri, fanState;
+
+	void onObserve(const OCRepresentation &rep)
+	{
+		int density = 0, ledColor = 0;
+		bool motion = false;
+
+		if (rep.hasAttribute("density")) {
+			gas = true;
+			rep.getValue("density", density);
+			if (alog)
+				ALOG_INFO("\tdensity: {}", density);
+			else
+				std::cout << "\tdensity: " << density << std::endl;
+		}
+		if (rep.hasAttribute("fanstate")) {
+			fan = true;
+			fanState = rep.getValue<std::string>("fanstate") == "on";
+			if (alog)
+				ALOG_INFO("\tfanstate: {}", fanState);
+			else
+				std::cout << "\tfanstate: " << fanState << std::endl;
+		}
+		if (rep.hasAttribute("ledColor")) {
+			led = true;
+			rep.getValue("ledColor", ledColor);
+			if (alog)
+				ALOG_INFO("\tledColor: {}", ledColor);
+			else
+				std::cout << "\tledColor: " << ledColor << std::endl;
+		}
+		if (rep.hasAttribute("motion")) {
+			pri = true;
+			rep.getValue("motion", motion);
+			if (alog)
+				ALOG_INFO("\tmotion: {}", motion);
+			else
+				std::cout << "\tmotion: " << motion << std::endl;
+		}
+	}
+};
+
+struct observe_bench
+{
+	SensorResource &m_sensor;
+	std::vector<int> m_ids;
+	std::vector<int> m_kinds;
+
+	observe_bench(SensorResource &sensor) : m_sensor(sensor)
+	{
+		std::vector<std::string> interfaces(1, DEFAULT_INTERFACE);
+
+		for (int i = 0; i < 4 * BENCH_SENSORS_PER_KIND; i++) {
+			char host[64];
+			snprintf(host, sizeof(host), "coap://10.0.%d.%d:5683", i >> 8, i & 0xff);
+			std::shared_ptr<OCResource> resource = OCPlatform::constructResourceObject(host,
+				kind_uris[i % 4], OC_ALL, true, std::vector<std::string>(1, kind_uris[i % 4]), interfaces);
+
+			std::lock_guard<std::mutex> lock(m_sensor.m_resourceLock);
+			int id = m_sensor.addSensor(std::string(host) + kind_uris[i % 4], kind_uris[i % 4], false);
+			m_sensor.m_sensors.bind(id, resource, sensor_kind_from_uri(kind_uris[i % 4]));
+			m_ids.push_back(id);
+			m_kinds.push_back(i % 4);
+		}
+	}
+
+	// Each sensor gets its kind's payload, every fifth one an unread one.
+	const OCRepresentation &payload(const std::vector<OCRepresentation> &payloads, int i, int n)
+	{
+		return payloads[n % 5 == 4 ? 4 : m_kinds[i]];
+	}
+
+	double table(const std::vector<OCRepresentation> &payloads, int count)
+	{
+		bench_clock::time_point start = bench_clock::now();
+		for (int n = 0; n < count; n++) {
+			int i = n % m_ids.size();
+			m_sensor.onObserve(m_ids[i], HeaderOptions(), payload(payloads, i, n), OC_STACK_OK, n);
+		}
+		return std::chrono::duration<double>(bench_clock::now() - start).count();
+	}
+
+	double legacy(const std::vector<OCRepresentation> &payloads, int count, bool alog)
+	{
+		legacy_observer observer = legacy_observer();
+		observer.alog = alog;
+		bench_clock::time_point start = bench_clock::now();
+		for (int n = 0; n < count; n++) {
+			int i = n % m_ids.size();
+			std::lock_guard<std::mutex> lock(m_sensor.m_resourceLock);
+			observer.onObserve(payload(payloads, i, n));
+		}
+		return std::chrono::duration<double>(bench_clock::now() - start).count();
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_NOTIFICATIONS;
+	PlatformConfig cfg(ServiceType::InProc, ModeType::Both, "127.0.0.1", 0, GATEWAY_QOS);
+
+	if (count <= 0)
+		count = BENCH_NOTIFICATIONS;
+
+	OCPlatform::Configure(cfg);
+	unlink(BENCH_STORE);
+
+	RegistryStore store(BENCH_STORE);
+	AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+	SensorHistory history(16 * 1024 * 1024);
+	ConfigResource config(&admission);
+	RulesResource rules(&store);
+	SensorResource sensor(&rules, &config, &store, &history, &admission);
+	observe_bench bench(sensor);
+	std::vector<OCRepresentation> payloads = make_payloads();
+
+	double legacy = bench.legacy(payloads, count, false);
+	double table = bench.table(payloads, count);
+	// last, so the log thread draining the ring does not slow the others
+	double logged = bench.legacy(payloads, count, true);
+
+	fprintf(stderr, "%d sensors, %d notifications\n", (int)bench.m_ids.size(), count);
+	fprintf(stderr, "attribute chain  %10.0f notifications/s\n", count / legacy);
+	fprintf(stderr, "  logged by ALOG %10.0f notifications/s, %lu log records dropped\n",
+		count / logged, alog_dropped());
+	fprintf(stderr, "handler table    %10.0f notifications/s\n", count / table);
+
+	admission.stop();
+	unlink(BENCH_STORE);
+	return 0;
+}
@@ -0,0 +1,112 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "observe_pipeline.h"
+#include "gateway_stats.h"
+
+#define WORKER_IDLE_WAIT 10
+
+ObservePipeline::ObservePipeline(unsigned int workers, size_t capacity, EventHandler handler)
+	: m_handler(handler), m_running(true)
+{
+	if (workers == 0)
+		workers = 1;
+
+	for (unsigned int i = 0; i < workers; i++)
+		m_shards.push_back(std::unique_ptr<shard>(new shard(capacity)));
+
+	for (auto &worker : m_shards)
+		worker->thread = std::thread(&ObservePipeline::run, this, worker.get());
+}
+
+ObservePipeline::~ObservePipeline()
+{
+	m_running = false;
+
+	for (auto &worker : m_shards) {
+		{
+			std::lock_guard<std::mutex> lock(worker->lock);
+			worker->wakeup.notify_one();
+		}
+		worker->thread.join();
+	}
+}
+
+const std::string *ObservePipeline::intern(const std::string &name, uint32_t &id)
+{
+	std::lock_guard<std::mutex> lock(m_internLock);
+
+	auto iter = m_ids.find(name);
+	if (iter == m_ids.end()) {
+		iter = m_ids.insert(std::make_pair(name, (uint32_t)m_names.size())).first;
+		m_names.push_back(name);
+	}
+
+	id = iter->second;
+	return &m_names[id];
+}
+
+bool ObservePipeline::push(const observe_event &event)
+{
+	shard &worker = *m_shards[event.source_id % m_shards.size()];
+
+	if (!worker.queue.push(event)) {
+		gw_stats.events_dropped++;
+		return false;
+	}
+
+	if (worker.sleeping.load()) {
+		std::lock_guard<std::mutex> lock(worker.lock);
+		worker.wakeup.notify_one();
+	}
+
+	return true;
+}
+
+size_t ObservePipeline::depth() const
+{
+	size_t depth = 0;
+
+	for (auto &worker : m_shards)
+		depth += worker->queue.size();
+
+	return depth;
+}
+
+void ObservePipeline::run(shard *worker)
+{
+	observe_event event;
+
+	while (m_running) {
+		if (worker->queue.pop(event)) {
+			m_handler(event);
+			gw_stats.events_processed++;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(worker->lock);
+		worker->sleeping = true;
+		// re-check after announcing the sleep so a push racing with us
+		// is not left waiting for the timeout
+		if (worker->queue.size() == 0 && m_running)
+			worker->wakeup.wait_for(lock, std::chrono::milliseconds(WORKER_IDLE_WAIT));
+		worker->sleeping = false;
+	}
+}
@@ -0,0 +1,224 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef OBSERVE_PIPELINE_H_
+#define OBSERVE_PIPELINE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+// An observation decoded on the notification thread. The strings are
+// interned and stay valid for the lifetime of the pipeline.
+struct observe_event
+{
+	uint32_t source_id;
+	const std::string *source;
+	const std::string *kind;
+	const std::string *attribute;
+	int32_t value;
+};
+
+// Bounded lock-free queue after Dmitry Vyukov's array queue. Any number
+// of producers may push; the pipeline uses a single consumer per queue.
+template <typename T>
+class BoundedQueue
+{
+	public:
+	BoundedQueue(size_t capacity) : m_mask(capacity - 1), m_cells(capacity), m_head(0), m_tail(0)
+	{
+		for (size_t i = 0; i < capacity; i++)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool push(const T &value)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			cell &c = m_cells[pos & m_mask];
+			size_t seq = c.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					c.value = value;
+					c.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(T &value)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		for (;;) {
+			cell &c = m_cells[pos & m_mask];
+			size_t seq = c.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = std::move(c.value);
+					c.sequence.store(pos + m_mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	size_t size() const
+	{
+		return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed);
+	}
+
+	private:
+	struct cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	size_t m_mask;
+	std::vector<cell> m_cells;
+	char m_pad0[64];
+	std::atomic<size_t> m_head;
+	char m_pad1[64];
+	std::atomic<size_t> m_tail;
+};
+
+// Bounded queue for exactly one producer and one consumer thread. Each
+// side only stores its own index and caches the other one, so neither
+// needs a read-modify-write.
+template <typename T>
+class SpscQueue
+{
+	public:
+	SpscQueue(size_t capacity) : m_mask(capacity - 1), m_cells(capacity),
+		m_head(0), m_tailCache(0), m_tail(0), m_headCache(0)
+	{
+	}
+
+	bool push(const T &value)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_headCache > m_mask) {
+			m_headCache = m_head.load(std::memory_order_acquire);
+			if (tail - m_headCache > m_mask)
+				return false;
+		}
+		m_cells[tail & m_mask] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &value)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tailCache) {
+			m_tailCache = m_tail.load(std::memory_order_acquire);
+			if (head == m_tailCache)
+				return false;
+		}
+		value = std::move(m_cells[head & m_mask]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t size() const
+	{
+		return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed);
+	}
+
+	private:
+	size_t m_mask;
+	std::vector<T> m_cells;
+	char m_pad0[64];
+	// consumer side
+	std::atomic<size_t> m_head;
+	size_t m_tailCache;
+	char m_pad1[64];
+	// producer side
+	std::atomic<size_t> m_tail;
+	size_t m_headCache;
+};
+
+// ObservePipeline moves rule evaluation off the notification threads.
+// Producers push decoded events without blocking; each event goes to
+// one of N worker threads chosen by its source id, so events from the
+// same device are handled in order.
+class ObservePipeline
+{
+	public:
+	typedef std::function<void(const observe_event &event)> EventHandler;
+
+	// 'capacity' is per worker and must be a power of two.
+	ObservePipeline(unsigned int workers, size_t capacity, EventHandler handler);
+	~ObservePipeline();
+
+	// Returns a stable pointer and id for 'name'.
+	const std::string *intern(const std::string &name, uint32_t &id);
+
+	// Queues 'event'; returns false and drops it when its queue is full.
+	bool push(const observe_event &event);
+
+	size_t depth() const;
+
+	private:
+	struct shard
+	{
+		shard(size_t capacity) : queue(capacity), sleeping(false) {}
+		BoundedQueue<observe_event> queue;
+		std::atomic<bool> sleeping;
+		std::mutex lock;
+		std::condition_variable wakeup;
+		std::thread thread;
+	};
+
+	void run(shard *worker);
+
+	EventHandler m_handler;
+	std::atomic<bool> m_running;
+	std::vector<std::unique_ptr<shard> > m_shards;
+	std::mutex m_internLock;
+	std::deque<std::string> m_names;
+	std::unordered_map<std::string, uint32_t> m_ids;
+};
+
+#endif /* OBSERVE_PIPELINE_H_ */
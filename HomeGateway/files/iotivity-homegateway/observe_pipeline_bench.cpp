@@ -0,0 +1,176 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Load test of the observe pipeline, built with "scons TESTS=1" and run
+// on the host: producer threads standing in for the notification
+// threads push events for a fleet of devices, and 1, 2, 4 and 8 workers
+// run a windowed rule over them. Prints the events per second for each
+// worker count, and fails if a device's events reach its worker out of
+// order or any event is lost. Scaling needs as many free cores as
+// workers.
+//
+//	observe_pipeline_bench [events] [producers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "observe_pipeline.h"
+#include "rule_engine.h"
+#include "gateway_stats.h"
+
+#define BENCH_EVENTS 2000000
+#define BENCH_PRODUCERS 2
+#define BENCH_SOURCES 1024
+#define BENCH_CAPACITY 1024
+
+gateway_stats gw_stats;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *bench_rules =
+	"gas.density > 70 ~ 5 -> fan.fanstate = on : off\n"
+	"p90(gas.density, 5s) > 80 -> led.ledColor = 1 : 0\n";
+
+// What a worker keeps for one device. Each device only ever reaches the
+// worker it is sharded to, so only that worker touches its entry.
+struct alignas(64) source_state
+{
+	int32_t last;
+	int out_of_order;
+	stream_windows windows;
+};
+
+static int64_t now_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		bench_clock::now().time_since_epoch()).count();
+}
+
+static int run(unsigned int workers, int events, int producers, RuleEngine &engine, double &rate)
+{
+	std::vector<source_state> states;
+	std::vector<uint32_t> ids(BENCH_SOURCES);
+	std::vector<const std::string *> names(BENCH_SOURCES);
+	std::atomic<int> fired(0);
+	const std::string *kind, *attribute;
+	uint32_t id;
+
+	{
+		ObservePipeline pipeline(workers, BENCH_CAPACITY,
+			[&states, &engine, &fired, &kind](const observe_event &event) {
+				source_state &state = states[event.source_id];
+				if (event.value != state.last + 1)
+					state.out_of_order++;
+				state.last = event.value;
+
+				int density = event.value % 100;
+				engine.aggregate(state.windows, *event.attribute, density, now_ms());
+				engine.evaluate(*kind, *event.attribute, density, state.windows,
+					[&fired](const rule_action &) { fired++; });
+			});
+
+		kind = pipeline.intern("gas", id);
+		attribute = pipeline.intern("density", id);
+		for (int i = 0; i < BENCH_SOURCES; i++)
+			names[i] = pipeline.intern("gas" + std::to_string(i), ids[i]);
+		// the interned ids index the states
+		states.resize(ids[BENCH_SOURCES - 1] + 1);
+		for (auto &state : states) {
+			state.last = -1;
+			state.out_of_order = 0;
+		}
+
+		gw_stats.events_processed = 0;
+		gw_stats.events_dropped = 0;
+
+		bench_clock::time_point start = bench_clock::now();
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; p++)
+			threads.push_back(std::thread([&, p]() {
+				// each producer owns every producers'th device, as
+				// each device's notifications arrive on one thread
+				std::vector<int32_t> sequence(BENCH_SOURCES, 0);
+				int owned = (BENCH_SOURCES - p + producers - 1) / producers;
+				for (int n = p, k = 0; n < events; n += producers, k++) {
+					int source = p + (k * 7 % owned) * producers;
+					observe_event event;
+					event.source_id = ids[source];
+					event.source = names[source];
+					event.kind = kind;
+					event.attribute = attribute;
+					event.value = sequence[source];
+					// a full queue is retried so nothing is lost here
+					while (!pipeline.push(event))
+						std::this_thread::yield();
+					sequence[source]++;
+				}
+			}));
+		for (auto &thread : threads)
+			thread.join();
+		while (gw_stats.events_processed < events)
+			std::this_thread::yield();
+		rate = events / std::chrono::duration<double>(bench_clock::now() - start).count();
+	}
+
+	int out_of_order = 0;
+	for (auto &state : states)
+		out_of_order += state.out_of_order;
+	printf("workers %u  %10.0f events/s  %d rejected by a full queue  %d rules fired\n",
+		workers, rate, gw_stats.events_dropped.load(), fired.load());
+	if (out_of_order) {
+		fprintf(stderr, "%d events out of order with %u workers\n", out_of_order, workers);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int events = argc > 1 ? atoi(argv[1]) : BENCH_EVENTS;
+	int producers = argc > 2 ? atoi(argv[2]) : BENCH_PRODUCERS;
+	RuleEngine engine;
+	std::string error;
+	double single = 0, rate;
+
+	if (events <= 0)
+		events = BENCH_EVENTS;
+	if (producers <= 0)
+		producers = BENCH_PRODUCERS;
+
+	if (!engine.compile(bench_rules, error)) {
+		fprintf(stderr, "rules: %s\n", error.c_str());
+		return 1;
+	}
+
+	printf("%d events from %d devices, %d producers, %u cores\n",
+		events, BENCH_SOURCES, producers, std::thread::hardware_concurrency());
+	for (unsigned int workers = 1; workers <= 8; workers *= 2) {
+		if (run(workers, events, producers, engine, rate))
+			return 1;
+		if (workers == 1)
+			single = rate;
+		else
+			printf("           %.2fx the single worker\n", rate / single);
+	}
+
+	return 0;
+}
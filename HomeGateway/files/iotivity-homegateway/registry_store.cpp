@@ -0,0 +1,287 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <map>
+#include "registry_store.h"
+
+#define STORE_MAGIC 0x53524748	// "HGRS"
+#define STORE_INITIAL_SIZE 65536
+
+struct store_header
+{
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t used;
+};
+
+// A record is laid out as a 32 bit length of what follows, the type, the
+// number of fields and then each field as a 16 bit length and its bytes.
+static void encode_record(const store_record &record, std::string &buf)
+{
+	size_t start = buf.size();
+	uint32_t length;
+
+	buf.append(sizeof(length), '\0');
+	buf.push_back(record.type);
+	buf.push_back(record.fields.size());
+	for (auto &field : record.fields) {
+		uint16_t size = field.size() > UINT16_MAX ? UINT16_MAX : field.size();
+
+		buf.append((const char *)&size, sizeof(size));
+		buf.append(field, 0, size);
+	}
+
+	length = buf.size() - start - sizeof(length);
+	memcpy(&buf[start], &length, sizeof(length));
+}
+
+// Returns the size of the record at p, or 0 when it is truncated or
+// malformed.
+static size_t decode_record(const uint8_t *p, const uint8_t *end, store_record &record)
+{
+	const uint8_t *start = p;
+	uint32_t length;
+	uint16_t size;
+	int count;
+
+	if (end - p < (ptrdiff_t)sizeof(length) + 2)
+		return 0;
+	memcpy(&length, p, sizeof(length));
+	p += sizeof(length);
+	if (length < 2 || end - p < (ptrdiff_t)length)
+		return 0;
+	end = p + length;
+
+	record.type = *p++;
+	count = *p++;
+	record.fields.clear();
+	while (count-- > 0) {
+		if (end - p < (ptrdiff_t)sizeof(size))
+			return 0;
+		memcpy(&size, p, sizeof(size));
+		p += sizeof(size);
+		if (end - p < size)
+			return 0;
+		record.fields.push_back(std::string((const char *)p, size));
+		p += size;
+	}
+
+	return end - start;
+}
+
+RegistryStore::RegistryStore(const std::string &path) : m_path(path), m_fd(-1), m_base(nullptr), m_capacity(0)
+{
+	if (open()) {
+		compact();
+	}
+	else {
+		std::cout << "Registry store " << m_path << " unavailable, not persisting sensors" << std::endl;
+	}
+}
+
+RegistryStore::~RegistryStore()
+{
+	unmap();
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+bool RegistryStore::open()
+{
+	struct stat st;
+	store_header *header;
+
+	m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (m_fd < 0)
+		return false;
+
+	if (fstat(m_fd, &st) < 0 || !map(st.st_size < STORE_INITIAL_SIZE ? STORE_INITIAL_SIZE : st.st_size)) {
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	header = (store_header *)m_base;
+	if (header->magic != STORE_MAGIC || header->used < sizeof(store_header) || header->used > m_capacity) {
+		if (header->magic != 0)
+			std::cout << "Registry store " << m_path << " is corrupt, starting empty" << std::endl;
+		header->magic = STORE_MAGIC;
+		header->used = sizeof(store_header);
+	}
+
+	// A record torn by a crash ends the log, and what is appended next
+	// goes in its place rather than after it, out of reach of load().
+	const uint8_t *p = m_base + sizeof(store_header);
+	const uint8_t *end = m_base + header->used;
+	store_record record;
+	while (p < end) {
+		size_t size = decode_record(p, end, record);
+
+		if (size == 0) {
+			std::cout << "Registry store " << m_path << " truncated at " << (p - m_base) << std::endl;
+			header->used = p - m_base;
+			break;
+		}
+		p += size;
+	}
+
+	return true;
+}
+
+bool RegistryStore::map(size_t capacity)
+{
+	void *base;
+
+	unmap();
+	if (ftruncate(m_fd, capacity) < 0)
+		return false;
+
+	base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (base == MAP_FAILED)
+		return false;
+
+	m_base = (uint8_t *)base;
+	m_capacity = capacity;
+	return true;
+}
+
+void RegistryStore::unmap()
+{
+	if (m_base != nullptr) {
+		munmap(m_base, m_capacity);
+		m_base = nullptr;
+		m_capacity = 0;
+	}
+}
+
+size_t RegistryStore::used() const
+{
+	return ((store_header *)m_base)->used;
+}
+
+void RegistryStore::append(const store_record &record)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::string buf;
+	size_t offset;
+
+	if (m_base == nullptr)
+		return;
+
+	encode_record(record, buf);
+	offset = used();
+	if (offset + buf.size() > m_capacity) {
+		size_t capacity = m_capacity * 2;
+
+		while (capacity < offset + buf.size())
+			capacity *= 2;
+		if (!map(capacity)) {
+			std::cout << "Registry store " << m_path << " cannot grow, dropping record" << std::endl;
+			map(offset);
+			return;
+		}
+	}
+
+	// The record only becomes visible once 'used' covers it.
+	memcpy(m_base + offset, buf.data(), buf.size());
+	((store_header *)m_base)->used = offset + buf.size();
+}
+
+void RegistryStore::load(const std::function<void(const store_record &record)> &fn)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	store_record record;
+
+	if (m_base == nullptr)
+		return;
+
+	const uint8_t *p = m_base + sizeof(store_header);
+	const uint8_t *end = m_base + used();
+	while (p < end) {
+		size_t size = decode_record(p, end, record);
+
+		if (size == 0) {
+			std::cout << "Registry store " << m_path << " truncated at "
+				<< (p - m_base) << std::endl;
+			break;
+		}
+		fn(record);
+		p += size;
+	}
+}
+
+// Rewrites the log with only the latest record of each type and key, and
+// without the sensors removed since. The new log is written aside and
+// renamed over the old one, so a crash leaves either of them intact.
+void RegistryStore::compact()
+{
+	std::vector<store_record> records;
+	std::map<std::pair<int, std::string>, size_t> latest;
+	std::map<size_t, const store_record *> live;
+	std::string buf, tmpPath = m_path + ".tmp";
+	store_header header = { STORE_MAGIC, 0, 0 };
+	int fd;
+
+	load([&records](const store_record &record) { records.push_back(record); });
+
+	for (size_t i = 0; i < records.size(); i++) {
+		const std::string &key = records[i].fields.empty() ? "" : records[i].fields[0];
+
+		if (records[i].type == STORE_SENSOR_REMOVED) {
+			latest.erase(std::make_pair(STORE_SENSOR, key));
+			latest.erase(std::make_pair(STORE_ENDPOINT, key));
+		}
+		else {
+			latest[std::make_pair(records[i].type, key)] = i;
+		}
+	}
+	if (latest.size() == records.size())
+		return;
+
+	for (auto &entry : latest)
+		live[entry.second] = &records[entry.second];
+	for (auto &entry : live)
+		encode_record(*entry.second, buf);
+	header.used = sizeof(header) + buf.size();
+
+	fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+		write(fd, buf.data(), buf.size()) != (ssize_t)buf.size() ||
+		fsync(fd) < 0 || rename(tmpPath.c_str(), m_path.c_str()) < 0) {
+		close(fd);
+		unlink(tmpPath.c_str());
+		return;
+	}
+	close(fd);
+
+	std::cout << "Registry store compacted from " << records.size()
+		<< " to " << live.size() << " records" << std::endl;
+	unmap();
+	close(m_fd);
+	open();
+}
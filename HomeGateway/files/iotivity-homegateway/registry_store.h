@@ -0,0 +1,75 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef REGISTRY_STORE_H_
+#define REGISTRY_STORE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum store_record_type
+{
+	STORE_SENSOR = 1,	// name, address
+	STORE_SENSOR_REMOVED,	// name
+	STORE_ENDPOINT,		// name, host, uri, resource types, interfaces
+	STORE_RULES		// "rules", crazyJumping, kitchenMonitor, density, heartRate, dwell, rules
+};
+
+struct store_record
+{
+	uint8_t type;
+	std::vector<std::string> fields;
+};
+
+// RegistryStore persists the gateway registry as an append-only log of
+// records in a memory-mapped file. A record supersedes the earlier ones of
+// the same type and first field; the log is compacted down to the live
+// records every time it is opened. When the file cannot be opened the
+// store stays empty and appends are dropped.
+class RegistryStore
+{
+	public:
+	RegistryStore(const std::string &path);
+	~RegistryStore();
+
+	bool isOpen() const { return m_base != nullptr; }
+	void append(const store_record &record);
+	// Calls fn for every record, oldest first.
+	void load(const std::function<void(const store_record &record)> &fn);
+
+	private:
+	bool open();
+	bool map(size_t capacity);
+	void unmap();
+	void compact();
+	size_t used() const;
+
+	std::string m_path;
+	int m_fd;
+	uint8_t *m_base;
+	size_t m_capacity;
+	std::mutex m_lock;
+};
+
+#endif /* REGISTRY_STORE_H_ */
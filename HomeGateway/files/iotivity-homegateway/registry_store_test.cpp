@@ -0,0 +1,192 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Checks of the registry store, built with "scons TESTS=1" and run on
+// the host: records come back as written after a reopen, across growth
+// of the file, the log is compacted to the live records, and a torn
+// tail or an unusable path loses no more than it must. Exits non-zero
+// on the first failure.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+#include "registry_store.h"
+
+#define TEST_STORE "/tmp/registry_store_test.reg"
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+static std::vector<store_record> load_all()
+{
+	RegistryStore store(TEST_STORE);
+	std::vector<store_record> records;
+
+	store.load([&records](const store_record &record) { records.push_back(record); });
+	return records;
+}
+
+static bool same(const store_record &a, const store_record &b)
+{
+	return a.type == b.type && a.fields == b.fields;
+}
+
+// Enough distinct records to outgrow the initial mapping several times,
+// with empty, binary and oversized fields among them.
+static int test_round_trip()
+{
+	std::vector<store_record> written, loaded;
+
+	unlink(TEST_STORE);
+	{
+		RegistryStore store(TEST_STORE);
+		CHECK(store.isOpen());
+
+		written.push_back(store_record{STORE_RULES, {"rules", "", std::string("a\0b", 3)}});
+		written.push_back(store_record{STORE_SENSOR, {"long", std::string(70000, 'x')}});
+		for (int i = 0; i < 5000; i++) {
+			char name[32];
+			snprintf(name, sizeof(name), "sensor%d", i);
+			written.push_back(store_record{STORE_SENSOR, {name, "/sensor/gas"}});
+			written.push_back(store_record{STORE_ENDPOINT, {name, "coap://10.0.0.1:5683", "/sensor/gas",
+				"/sensor/gas", "oic.if.baseline"}});
+		}
+		for (auto &record : written)
+			store.append(record);
+	}
+
+	// fields are cut at 64 KB
+	written[1].fields[1].resize(UINT16_MAX);
+
+	loaded = load_all();
+	CHECK(loaded.size() == written.size());
+	for (size_t i = 0; i < written.size(); i++)
+		CHECK(same(loaded[i], written[i]));
+	return 0;
+}
+
+// The latest record of each type and key survives, in the order the
+// latest ones were written; a removal takes the sensor and its endpoint
+// with it until the sensor is registered again.
+static int test_compaction()
+{
+	std::vector<store_record> loaded;
+	struct stat before, after;
+
+	unlink(TEST_STORE);
+	{
+		RegistryStore store(TEST_STORE);
+
+		store.append(store_record{STORE_SENSOR, {"gas", "/sensor/gas"}});
+		store.append(store_record{STORE_ENDPOINT, {"gas", "coap://10.0.0.1:5683", "/sensor/gas", "", ""}});
+		store.append(store_record{STORE_SENSOR, {"fan", "/a/fan"}});
+		store.append(store_record{STORE_ENDPOINT, {"fan", "coap://10.0.0.2:5683", "/a/fan", "", ""}});
+		store.append(store_record{STORE_RULES, {"rules", "1"}});
+		store.append(store_record{STORE_ENDPOINT, {"gas", "coap://10.0.0.3:5683", "/sensor/gas", "", ""}});
+		store.append(store_record{STORE_SENSOR_REMOVED, {"fan"}});
+		store.append(store_record{STORE_RULES, {"rules", "2"}});
+		store.append(store_record{STORE_SENSOR_REMOVED, {"pir"}});
+		store.append(store_record{STORE_SENSOR, {"pir", "/sensor/pri"}});
+		for (int i = 0; i < 1000; i++)
+			store.append(store_record{STORE_RULES, {"rules", std::to_string(i)}});
+	}
+	CHECK(stat(TEST_STORE, &before) == 0);
+
+	loaded = load_all();
+	CHECK(loaded.size() == 4);
+	CHECK(same(loaded[0], store_record{STORE_SENSOR, {"gas", "/sensor/gas"}}));
+	CHECK(same(loaded[1], store_record{STORE_ENDPOINT, {"gas", "coap://10.0.0.3:5683", "/sensor/gas", "", ""}}));
+	CHECK(same(loaded[2], store_record{STORE_SENSOR, {"pir", "/sensor/pri"}}));
+	CHECK(same(loaded[3], store_record{STORE_RULES, {"rules", "999"}}));
+
+	// compacted on that open: the next one finds nothing to drop
+	CHECK(stat(TEST_STORE, &after) == 0);
+	CHECK(after.st_ino != before.st_ino);
+	loaded = load_all();
+	CHECK(loaded.size() == 4);
+	CHECK(stat(TEST_STORE, &before) == 0);
+	CHECK(before.st_ino == after.st_ino);
+	return 0;
+}
+
+// A record cut short by a crash is dropped, the records before it are
+// kept, and the next record appended takes its place.
+static int test_torn_tail()
+{
+	std::vector<store_record> loaded;
+	uint64_t used;
+	int fd;
+
+	unlink(TEST_STORE);
+	{
+		RegistryStore store(TEST_STORE);
+		store.append(store_record{STORE_SENSOR, {"gas", "/sensor/gas"}});
+		store.append(store_record{STORE_SENSOR, {"fan", "/a/fan"}});
+	}
+
+	// the header's 'used' follows its magic and a reserved word
+	fd = open(TEST_STORE, O_RDWR);
+	CHECK(fd >= 0);
+	CHECK(pread(fd, &used, sizeof(used), 8) == sizeof(used));
+	used -= 3;
+	CHECK(pwrite(fd, &used, sizeof(used), 8) == sizeof(used));
+	close(fd);
+
+	{
+		RegistryStore store(TEST_STORE);
+		store.append(store_record{STORE_SENSOR, {"pir", "/sensor/pri"}});
+	}
+	loaded = load_all();
+	CHECK(loaded.size() == 2);
+	CHECK(same(loaded[0], store_record{STORE_SENSOR, {"gas", "/sensor/gas"}}));
+	CHECK(same(loaded[1], store_record{STORE_SENSOR, {"pir", "/sensor/pri"}}));
+	return 0;
+}
+
+static int test_unavailable()
+{
+	RegistryStore store("/nonexistent/registry_store_test.reg");
+	int count = 0;
+
+	CHECK(!store.isOpen());
+	store.append(store_record{STORE_SENSOR, {"gas", "/sensor/gas"}});
+	store.load([&count](const store_record &) { count++; });
+	CHECK(count == 0);
+	return 0;
+}
+
+int main()
+{
+	int result = test_round_trip() || test_compaction() || test_torn_tail() || test_unavailable();
+
+	unlink(TEST_STORE);
+	if (result)
+		return 1;
+
+	printf("registry_store_test passed\n");
+	return 0;
+}
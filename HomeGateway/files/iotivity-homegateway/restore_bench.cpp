@@ -0,0 +1,128 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Gateway restart with a fleet in the registry store, built with "scons
+// TESTS=1" and run on the host. A first run registers the sensors and
+// binds each to an endpoint, moving every one a few times so the log
+// has records to compact. The timed second run opens the store, which
+// compacts it, and restores: every sensor is observed again by unicast.
+//
+// The clock stops once every sensor is bound, that is once its observe
+// request is out. The time to each sensor's first notification is not
+// measured: the resources here are constructed locally and never
+// answer, and on a network it is the devices' round trip on top.
+//
+//	restore_bench [sensors]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include "sensor_resource.h"
+
+#define BENCH_SENSORS 1000
+#define BENCH_MOVES 3
+#define BENCH_STORE "/tmp/restore_bench.reg"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *kind_uris[] = { "/sensor/gas", "/a/fan", "/intel/chainable_led_edison", "/sensor/pri" };
+
+struct restore_bench
+{
+	// The previous run: each sensor is registered and then bound at
+	// BENCH_MOVES + 1 successive endpoints, all of which are persisted.
+	static void populate(int count)
+	{
+		RegistryStore store(BENCH_STORE);
+		AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+		SensorHistory history(1024 * 1024);
+		ConfigResource config(&admission);
+		RulesResource rules(&store);
+		SensorResource sensor(&rules, &config, &store, &history, &admission);
+		std::vector<std::string> interfaces(1, DEFAULT_INTERFACE);
+		std::lock_guard<std::mutex> lock(sensor.m_resourceLock);
+
+		for (int i = 0; i < count; i++) {
+			const char *uri = kind_uris[i % 4];
+			char name[32];
+			snprintf(name, sizeof(name), "sensor%d", i);
+			sensor.mapSensor(name, uri);
+			int id = sensor.addSensor(name, uri);
+
+			for (int move = 0; move <= BENCH_MOVES; move++) {
+				char host[64];
+				snprintf(host, sizeof(host), "coap://10.%d.%d.%d:5683", move, i >> 8, i & 0xff);
+				std::shared_ptr<OCResource> resource = OCPlatform::constructResourceObject(host,
+					uri, OC_ALL, true, std::vector<std::string>(1, uri), interfaces);
+				sensor.observeResource(id, resource, sensor_kind_from_uri(uri));
+			}
+		}
+		admission.stop();
+	}
+
+	static int bound(SensorResource &sensor)
+	{
+		std::lock_guard<std::mutex> lock(sensor.m_resourceLock);
+		int count = 0;
+
+		for (auto &data : sensor.m_sensors)
+			count += data.s_resource != nullptr;
+		return count;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_SENSORS;
+	PlatformConfig cfg(ServiceType::InProc, ModeType::Both, "127.0.0.1", 0, GATEWAY_QOS);
+
+	if (count <= 0 || count > 65536)
+		count = BENCH_SENSORS;
+
+	OCPlatform::Configure(cfg);
+	unlink(BENCH_STORE);
+	restore_bench::populate(count);
+
+	bench_clock::time_point start = bench_clock::now();
+	RegistryStore store(BENCH_STORE);
+	bench_clock::time_point opened = bench_clock::now();
+	AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+	SensorHistory history(1024 * 1024);
+	ConfigResource config(&admission);
+	RulesResource rules(&store);
+	SensorResource sensor(&rules, &config, &store, &history, &admission);
+	sensor.restore();
+	bench_clock::time_point restored = bench_clock::now();
+	int bound = restore_bench::bound(sensor);
+
+	double open = std::chrono::duration<double, std::milli>(opened - start).count();
+	double total = std::chrono::duration<double, std::milli>(restored - start).count();
+	fprintf(stderr, "%d sensors, each moved %d times before the restart\n", count, BENCH_MOVES);
+	fprintf(stderr, "store opened and compacted %8.2f ms\n", open);
+	fprintf(stderr, "sensors bound by unicast   %8.2f ms, %d of %d, %.1f us a sensor\n", total,
+		bound, count, total * 1000 / count);
+	fprintf(stderr, "first notifications        not measured, nothing answers here\n");
+
+	admission.stop();
+	unlink(BENCH_STORE);
+	// every sensor of the store must have been observed again
+	return bound == count ? 0 : 1;
+}
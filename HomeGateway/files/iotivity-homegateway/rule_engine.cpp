@@ -0,0 +1,400 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdlib.h>
+#include <algorithm>
+#include "rule_engine.h"
+
+#define RULE_STATE_UNKNOWN 2
+
+struct parsed_rule
+{
+	std::string source;
+	std::string attribute;
+	bool aggregated;
+	aggregate_spec aggregate;
+	rule_predicate predicate;
+	rule_action action;
+	rule_action release;
+	bool has_release;
+};
+
+static std::string trim(const std::string &str)
+{
+	size_t begin = str.find_first_not_of(" \t\r");
+	if (begin == std::string::npos)
+		return "";
+	size_t end = str.find_last_not_of(" \t\r");
+	return str.substr(begin, end - begin + 1);
+}
+
+static bool parse_path(const std::string &path, std::string &name, std::string &attribute)
+{
+	size_t dot = path.find('.');
+	if (dot == std::string::npos || dot == 0 || dot == path.size() - 1)
+		return false;
+
+	name = path.substr(0, dot);
+	attribute = path.substr(dot + 1);
+	return true;
+}
+
+static bool parse_int(const std::string &str, int &value)
+{
+	char *end = NULL;
+	if (str.empty())
+		return false;
+
+	value = strtol(str.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+static void parse_value(const std::string &str, rule_action &action)
+{
+	if (parse_int(str, action.i_value)) {
+		action.type = RULE_VALUE_INT;
+	}
+	else if (str == "true" || str == "false") {
+		action.type = RULE_VALUE_BOOL;
+		action.i_value = (str == "true");
+	}
+	else {
+		action.type = RULE_VALUE_STRING;
+		action.i_value = 0;
+		action.s_value = str;
+	}
+}
+
+static bool parse_op(const std::string &str, uint8_t &op)
+{
+	static const struct
+	{
+		const char *name;
+		rule_op op;
+	} ops[] = {
+		{ ">", RULE_GT }, { ">=", RULE_GE }, { "<", RULE_LT },
+		{ "<=", RULE_LE }, { "==", RULE_EQ }, { "!=", RULE_NE },
+	};
+
+	for (auto &entry : ops) {
+		if (str == entry.name) {
+			op = entry.op;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// "<source>.<attribute>" or "<func>(<source>.<attribute>, <window>[, <mode>])"
+static bool parse_input(const std::string &str, parsed_rule &rule)
+{
+	size_t open = str.find('(');
+
+	rule.aggregated = false;
+	if (open == std::string::npos)
+		return parse_path(str, rule.source, rule.attribute);
+	if (str[str.size() - 1] != ')')
+		return false;
+
+	std::string args = str.substr(open + 1, str.size() - open - 2);
+	size_t first = args.find(',');
+	if (first == std::string::npos)
+		return false;
+	size_t second = args.find(',', first + 1);
+	std::string mode;
+	if (second != std::string::npos)
+		mode = trim(args.substr(second + 1));
+	else
+		second = args.size();
+
+	rule.aggregated = true;
+	return parse_path(trim(args.substr(0, first)), rule.source, rule.attribute)
+		&& parse_aggregate(trim(str.substr(0, open)),
+			trim(args.substr(first + 1, second - first - 1)), mode, rule.aggregate);
+}
+
+static bool parse_condition(const std::string &str, parsed_rule &rule)
+{
+	size_t op_begin = str.find_first_of("<>=!");
+	if (op_begin == std::string::npos)
+		return false;
+	size_t op_end = str.find_first_not_of("<>=!", op_begin);
+	if (op_end == std::string::npos)
+		return false;
+
+	std::string limits = str.substr(op_end);
+	size_t tilde = limits.find('~');
+	int threshold, hysteresis = 0;
+	if (!parse_input(trim(str.substr(0, op_begin)), rule)
+		|| !parse_op(str.substr(op_begin, op_end - op_begin), rule.predicate.op)
+		|| !parse_int(trim(limits.substr(0, tilde)), threshold))
+		return false;
+	if (tilde != std::string::npos
+		&& (!parse_int(trim(limits.substr(tilde + 1)), hysteresis) || hysteresis < 0))
+		return false;
+
+	rule.predicate.threshold = threshold;
+	rule.predicate.hysteresis = hysteresis;
+	return true;
+}
+
+static bool parse_action(const std::string &str, parsed_rule &rule)
+{
+	size_t assign = str.find('=');
+	if (assign == std::string::npos)
+		return false;
+
+	if (!parse_path(trim(str.substr(0, assign)), rule.action.target, rule.action.attribute))
+		return false;
+
+	std::string values = str.substr(assign + 1);
+	size_t colon = values.find(':');
+	std::string value = trim(values.substr(0, colon));
+	if (value.empty())
+		return false;
+	parse_value(value, rule.action);
+
+	rule.has_release = false;
+	if (colon != std::string::npos) {
+		value = trim(values.substr(colon + 1));
+		if (value.empty())
+			return false;
+		rule.release.target = rule.action.target;
+		rule.release.attribute = rule.action.attribute;
+		parse_value(value, rule.release);
+		rule.has_release = true;
+	}
+
+	return true;
+}
+
+static bool rule_less(const parsed_rule &a, const parsed_rule &b)
+{
+	if (a.source != b.source)
+		return a.source < b.source;
+	if (a.attribute != b.attribute)
+		return a.attribute < b.attribute;
+	if (a.aggregated != b.aggregated)
+		return b.aggregated;
+	return a.aggregated && a.aggregate < b.aggregate;
+}
+
+static uint16_t aggregate_slot(rule_table &table, const parsed_rule &rule)
+{
+	if (!rule.aggregated)
+		return RULE_RAW;
+
+	for (size_t i = 0; i < table.aggregates.size(); i++) {
+		if (table.aggregates[i].attribute == rule.attribute
+			&& table.aggregates[i].spec == rule.aggregate)
+			return i;
+	}
+
+	rule_aggregate aggregate;
+	aggregate.attribute = rule.attribute;
+	aggregate.spec = rule.aggregate;
+	table.aggregates.push_back(aggregate);
+	table.updates[rule.attribute].push_back(table.aggregates.size() - 1);
+	return table.aggregates.size() - 1;
+}
+
+RuleEngine::RuleEngine() : m_table(std::make_shared<rule_table>())
+{
+}
+
+bool RuleEngine::compile(const std::string &text, std::string &error)
+{
+	std::vector<parsed_rule> rules;
+	size_t begin = 0;
+
+	while (begin <= text.size()) {
+		size_t end = text.find_first_of(";\n", begin);
+		if (end == std::string::npos)
+			end = text.size();
+
+		std::string clause = trim(text.substr(begin, end - begin));
+		begin = end + 1;
+		if (clause.empty())
+			continue;
+
+		parsed_rule rule;
+		size_t arrow = clause.find("->");
+		if (arrow == std::string::npos
+			|| !parse_condition(clause.substr(0, arrow), rule)
+			|| !parse_action(clause.substr(arrow + 2), rule)) {
+			error = "invalid rule: " + clause;
+			return false;
+		}
+		rules.push_back(rule);
+	}
+
+	if (rules.size() * 2 >= RULE_NO_ACTION) {
+		error = "too many rules";
+		return false;
+	}
+
+	std::stable_sort(rules.begin(), rules.end(), rule_less);
+
+	std::shared_ptr<rule_table> table = std::make_shared<rule_table>();
+	table->predicates.reserve(rules.size());
+	for (auto &rule : rules) {
+		std::vector<rule_group> &groups = table->sources[rule.source];
+		uint16_t slot = aggregate_slot(*table, rule);
+		if (groups.empty() || groups.back().attribute != rule.attribute
+			|| groups.back().aggregate != slot) {
+			rule_group group;
+			group.attribute = rule.attribute;
+			group.aggregate = slot;
+			group.begin = group.end = table->predicates.size();
+			groups.push_back(group);
+		}
+
+		rule_predicate predicate = rule.predicate;
+		predicate.action = table->actions.size();
+		table->actions.push_back(rule.action);
+		predicate.release = RULE_NO_ACTION;
+		if (rule.has_release) {
+			predicate.release = table->actions.size();
+			table->actions.push_back(rule.release);
+		}
+
+		table->predicates.push_back(predicate);
+		groups.back().end++;
+	}
+
+	std::atomic_store(&m_table, table);
+	return true;
+}
+
+static inline bool rule_test(const rule_predicate &predicate, uint8_t state, int value)
+{
+	int threshold = predicate.threshold;
+
+	// a condition that holds stays true inside its hysteresis band
+	if (state == 1) {
+		if (predicate.op <= RULE_GE)
+			threshold -= predicate.hysteresis;
+		else if (predicate.op <= RULE_LE)
+			threshold += predicate.hysteresis;
+	}
+
+	switch (predicate.op) {
+		case RULE_GT: return value > threshold;
+		case RULE_GE: return value >= threshold;
+		case RULE_LT: return value < threshold;
+		case RULE_LE: return value <= threshold;
+		case RULE_EQ: return value == threshold;
+		default: return value != threshold;
+	}
+}
+
+// Moves 'windows' over to 'table', keeping the windows it still uses.
+static void rebind(stream_windows &windows, const std::shared_ptr<rule_table> &table)
+{
+	size_t count = table->aggregates.size();
+	std::vector<std::unique_ptr<WindowAggregate> > kept(count);
+
+	for (size_t i = 0; windows.table && i < count; i++) {
+		const rule_aggregate &wanted = table->aggregates[i];
+		for (size_t j = 0; j < windows.windows.size(); j++) {
+			const rule_aggregate &had = windows.table->aggregates[j];
+			if (windows.windows[j] && had.attribute == wanted.attribute
+				&& had.spec == wanted.spec) {
+				kept[i] = std::move(windows.windows[j]);
+				break;
+			}
+		}
+	}
+
+	windows.windows.swap(kept);
+	windows.values.assign(count, 0);
+	windows.ready.assign(count, 0);
+	windows.states.assign(table->predicates.size(), RULE_STATE_UNKNOWN);
+	windows.table = table;
+}
+
+void RuleEngine::aggregate(stream_windows &windows, const std::string &attribute,
+		int value, int64_t now_ms)
+{
+	std::shared_ptr<rule_table> table = std::atomic_load(&m_table);
+
+	if (windows.table != table)
+		rebind(windows, table);
+
+	auto iter = table->updates.find(attribute);
+	if (iter == table->updates.end())
+		return;
+
+	for (uint16_t slot : iter->second) {
+		std::unique_ptr<WindowAggregate> &window = windows.windows[slot];
+		if (!window)
+			window.reset(new WindowAggregate(table->aggregates[slot].spec));
+		windows.ready[slot] = window->add(now_ms, value, windows.values[slot]);
+	}
+}
+
+void RuleEngine::evaluate(const std::string &source, const std::string &attribute,
+		int value, stream_windows &windows, const RuleActionCallback &fire)
+{
+	std::shared_ptr<rule_table> table = std::atomic_load(&m_table);
+	bool matched = false;
+
+	auto iter = table->sources.find(source);
+	if (iter == table->sources.end())
+		return;
+
+	if (windows.table != table)
+		rebind(windows, table);
+
+	for (auto &group : iter->second) {
+		// the groups of an attribute are next to each other
+		if (group.attribute != attribute) {
+			if (matched)
+				return;
+			continue;
+		}
+		matched = true;
+
+		int input = value;
+		if (group.aggregate != RULE_RAW) {
+			if (!windows.ready[group.aggregate])
+				continue;
+			input = windows.values[group.aggregate];
+		}
+
+		for (uint32_t i = group.begin; i < group.end; i++) {
+			const rule_predicate &predicate = table->predicates[i];
+			uint8_t state = rule_test(predicate, windows.states[i], input);
+			if (state == windows.states[i])
+				continue;
+			windows.states[i] = state;
+
+			uint16_t action = state ? predicate.action : predicate.release;
+			if (action != RULE_NO_ACTION)
+				fire(table->actions[action]);
+		}
+	}
+}
+
+size_t RuleEngine::size() const
+{
+	return std::atomic_load(&m_table)->predicates.size();
+}
@@ -0,0 +1,160 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef RULE_ENGINE_H_
+#define RULE_ENGINE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "stream_aggregate.h"
+
+// Rules are uploaded as text, one rule per line or separated by ';':
+//
+//   <source>.<attribute> <op> <threshold> [~ <band>] -> <target>.<attribute> = <value> [: <value>]
+//
+// <op> is one of > >= < <= == !=. The first value is PUT to the target
+// when the condition becomes true, the optional second one when it
+// becomes false again. With a hysteresis band an ordering condition only
+// becomes false again once the value has moved 'band' past the threshold.
+// Values are integers, true/false or bare strings.
+//
+// Instead of the raw samples a condition can test an aggregate of them,
+// kept for each device: <func>(<source>.<attribute>, <window>[, tumbling])
+// with <func> one of min, max, mean, ewma and p1 to p99 (percentiles)
+// and <window> a length such as 500ms, 10s, 5m or 1h. Windows slide
+// unless they are tumbling, which only report once per window.
+//
+// Example: "gas.density > 70 ~ 5 -> fan.fanstate = on : off"
+// Example: "p50(gas.density, 5s) > 70 -> fan.fanstate = on : off"
+
+enum rule_op
+{
+	RULE_GT = 0,
+	RULE_GE,
+	RULE_LT,
+	RULE_LE,
+	RULE_EQ,
+	RULE_NE
+};
+
+enum rule_value_type
+{
+	RULE_VALUE_INT = 0,
+	RULE_VALUE_BOOL,
+	RULE_VALUE_STRING
+};
+
+struct rule_action
+{
+	std::string target;
+	std::string attribute;
+	rule_value_type type;
+	int i_value;
+	std::string s_value;
+};
+
+#define RULE_NO_ACTION 0xffff
+#define RULE_RAW 0xffff
+
+// One compiled condition. Conditions on the same source attribute are
+// stored next to each other so an observation walks a single flat range.
+struct rule_predicate
+{
+	int32_t threshold;
+	int32_t hysteresis;
+	uint8_t op;
+	uint16_t action;
+	uint16_t release;
+};
+
+struct rule_group
+{
+	std::string attribute;
+	// index into rule_table::aggregates, RULE_RAW for the samples
+	uint16_t aggregate;
+	uint32_t begin, end;
+};
+
+struct rule_aggregate
+{
+	std::string attribute;
+	aggregate_spec spec;
+};
+
+struct rule_table
+{
+	std::vector<rule_predicate> predicates;
+	std::vector<rule_action> actions;
+	std::unordered_map<std::string, std::vector<rule_group> > sources;
+	std::vector<rule_aggregate> aggregates;
+	// aggregates to update for each attribute
+	std::unordered_map<std::string, std::vector<uint16_t> > updates;
+};
+
+// The rule state of one device: the aggregates the rules need, created
+// on its first sample of each attribute, and the last result of each
+// predicate, so that a rule naming a kind keeps its hysteresis for every
+// device of that kind on its own. Only the pipeline worker the device is
+// sharded to touches them.
+struct stream_windows
+{
+	std::shared_ptr<rule_table> table;
+	std::vector<std::unique_ptr<WindowAggregate> > windows;
+	std::vector<int32_t> values;
+	std::vector<uint8_t> ready;
+	std::vector<uint8_t> states;
+};
+
+typedef std::function<void(const rule_action &action)> RuleActionCallback;
+
+class RuleEngine
+{
+	public:
+	RuleEngine();
+
+	// Compiles 'text' and replaces the active rule table. On a syntax
+	// error the active table is kept and 'error' describes the problem.
+	bool compile(const std::string &text, std::string &error);
+
+	// Adds one observation of a device to the aggregates the active
+	// table uses. Windows that a recompiled table still uses are kept.
+	void aggregate(stream_windows &windows, const std::string &attribute,
+			int value, int64_t now_ms);
+
+	// Checks one observation, and the aggregates 'windows' was just
+	// updated to, against the active table and calls 'fire' for every
+	// rule whose condition changed for this device. Does not allocate
+	// unless the table was replaced, and may be called from several
+	// threads at once for different devices.
+	void evaluate(const std::string &source, const std::string &attribute,
+			int value, stream_windows &windows, const RuleActionCallback &fire);
+
+	size_t size() const;
+
+	private:
+	std::shared_ptr<rule_table> m_table;
+};
+
+#endif /* RULE_ENGINE_H_ */
@@ -0,0 +1,101 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Checks of the rule engine, built with "scons TESTS=1" and run on the
+// host. Exits non-zero on the first failure.
+
+#include <stdio.h>
+#include <vector>
+#include "rule_engine.h"
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+// Two gas sensors on opposite sides of the threshold of one rule that
+// names their kind: each must switch the fan for itself and keep its
+// own hysteresis, rather than flapping a state the two share.
+static int test_kind_rule_per_device()
+{
+	RuleEngine engine;
+	std::string error;
+	std::vector<std::string> fired;
+	RuleActionCallback fire = [&fired](const rule_action &action) {
+		fired.push_back(action.s_value);
+	};
+	stream_windows kitchen, hall;
+
+	CHECK(engine.compile("gas.density > 70 ~ 5 -> fan.fanstate = on : off\n", error));
+
+	engine.evaluate("gas", "density", 90, kitchen, fire);
+	engine.evaluate("gas", "density", 10, hall, fire);
+	CHECK(fired.size() == 2 && fired[0] == "on" && fired[1] == "off");
+
+	// alternating samples of the two no longer toggle the rule
+	fired.clear();
+	for (int i = 0; i < 10; i++) {
+		engine.evaluate("gas", "density", 90, kitchen, fire);
+		engine.evaluate("gas", "density", 10, hall, fire);
+	}
+	CHECK(fired.empty());
+
+	// inside the band the kitchen stays on, below it switches off
+	engine.evaluate("gas", "density", 67, kitchen, fire);
+	CHECK(fired.empty());
+	engine.evaluate("gas", "density", 64, kitchen, fire);
+	CHECK(fired.size() == 1 && fired[0] == "off");
+
+	// and the hall rises on its own
+	fired.clear();
+	engine.evaluate("gas", "density", 71, hall, fire);
+	CHECK(fired.size() == 1 && fired[0] == "on");
+	return 0;
+}
+
+// A recompiled table starts every device over.
+static int test_recompile_resets_state()
+{
+	RuleEngine engine;
+	std::string error;
+	int count = 0;
+	RuleActionCallback fire = [&count](const rule_action &) { count++; };
+	stream_windows device;
+
+	CHECK(engine.compile("gas.density > 70 -> fan.fanstate = on\n", error));
+	engine.evaluate("gas", "density", 90, device, fire);
+	engine.evaluate("gas", "density", 90, device, fire);
+	CHECK(count == 1);
+
+	CHECK(engine.compile("gas.density > 80 -> fan.fanstate = on\n", error));
+	engine.evaluate("gas", "density", 90, device, fire);
+	CHECK(count == 2);
+	return 0;
+}
+
+int main()
+{
+	if (test_kind_rule_per_device() || test_recompile_resets_state())
+		return 1;
+	printf("rule_engine_test: ok\n");
+	return 0;
+}
@@ -20,17 +20,77 @@
 
 #include "rules_resource.h"
 #include "homegateway.h"
+#include "async_log.h"
 
-RulesResource::RulesResource() : m_crazyJumping(false), m_kitchenMonitor(false), m_density(70), m_heartRate(95)
+#define DENSITY_HYSTERESIS 5
+#define HEARTRATE_HYSTERESIS 3
+// the kitchen monitor acts on the median of the last few samples, so a
+// single ADC spike does not start the fan
+#define DENSITY_WINDOW "5s"
+#define DEFAULT_DWELL 1000
+
+RulesResource::RulesResource(RegistryStore *store) : m_crazyJumping(false), m_kitchenMonitor(false), m_density(70), m_heartRate(95),
+	m_dwell(DEFAULT_DWELL), m_store(store)
+{
+	std::string error;
+
+	restore();
+	if (!compileRules(m_crazyJumping, m_kitchenMonitor, m_density, m_heartRate, m_rules, error)) {
+		ALOG_ERROR("Stored rules no longer compile: {}", error);
+		m_rules.clear();
+		compileRules(m_crazyJumping, m_kitchenMonitor, m_density, m_heartRate, m_rules, error);
+	}
+}
+
+// Picks up the settings of the last successful PUT before a restart.
+void RulesResource::restore()
 {
+	m_store->load([this](const store_record &record) {
+		if (record.type != STORE_RULES || record.fields.size() < 7)
+			return;
+		m_crazyJumping = record.fields[1] == "1";
+		m_kitchenMonitor = record.fields[2] == "1";
+		m_density = atoi(record.fields[3].c_str());
+		m_heartRate = atoi(record.fields[4].c_str());
+		m_dwell = atoi(record.fields[5].c_str());
+		m_rules = record.fields[6];
+	});
 }
 
-void RulesResource::registerResource()
+void RulesResource::persist()
+{
+	m_store->append(store_record{STORE_RULES, {"rules",
+		m_crazyJumping ? "1" : "0", m_kitchenMonitor ? "1" : "0",
+		std::to_string(m_density), std::to_string(m_heartRate),
+		std::to_string(m_dwell.load()), m_rules}});
+}
+
+// The kitchen monitor, crazy jumping and motion light behaviours are
+// compiled as ordinary rules in front of the uploaded ones. On an error
+// the active rules stay in place.
+bool RulesResource::compileRules(bool crazyJumping, bool kitchenMonitor, int density, int heartRate,
+	const std::string &rules, std::string &error)
+{
+	std::ostringstream text;
+
+	if (kitchenMonitor)
+		text << "p50(gas.density, " << DENSITY_WINDOW << ") > " << density << " ~ " << DENSITY_HYSTERESIS
+			<< " -> fan.fanstate = on : off\n";
+	if (crazyJumping)
+		text << "heartRate.heartRate >= " << heartRate << " ~ " << HEARTRATE_HYSTERESIS
+			<< " -> led.ledColor = " << RED << " : " << GREEN << "\n";
+	text << "pri.motion == 1 -> led.ledColor = " << BLUE << "\n";
+	text << rules;
+
+	return m_engine.compile(text.str(), error);
+}
+
+void RulesResource::registerResource(AdmissionControl *admission)
 {
 	std::string resourceURI = RULES_RESOURCE_ENDPOINT;
 	std::string resourceTypeName = RULES_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
-	EntityHandler cb = std::bind(&RulesResource::entityHandler, this,PH::_1);
+	EntityHandler cb = admission->wrap(std::bind(&RulesResource::entityHandler, this,PH::_1));
 	uint8_t resourceProperty = OC_DISCOVERABLE;
 	OCStackResult result = OCPlatform::registerResource(m_resourceHandle,
 	resourceURI,
@@ -52,27 +112,53 @@ OCRepresentation  RulesResource::get()
 	m_rep.setValue("kitchenMonitor", m_kitchenMonitor);
 	m_rep.setValue("density", m_density);
 	m_rep.setValue("heartRate", m_heartRate);
+	m_rep.setValue("dwell", m_dwell.load());
+	m_rep.setValue("rules", m_rules);
 	return m_rep;
 }
 
-void  RulesResource::put(OCRepresentation rep)
+// A PUT is taken as a whole or not at all: nothing changes unless the
+// rules it leads to compile.
+bool RulesResource::put(OCRepresentation rep)
 {
+	bool crazyJumping = m_crazyJumping, kitchenMonitor = m_kitchenMonitor;
+	int density = m_density, heartRate = m_heartRate, dwell = m_dwell;
+	std::string rules = m_rules;
+	std::string error;
+
 	if (rep.hasAttribute("crazyJumping"))
-		rep.getValue("crazyJumping", m_crazyJumping);
+		rep.getValue("crazyJumping", crazyJumping);
 	if (rep.hasAttribute("kitchenMonitor"))
-		rep.getValue("kitchenMonitor", m_kitchenMonitor);
+		rep.getValue("kitchenMonitor", kitchenMonitor);
 	if (rep.hasAttribute("density"))
-		rep.getValue("density", m_density);
+		rep.getValue("density", density);
 	if (rep.hasAttribute("heartRate"))
-		rep.getValue("heartRate", m_heartRate);
+		rep.getValue("heartRate", heartRate);
+	if (rep.hasAttribute("dwell"))
+		rep.getValue("dwell", dwell);
+	if (rep.hasAttribute("rules"))
+		rep.getValue("rules", rules);
+
+	if (!compileRules(crazyJumping, kitchenMonitor, density, heartRate, rules, error)) {
+		ALOG_WARN("Rule compile error: {}", error);
+		return false;
+	}
+
+	m_crazyJumping = crazyJumping;
+	m_kitchenMonitor = kitchenMonitor;
+	m_density = density;
+	m_heartRate = heartRate;
+	m_dwell = dwell;
+	m_rules = rules;
+	persist();
+	return true;
 }
 
 OCEntityHandlerResult  RulesResource::entityHandler(std::shared_ptr<OCResourceRequest> request)
 {
 	OCEntityHandlerResult ehResult = OC_EH_ERROR;
 	if(request) {
-		std::cout << "In entity handler for Rule Resource, URI is : "
-			<< request->getResourceUri() << std::endl;
+		ALOG_DEBUG("In entity handler for Rule Resource, URI is : {}", request->getResourceUri());
 
 		if(request->getRequestHandlerFlag() == RequestHandlerFlag::RequestFlag) {
 			auto pResponse = std::make_shared<OC::OCResourceResponse>();
@@ -80,7 +166,7 @@ OCEntityHandlerResult  RulesResource::entityHandler(std::shared_ptr<OCResourceRe
 			pResponse->setResourceHandle(request->getResourceHandle());
 
 			if(request->getRequestType() == "GET") {
-				std::cout<<"Rule Get Request"<<std::endl;
+				ALOG_DEBUG("Rule Get Request");
 				pResponse->setErrorCode(200);
 				pResponse->setResourceRepresentation(get(), "");
 				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
@@ -88,24 +174,29 @@ OCEntityHandlerResult  RulesResource::entityHandler(std::shared_ptr<OCResourceRe
 				}
 			}
 			else if(request->getRequestType() == "PUT") {
-				std::cout <<"Rule Put Request"<<std::endl;
-				put(request->getResourceRepresentation());
-				pResponse->setErrorCode(200);
-				pResponse->setResourceRepresentation(get(), "");
-				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
-					ehResult = OC_EH_OK;
+				ALOG_DEBUG("Rule Put Request");
+				if (put(request->getResourceRepresentation())) {
+					pResponse->setErrorCode(200);
+					pResponse->setResourceRepresentation(get(), "");
+					if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
+						ehResult = OC_EH_OK;
+					}
+				}
+				else {
+					pResponse->setErrorCode(400);
+					pResponse->setResponseResult(OC_EH_ERROR);
+					OCPlatform::sendResponse(pResponse);
 				}
 			}
 			else {
-				std::cout << "Rule unsupported request type"
-				<< request->getRequestType() << std::endl;
+				ALOG_WARN("Rule unsupported request type {}", request->getRequestType());
 				pResponse->setResponseResult(OC_EH_ERROR);
 				OCPlatform::sendResponse(pResponse);
 				ehResult = OC_EH_ERROR;
 			}
 		}
 		else {
-			std::cout << "Rule unsupported request flag" <<std::endl;
+			ALOG_WARN("Rule unsupported request flag");
 		}
 	}
 
@@ -20,19 +20,32 @@
 
 #ifndef RULES_RESOURCE_H_
 #define RULES_RESOURCE_H_
+#include <atomic>
 #include "resource.h"
+#include "rule_engine.h"
+#include "registry_store.h"
+#include "admission.h"
 
 class RulesResource : public Resource
 {
 	public:
 	bool m_crazyJumping, m_kitchenMonitor;
 	int m_density, m_heartRate;
-	RulesResource();
+	// read by the pipeline and the main loop while a PUT may change it
+	std::atomic<int> m_dwell;
+	std::string m_rules;
+	RuleEngine m_engine;
+	RegistryStore *m_store;
+	RulesResource(RegistryStore *store);
 
-	void registerResource();
+	void registerResource(AdmissionControl *admission);
 	private:
+	bool compileRules(bool crazyJumping, bool kitchenMonitor, int density, int heartRate,
+		const std::string &rules, std::string &error);
+	void restore();
+	void persist();
 	OCRepresentation get();
-	void put(OCRepresentation rep);
+	bool put(OCRepresentation rep);
 	protected:
 	virtual OCEntityHandlerResult entityHandler(std::shared_ptr<OCResourceRequest> request);
 };
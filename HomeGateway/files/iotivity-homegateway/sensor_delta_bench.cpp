@@ -0,0 +1,169 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Bytes and CPU per /gw/sensor change, built with "scons TESTS=1" and run
+// on the host. A thousand registered sensors go offline and come back
+// one at a time; after each change the notification is encoded the way
+// ChangeSensorRepresentation does, once as the full list and once as
+// the delta since the previous version. A client applying the deltas
+// must end up with the gateway's list, and one that fell behind the
+// change log must get the snapshot.
+//
+//	sensor_delta_bench [changes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sstream>
+#include "sensor_resource.h"
+
+#define BENCH_SENSORS 1000
+#define BENCH_CHANGES 10000
+#define BENCH_STORE "/tmp/sensor_delta_bench.reg"
+
+static double cpu_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Applies a delta notification to a client's copy of the list.
+static void apply_delta(SensorMap &client, const OCRepresentation &rep)
+{
+	std::string entry;
+	std::istringstream added(rep.getValue<std::string>("added"));
+	std::istringstream removed(rep.getValue<std::string>("removed"));
+
+	while (std::getline(added, entry, ',')) {
+		size_t pos = entry.find('=');
+		client[entry.substr(0, pos)] = entry.substr(pos + 1);
+	}
+	while (std::getline(removed, entry, ','))
+		client.erase(entry);
+}
+
+struct delta_bench
+{
+	SensorResource &m_sensor;
+	std::vector<std::string> m_names;
+
+	delta_bench(SensorResource &sensor) : m_sensor(sensor)
+	{
+		std::lock_guard<std::mutex> lock(m_sensor.m_resourceLock);
+		for (int i = 0; i < BENCH_SENSORS; i++) {
+			char name[32], address[32];
+			snprintf(name, sizeof(name), "sensor%04d", i);
+			snprintf(address, sizeof(address), "98:4F:EE:%02X:%02X:%02X", i >> 16, (i >> 8) & 0xff, i & 0xff);
+			m_sensor.mapSensor(name, address);
+			m_names.push_back(name);
+		}
+		m_sensor.m_notifiedVersion = m_sensor.m_version;
+	}
+
+	int run(int changes)
+	{
+		NotifyMux full, delta;
+		SensorMap client = m_sensor.m_sensorMap;
+		double full_us = 0, delta_us = 0;
+		size_t full_bytes = 0, delta_bytes = 0;
+		int stale = m_sensor.m_version;
+
+		std::lock_guard<std::mutex> lock(m_sensor.m_resourceLock);
+		for (int n = 0; n < changes; n++) {
+			// one sensor per change: the first pass takes them offline,
+			// the second brings them back
+			const std::string &name = m_names[n % m_names.size()];
+			if ((n / m_names.size()) % 2 == 0)
+				m_sensor.sensorOffline(name);
+			else
+				m_sensor.sensorOnline(name);
+
+			double start = cpu_us();
+			EncodedRepresentation encoded = full.encode(m_sensor.m_version,
+				[this]() { return m_sensor.get(); });
+			full_us += cpu_us() - start;
+			full_bytes += encoded->size();
+
+			OCRepresentation rep;
+			start = cpu_us();
+			encoded = delta.encode(m_sensor.m_version, [this, &rep]() {
+				rep = m_sensor.getChanges(m_sensor.m_notifiedVersion);
+				return rep;
+			});
+			delta_us += cpu_us() - start;
+			delta_bytes += encoded->size();
+			m_sensor.m_notifiedVersion = m_sensor.m_version;
+
+			apply_delta(client, rep);
+		}
+
+		printf("%d sensors, %d changes\n", (int)m_names.size(), changes);
+		printf("full   %8.0f bytes/change  %8.2f us/change\n",
+			(double)full_bytes / changes, full_us / changes);
+		printf("delta  %8.0f bytes/change  %8.2f us/change\n",
+			(double)delta_bytes / changes, delta_us / changes);
+
+		if (client != m_sensor.m_sensorMap) {
+			fprintf(stderr, "client list differs after applying the deltas\n");
+			return 1;
+		}
+		// a client from before the bench is past the change log
+		QueryParamsMap query;
+		query["since"] = std::to_string(stale);
+		if (changes > SENSOR_CHANGE_LOG && m_sensor.get(query).hasAttribute("delta")) {
+			fprintf(stderr, "a client behind the change log got a delta\n");
+			return 1;
+		}
+		query["since"] = std::to_string(m_sensor.m_version - 1);
+		if (!m_sensor.get(query).hasAttribute("delta")) {
+			fprintf(stderr, "a client one version behind got the snapshot\n");
+			return 1;
+		}
+		return 0;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	int changes = argc > 1 ? atoi(argv[1]) : BENCH_CHANGES;
+	PlatformConfig cfg(ServiceType::InProc, ModeType::Both, "127.0.0.1", 0, GATEWAY_QOS);
+
+	if (changes <= 0)
+		changes = BENCH_CHANGES;
+
+	OCPlatform::Configure(cfg);
+	unlink(BENCH_STORE);
+
+	RegistryStore store(BENCH_STORE);
+	AdmissionControl admission(ADMISSION_QUEUE_SIZE, ADMISSION_RATE, ADMISSION_BURST);
+	SensorHistory history(16 * 1024 * 1024);
+	ConfigResource config(&admission);
+	RulesResource rules(&store);
+	SensorResource sensor(&rules, &config, &store, &history, &admission);
+	delta_bench bench(sensor);
+	int result = bench.run(changes);
+
+	admission.stop();
+	unlink(BENCH_STORE);
+	return result;
+}
@@ -0,0 +1,438 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "sensor_history.h"
+
+#define BLOCK_BITS (HISTORY_BLOCK_SIZE * 8)
+#define COPY_SPINS 16
+
+// Bit 'pos' of a column, counted from its end of the block data.
+static inline size_t bit_at(bool reverse, size_t pos)
+{
+	return reverse ? BLOCK_BITS - 1 - pos : pos;
+}
+
+static void put_bits(uint8_t *data, bool reverse, size_t pos, uint64_t value, int bits)
+{
+	for (int i = bits - 1; i >= 0; i--, pos++) {
+		size_t at = bit_at(reverse, pos);
+		if ((value >> i) & 1)
+			data[at >> 3] |= 1 << (at & 7);
+		else
+			data[at >> 3] &= ~(1 << (at & 7));
+	}
+}
+
+static uint64_t get_bits(const uint8_t *data, bool reverse, size_t pos, int bits)
+{
+	uint64_t value = 0;
+
+	for (int i = 0; i < bits; i++, pos++) {
+		size_t at = bit_at(reverse, pos);
+		value = (value << 1) | ((data[at >> 3] >> (at & 7)) & 1);
+	}
+
+	return value;
+}
+
+// Bits an entry for 'delta' adds to a column, nothing when it extends a
+// run of zeros.
+static int column_cost(const history_block &block, const history_column &column, bool reverse, int64_t delta)
+{
+	uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+	if (zigzag == 0 && column.used > 0) {
+		uint64_t code = get_bits(block.data, reverse, column.last_at, 2);
+		if (code == 1 && get_bits(block.data, reverse, column.last_at + 2, 8) < 255)
+			return 0;
+		if (code == 0)
+			return 8;
+	}
+
+	if (zigzag == 0)
+		return 2;
+	if (zigzag <= 4)
+		return 4;
+	if (zigzag <= 68)
+		return 9;
+	if (zigzag <= 65604)
+		return 20;
+	return 68;
+}
+
+static void column_append(history_block &block, history_column &column, bool reverse, int64_t delta)
+{
+	uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+	uint8_t *data = block.data;
+
+	if (zigzag == 0 && column.used > 0) {
+		uint64_t code = get_bits(data, reverse, column.last_at, 2);
+		uint64_t run = get_bits(data, reverse, column.last_at + 2, 8);
+		if (code == 1 && run < 255) {
+			put_bits(data, reverse, column.last_at + 2, run + 1, 8);
+			return;
+		}
+		// a single zero before this one becomes a run of two
+		if (code == 0) {
+			put_bits(data, reverse, column.last_at, 1, 2);
+			put_bits(data, reverse, column.last_at + 2, 0, 8);
+			column.used = column.last_at + 10;
+			return;
+		}
+	}
+
+	column.last_at = column.used;
+	if (zigzag == 0) {
+		put_bits(data, reverse, column.used, 0, 2);
+		column.used += 2;
+	}
+	else if (zigzag <= 4) {
+		put_bits(data, reverse, column.used, 0x2 << 2 | (zigzag - 1), 4);
+		column.used += 4;
+	}
+	else if (zigzag <= 68) {
+		put_bits(data, reverse, column.used, 0x6 << 6 | (zigzag - 5), 9);
+		column.used += 9;
+	}
+	else if (zigzag <= 65604) {
+		put_bits(data, reverse, column.used, 0xe << 16 | (zigzag - 69), 20);
+		column.used += 20;
+	}
+	else {
+		put_bits(data, reverse, column.used, 0xf, 4);
+		put_bits(data, reverse, column.used + 4, zigzag, 64);
+		column.used += 68;
+	}
+}
+
+// Walks a column entry by entry, expanding the runs of zeros.
+class column_reader
+{
+	public:
+	column_reader(const history_block &block, bool reverse) :
+		m_data(block.data), m_reverse(reverse), m_pos(0), m_zeros(0) {}
+
+	int64_t next()
+	{
+		uint64_t zigzag;
+
+		if (m_zeros > 0) {
+			m_zeros--;
+			return 0;
+		}
+
+		if (!bit()) {
+			if (bit())
+				m_zeros = bits(8) + 1;
+			return 0;
+		}
+		if (!bit())
+			zigzag = bits(2) + 1;
+		else if (!bit())
+			zigzag = bits(6) + 5;
+		else if (!bit())
+			zigzag = bits(16) + 69;
+		else
+			zigzag = bits(64);
+
+		return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+	}
+
+	private:
+	uint64_t bits(int count)
+	{
+		uint64_t value = get_bits(m_data, m_reverse, m_pos, count);
+		m_pos += count;
+		return value;
+	}
+
+	bool bit() { return bits(1) != 0; }
+
+	const uint8_t *m_data;
+	bool m_reverse;
+	size_t m_pos;
+	int m_zeros;
+};
+
+SensorHistory::SensorHistory(size_t budget) : m_generation(0)
+{
+	m_blockCount = budget / sizeof(history_slot);
+	if (m_blockCount == 0)
+		m_blockCount = 1;
+	m_slots.reset(new history_slot[m_blockCount]);
+
+	for (size_t i = 0; i < m_blockCount; i++) {
+		m_slots[i].seq.store(0, std::memory_order_relaxed);
+		m_slots[i].block.generation = 0;
+		m_slots[i].owner = nullptr;
+		m_free.push_back(m_blockCount - 1 - i);
+	}
+}
+
+SensorHistory::history_series *SensorHistory::findSeries(uint32_t sourceId, const std::string &source,
+	const std::string *attribute)
+{
+	std::lock_guard<std::mutex> lock(m_seriesLock);
+
+	auto key = std::make_pair(sourceId, attribute);
+	auto iter = m_byKey.find(key);
+	if (iter != m_byKey.end())
+		return iter->second;
+
+	std::string name = source + "." + *attribute;
+	auto named = m_byName.find(name);
+	history_series *series;
+	if (named != m_byName.end()) {
+		series = named->second;
+	}
+	else {
+		m_series.push_back(history_series{name, -1, std::deque<int>()});
+		series = &m_series.back();
+		m_byName[name] = series;
+	}
+	m_byKey[key] = series;
+
+	return series;
+}
+
+void SensorHistory::append(uint32_t sourceId, const std::string &source, const std::string *attribute,
+	int64_t time_ms, int32_t value)
+{
+	history_series *series = findSeries(sourceId, source, attribute);
+	int64_t time = time_ms / HISTORY_RESOLUTION_MS;
+	int open = series->open;
+
+	if (open >= 0 && write(open, time, value))
+		return;
+
+	open = allocate(series);
+	if (open >= 0)
+		write(open, time, value);
+}
+
+// Appends a sample to an open block; false when the block is full.
+bool SensorHistory::write(int index, int64_t time, int32_t value)
+{
+	history_slot &slot = m_slots[index];
+	history_block &block = slot.block;
+	uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+
+	int64_t step = time - block.last_time;
+	int64_t change = (int64_t)value - block.last_value;
+
+	if (block.count > 0 && block.time.used + block.value.used +
+		column_cost(block, block.time, false, step - block.last_step) +
+		column_cost(block, block.value, true, change) > BLOCK_BITS)
+		return false;
+
+	slot.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if (block.count == 0) {
+		block.first_time = time;
+		block.first_value = value;
+		block.last_step = 0;
+	}
+	else {
+		column_append(block, block.time, false, step - block.last_step);
+		column_append(block, block.value, true, change);
+		block.last_step = step;
+	}
+	block.last_time = time;
+	block.last_value = value;
+	block.count++;
+
+	slot.seq.store(seq + 2, std::memory_order_release);
+	return true;
+}
+
+// Seals the open block of 'series' and gives it a fresh one, recycling
+// the oldest sealed block when the pool is used up.
+int SensorHistory::allocate(history_series *owner)
+{
+	std::lock_guard<std::mutex> lock(m_poolLock);
+	int index;
+
+	if (owner->open >= 0) {
+		owner->sealed.push_back(owner->open);
+		m_ring.push_back(owner->open);
+		owner->open = -1;
+	}
+
+	if (!m_free.empty()) {
+		index = m_free.back();
+		m_free.pop_back();
+	}
+	else if (!m_ring.empty()) {
+		index = m_ring.front();
+		m_ring.pop_front();
+		// blocks are sealed in order, so the oldest of the ring is the
+		// oldest of its series
+		m_slots[index].owner->sealed.pop_front();
+	}
+	else {
+		return -1;
+	}
+
+	history_slot &slot = m_slots[index];
+	uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+	slot.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.owner = owner;
+	slot.block.generation = ++m_generation;
+	slot.block.count = 0;
+	slot.block.time.used = 0;
+	slot.block.value.used = 0;
+	slot.seq.store(seq + 2, std::memory_order_release);
+
+	owner->open = index;
+	return index;
+}
+
+// Copies a consistent snapshot of a block, retrying for as long as its
+// writer is in the middle of an append; a write only takes a moment, so
+// after a few spins the reader yields to it. Returns false only when the
+// block was recycled for another series, whose samples are then gone.
+bool SensorHistory::copyBlock(int index, uint32_t generation, history_block &copy)
+{
+	history_slot &slot = m_slots[index];
+
+	for (int i = 0; ; i++) {
+		if (i >= COPY_SPINS)
+			std::this_thread::yield();
+
+		uint32_t seq = slot.seq.load(std::memory_order_acquire);
+		if (seq & 1)
+			continue;
+
+		memcpy(&copy, &slot.block, sizeof(copy));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) == seq)
+			return copy.generation == generation;
+	}
+}
+
+bool SensorHistory::query(const std::string &source, const std::string &attribute, int64_t from_ms,
+	int64_t to_ms, int64_t step_ms, size_t max_points, std::vector<history_point> &points, bool &truncated)
+{
+	std::vector<std::pair<int, uint32_t> > blocks;
+	history_block block;
+	history_series *series;
+	int64_t bucket = 0;
+	double sum = 0;
+	int count = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_seriesLock);
+		auto iter = m_byName.find(source + "." + attribute);
+		if (iter == m_byName.end())
+			return false;
+		series = iter->second;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_poolLock);
+		for (int index : series->sealed)
+			blocks.push_back(std::make_pair(index, m_slots[index].block.generation));
+		if (series->open >= 0)
+			blocks.push_back(std::make_pair(series->open, m_slots[series->open].block.generation));
+	}
+
+	points.clear();
+	truncated = false;
+	// a block recycled since the list was taken fails the generation check
+	for (auto &entry : blocks) {
+		if (truncated)
+			break;
+		if (!copyBlock(entry.first, entry.second, block) || block.count == 0)
+			continue;
+		if ((block.last_time + 1) * HISTORY_RESOLUTION_MS <= from_ms ||
+			block.first_time * HISTORY_RESOLUTION_MS > to_ms)
+			continue;
+
+		column_reader times(block, false), values(block, true);
+		int64_t time = block.first_time;
+		int64_t value = block.first_value;
+		int64_t step = 0;
+		for (uint32_t i = 0; i < block.count; i++) {
+			if (i > 0) {
+				step += times.next();
+				time += step;
+				value += values.next();
+			}
+
+			int64_t time_ms = time * HISTORY_RESOLUTION_MS;
+			if (time_ms < from_ms || time_ms > to_ms)
+				continue;
+
+			// a sample (or bucket) past max_points ends the query
+			if (step_ms <= 0) {
+				if (points.size() >= max_points) {
+					truncated = true;
+					break;
+				}
+				points.push_back(history_point{time_ms, (double)value});
+				continue;
+			}
+
+			int64_t start = from_ms + (time_ms - from_ms) / step_ms * step_ms;
+			if (count > 0 && start != bucket) {
+				if (points.size() >= max_points) {
+					truncated = true;
+					count = 0;
+					break;
+				}
+				points.push_back(history_point{bucket, sum / count});
+				sum = 0;
+				count = 0;
+			}
+			bucket = start;
+			sum += value;
+			count++;
+		}
+	}
+
+	if (count > 0 && points.size() >= max_points)
+		truncated = true;
+	else if (count > 0)
+		points.push_back(history_point{bucket, sum / count});
+
+	return true;
+}
+
+std::vector<std::string> SensorHistory::series()
+{
+	std::lock_guard<std::mutex> lock(m_seriesLock);
+	std::vector<std::string> names;
+
+	for (auto &entry : m_byName)
+		names.push_back(entry.first);
+
+	return names;
+}
+
+int64_t SensorHistory::now_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,149 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef SENSOR_HISTORY_H_
+#define SENSOR_HISTORY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define HISTORY_BLOCK_SIZE 464
+
+#define HISTORY_RESOLUTION_MS 1000
+
+// A block holds consecutive samples of one series as two bit packed
+// columns sharing its data: the time column grows from the first bit,
+// the value column back from the last, so either may take what the
+// other leaves. The time column has the delta-of-delta of the times (in
+// HISTORY_RESOLUTION_MS units), the value column the delta of the
+// values. Both use the same codes, with runs of zeros counted in place:
+//
+//	00		a zero
+//	01 + 8		a run of 2 to 257 zeros
+//	10 + 2		a zigzagged delta of 1 to 4
+//	110 + 6		5 to 68
+//	1110 + 16	69 to 65604
+//	1111 + 64	any other
+//
+// A sensor sampled at a steady rate so costs 10 bits per 257 timestamps,
+// an unchanging value as little, and a change of a few counts 4 bits.
+struct history_column
+{
+	// in bits, from the column's end of the data
+	uint16_t used;
+	uint16_t last_at;
+};
+
+struct history_block
+{
+	// changes every time the block is handed out
+	uint32_t generation;
+	uint32_t count;
+	int64_t first_time;
+	int64_t last_time;
+	int64_t last_step;
+	int32_t first_value;
+	int32_t last_value;
+	history_column time;
+	history_column value;
+	uint8_t data[HISTORY_BLOCK_SIZE];
+};
+
+struct history_point
+{
+	int64_t time_ms;
+	double value;
+};
+
+// SensorHistory keeps the recent samples of every device attribute in a
+// fixed pool of blocks sized from a memory budget. When the pool runs out
+// the oldest sealed block of any series is recycled, so the history as a
+// whole behaves as one ring.
+//
+// Each series has a single writer, the pipeline worker its source is
+// sharded to, which appends to its open block without locking. The pool
+// lock is only taken when a block fills up; queries take it just to copy
+// the list of blocks and then decode copies of them, so they never hold
+// up ingest.
+class SensorHistory
+{
+	public:
+	SensorHistory(size_t budget);
+
+	void append(uint32_t sourceId, const std::string &source, const std::string *attribute,
+		int64_t time_ms, int32_t value);
+
+	// Samples of source.attribute within [from_ms, to_ms]; with a step,
+	// the mean of each step long bucket that has samples. At most the
+	// first max_points come back; 'truncated' tells whether more matched.
+	bool query(const std::string &source, const std::string &attribute, int64_t from_ms,
+		int64_t to_ms, int64_t step_ms, size_t max_points, std::vector<history_point> &points,
+		bool &truncated);
+	// "source.attribute" names of all series.
+	std::vector<std::string> series();
+
+	size_t blocks() const { return m_blockCount; }
+
+	// Wall clock time in ms, as recorded with the samples.
+	static int64_t now_ms();
+
+	private:
+	struct history_series
+	{
+		std::string name;
+		int open;
+		std::deque<int> sealed;
+	};
+
+	history_series *findSeries(uint32_t sourceId, const std::string &source, const std::string *attribute);
+	struct history_slot
+	{
+		// odd while the block is being written; readers copy the block
+		// and copy it again when it changed under them
+		std::atomic<uint32_t> seq;
+		history_block block;
+		history_series *owner;
+	};
+
+	bool write(int index, int64_t time, int32_t value);
+	int allocate(history_series *series);
+	bool copyBlock(int index, uint32_t generation, history_block &copy);
+
+	size_t m_blockCount;
+	std::unique_ptr<history_slot[]> m_slots;
+	std::mutex m_seriesLock;
+	std::map<std::pair<uint32_t, const std::string *>, history_series *> m_byKey;
+	std::map<std::string, history_series *> m_byName;
+	// elements of a deque stay put as it grows
+	std::deque<history_series> m_series;
+	std::mutex m_poolLock;
+	std::vector<int> m_free;
+	uint32_t m_generation;
+	std::deque<int> m_ring;
+};
+
+#endif /* SENSOR_HISTORY_H_ */
@@ -0,0 +1,187 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Checks of the sample history, built with "scons TESTS=1" and run on
+// the host: the packed columns give back exactly what went in, range
+// and step queries pick the right samples and stop at max_points, and
+// a week of the series HISTORY_BUDGET_MB is sized for fits its share.
+// Exits non-zero on the first failure.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "homegateway.h"
+#include "sensor_history.h"
+
+#define TEST_EPOCH 1700000000000LL
+#define TEST_WEEK (7 * 24 * 3600)
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+static const std::string s_attribute("value");
+
+// Deltas of every size the columns have a code for, runs of zeros
+// among them, and a clock that mostly ticks but also jumps and goes
+// back.
+static int test_round_trip()
+{
+	SensorHistory history(16 * 1024 * 1024);
+	std::mt19937 rng(1);
+	std::vector<history_point> expected, points;
+	int64_t time = TEST_EPOCH;
+	int32_t value = 0;
+	bool truncated;
+
+	// the small steps wrap around the ends of the int32 range
+	for (int i = 0; i < 200000; i++) {
+		switch (rng() % 8) {
+		case 0: value = (int32_t)((uint32_t)value + rng() % 9 - 4); break;
+		case 1: value = (int32_t)((uint32_t)value + rng() % 129 - 64); break;
+		case 2: value = (int32_t)((uint32_t)value + rng() % 65536 - 32768); break;
+		case 3: value = (int32_t)rng(); break;
+		case 4: value = rng() % 2 ? INT32_MAX : INT32_MIN; break;
+		default: break;
+		}
+		switch (rng() % 16) {
+		case 0: time += (rng() % 100000) * HISTORY_RESOLUTION_MS; break;
+		case 1: time -= (rng() % 5) * HISTORY_RESOLUTION_MS; break;
+		case 2: time += 2 * HISTORY_RESOLUTION_MS; break;
+		default: time += HISTORY_RESOLUTION_MS; break;
+		}
+		history.append(1, "device", &s_attribute, time, value);
+		expected.push_back(history_point{time, (double)value});
+	}
+
+	CHECK(history.query("device", "value", INT64_MIN, INT64_MAX, 0, expected.size(), points, truncated));
+	CHECK(!truncated);
+	CHECK(points.size() == expected.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		CHECK(points[i].time_ms == expected[i].time_ms);
+		CHECK(points[i].value == expected[i].value);
+	}
+	return 0;
+}
+
+// One sample a second for 100 s, the value counting up with the time.
+static void fill_ramp(SensorHistory &history)
+{
+	for (int i = 0; i < 100; i++)
+		history.append(1, "ramp", &s_attribute, TEST_EPOCH + i * HISTORY_RESOLUTION_MS, i);
+}
+
+static int test_range()
+{
+	SensorHistory history(1024 * 1024);
+	std::vector<history_point> points;
+	bool truncated;
+
+	fill_ramp(history);
+	CHECK(!history.query("missing", "value", 0, INT64_MAX, 0, 1000, points, truncated));
+
+	// both ends are inclusive
+	CHECK(history.query("ramp", "value", TEST_EPOCH + 10000, TEST_EPOCH + 19000, 0, 1000, points, truncated));
+	CHECK(!truncated);
+	CHECK(points.size() == 10);
+	CHECK(points.front().time_ms == TEST_EPOCH + 10000 && points.front().value == 10);
+	CHECK(points.back().time_ms == TEST_EPOCH + 19000 && points.back().value == 19);
+
+	// exactly max_points matching is not truncated
+	CHECK(history.query("ramp", "value", TEST_EPOCH, TEST_EPOCH + 99000, 0, 100, points, truncated));
+	CHECK(!truncated && points.size() == 100);
+
+	CHECK(history.query("ramp", "value", TEST_EPOCH, INT64_MAX, 0, 10, points, truncated));
+	CHECK(truncated && points.size() == 10);
+	CHECK(points.back().value == 9);
+	return 0;
+}
+
+static int test_step()
+{
+	SensorHistory history(1024 * 1024);
+	std::vector<history_point> points;
+	bool truncated;
+
+	fill_ramp(history);
+
+	// buckets start at from_ms and hold the mean of their samples
+	CHECK(history.query("ramp", "value", TEST_EPOCH, INT64_MAX, 10000, 1000, points, truncated));
+	CHECK(!truncated);
+	CHECK(points.size() == 10);
+	for (int i = 0; i < 10; i++) {
+		CHECK(points[i].time_ms == TEST_EPOCH + i * 10000);
+		CHECK(points[i].value == i * 10 + 4.5);
+	}
+
+	CHECK(history.query("ramp", "value", TEST_EPOCH + 5000, TEST_EPOCH + 24000, 10000, 1000, points, truncated));
+	CHECK(points.size() == 2);
+	CHECK(points[0].time_ms == TEST_EPOCH + 5000 && points[0].value == 9.5);
+
+	// the whole ramp is one block, which must not run past max_points
+	CHECK(history.query("ramp", "value", TEST_EPOCH, INT64_MAX, 1000, 10, points, truncated));
+	CHECK(truncated);
+	CHECK(points.size() == 10);
+	CHECK(points.back().value == 9);
+
+	CHECK(history.query("ramp", "value", TEST_EPOCH, INT64_MAX, 10000, 10, points, truncated));
+	CHECK(!truncated && points.size() == 10);
+	return 0;
+}
+
+// The series the default budget is sized for, a week of it on a clock
+// with a few ms of latency, in the share of the budget one series gets:
+// nothing may have been recycled.
+static int test_budget()
+{
+	SensorHistory history((size_t)HISTORY_BUDGET_MB * 1024 * 1024 / HISTORY_BUDGET_SERIES);
+	std::mt19937 rng(2);
+	std::vector<history_point> points;
+	int64_t phase = rng() % HISTORY_RESOLUTION_MS;
+	int32_t value = 500;
+	bool truncated;
+
+	for (int i = 0; i < TEST_WEEK; i++) {
+		if (rng() % 4 == 0)
+			value += (int32_t)(rng() % 7) - 3;
+		history.append(1, "sensor", &s_attribute, TEST_EPOCH + phase + i * 1000LL + rng() % 20, value);
+	}
+
+	CHECK(history.query("sensor", "value", INT64_MIN, INT64_MAX, 0, TEST_WEEK, points, truncated));
+	printf("a week of one series in a share of %zu blocks of %zu bytes, %zu samples kept\n",
+		history.blocks(), sizeof(history_block), points.size());
+	CHECK(!truncated);
+	CHECK(points.size() == TEST_WEEK);
+	CHECK(points.back().value == value);
+	return 0;
+}
+
+int main()
+{
+	if (test_round_trip() || test_range() || test_step() || test_budget())
+		return 1;
+
+	printf("sensor_history_test passed\n");
+	return 0;
+}
@@ -0,0 +1,171 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <string.h>
+#include "sensor_registry.h"
+
+static const struct
+{
+	const char *uri;
+	const char *name;
+	sensor_kind kind;
+} known_resources[] = {
+	{ "/sensor/gas", "gas", SENSOR_GAS },
+	{ "/a/fan", "fan", SENSOR_FAN },
+	{ "/intel/chainable_led_edison", "led", SENSOR_LED },
+	{ "/sensor/pri", "pri", SENSOR_PIR },
+};
+
+// A node with several sensors of a kind serves the others below the
+// kind's URI, as /sensor/gas/2.
+sensor_kind sensor_kind_from_uri(const std::string &uri)
+{
+	for (auto &known : known_resources) {
+		size_t length = strlen(known.uri);
+		if (uri.compare(0, length, known.uri) == 0 && (uri.size() == length || uri[length] == '/'))
+			return known.kind;
+	}
+
+	return SENSOR_UNKNOWN;
+}
+
+sensor_kind sensor_kind_from_name(const std::string &name)
+{
+	for (auto &known : known_resources) {
+		if (name == known.name)
+			return known.kind;
+	}
+
+	return SENSOR_UNKNOWN;
+}
+
+const std::string &sensor_kind_name(sensor_kind kind)
+{
+	static const std::string names[SENSOR_KIND_MAX] = {
+		"", "gas", "fan", "led", "pri"
+	};
+
+	return names[kind];
+}
+
+SensorRegistry::SensorRegistry()
+{
+}
+
+int SensorRegistry::add(const std::string &name, const std::string &type, bool registered)
+{
+	auto iter = m_byName.find(name);
+	if (iter != m_byName.end())
+		return iter->second;
+
+	int id = m_sensors.size();
+	sensor_data sensor;
+	sensor.s_name = name;
+	sensor.s_type = type;
+	sensor.s_kind = SENSOR_UNKNOWN;
+	sensor.s_sourceId = 0;
+	sensor.s_source = nullptr;
+	sensor.s_resource = nullptr;
+	sensor.s_active = false;
+	sensor.s_reobserving = false;
+	sensor.s_discoveryBackoff = 0;
+	sensor.s_nextDiscovery = 0;
+	m_sensors.push_back(sensor);
+
+	m_byName[name] = id;
+	if (registered)
+		m_byType[type].push_back(id);
+
+	return id;
+}
+
+int SensorRegistry::findByName(const std::string &name) const
+{
+	auto iter = m_byName.find(name);
+	return iter == m_byName.end() ? -1 : iter->second;
+}
+
+int SensorRegistry::findByUri(const std::string &uri) const
+{
+	auto iter = m_byUri.find(uri);
+	return iter == m_byUri.end() ? -1 : iter->second;
+}
+
+int SensorRegistry::findUnbound(const std::string &type) const
+{
+	auto iter = m_byType.find(type);
+	if (iter == m_byType.end())
+		return -1;
+
+	for (int id : iter->second) {
+		if (m_sensors[id].s_resource == nullptr)
+			return id;
+	}
+
+	return -1;
+}
+
+int SensorRegistry::firstActive(sensor_kind kind) const
+{
+	for (int id : m_byKind[kind]) {
+		const sensor_data &sensor = m_sensors[id];
+		if (sensor.s_active && sensor.s_resource)
+			return id;
+	}
+
+	return -1;
+}
+
+void SensorRegistry::bind(int id, std::shared_ptr<OCResource> resource, sensor_kind kind)
+{
+	sensor_data &sensor = m_sensors[id];
+
+	if (!sensor.s_uri.empty())
+		m_byUri.erase(sensor.s_uri);
+	sensor.s_uri = resource->host() + resource->uri();
+	m_byUri[sensor.s_uri] = id;
+	sensor.s_host = resource->host();
+	sensor.s_path = resource->uri();
+	sensor.s_resourceTypes = resource->getResourceTypes();
+	sensor.s_interfaces = resource->getResourceInterfaces();
+
+	if (sensor.s_kind != kind) {
+		if (sensor.s_kind != SENSOR_UNKNOWN) {
+			std::vector<int> &ids = m_byKind[sensor.s_kind];
+			ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+		}
+		m_byKind[kind].push_back(id);
+		sensor.s_kind = kind;
+	}
+
+	sensor.s_resource = resource;
+	sensor.s_active = true;
+}
+
+void SensorRegistry::unbind(int id)
+{
+	sensor_data &sensor = m_sensors[id];
+
+	if (!sensor.s_uri.empty()) {
+		m_byUri.erase(sensor.s_uri);
+		sensor.s_uri.clear();
+	}
+	sensor.s_resource = nullptr;
+}
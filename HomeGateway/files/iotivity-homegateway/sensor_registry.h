@@ -0,0 +1,77 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef SENSOR_REGISTRY_H_
+#define SENSOR_REGISTRY_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "homegateway.h"
+
+// SensorRegistry keeps the state of every registered device in one
+// contiguous vector. Entries are never removed, so an entry's index stays
+// valid for the lifetime of the gateway and can be bound into the observe
+// callback of the device's resource.
+class SensorRegistry
+{
+	public:
+	SensorRegistry();
+
+	// Returns the index of the sensor registered as 'name', adding it
+	// with resource type 'type' when it is not known yet. A sensor found
+	// without a registration is not 'registered', so findUnbound never
+	// hands its entry to another device of the same type.
+	int add(const std::string &name, const std::string &type, bool registered = true);
+
+	// Lookups return -1 when nothing matches.
+	int findByName(const std::string &name) const;
+	int findByUri(const std::string &uri) const;
+	// First registered sensor of resource type 'type' that has not been
+	// bound to a discovered resource yet.
+	int findUnbound(const std::string &type) const;
+	// First sensor of 'kind' that is active and has a resource.
+	int firstActive(sensor_kind kind) const;
+
+	void bind(int id, std::shared_ptr<OCResource> resource, sensor_kind kind);
+	void unbind(int id);
+
+	sensor_data &operator[](int id) { return m_sensors[id]; }
+	const sensor_data &operator[](int id) const { return m_sensors[id]; }
+	size_t size() const { return m_sensors.size(); }
+	std::vector<sensor_data>::iterator begin() { return m_sensors.begin(); }
+	std::vector<sensor_data>::iterator end() { return m_sensors.end(); }
+
+	private:
+	std::vector<sensor_data> m_sensors;
+	std::unordered_map<std::string, int> m_byName;
+	std::unordered_map<std::string, int> m_byUri;
+	std::unordered_map<std::string, std::vector<int> > m_byType;
+	std::vector<int> m_byKind[SENSOR_KIND_MAX];
+};
+
+// Maps the URI of a discovered resource to the kind of device behind it.
+sensor_kind sensor_kind_from_uri(const std::string &uri);
+// Maps the name a device of a known kind registers with ("gas", "fan",
+// "led", "pri") to its kind, and back.
+sensor_kind sensor_kind_from_name(const std::string &name);
+const std::string &sensor_kind_name(sensor_kind kind);
+
+#endif /* SENSOR_REGISTRY_H_ */
@@ -0,0 +1,142 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Times the sensor registry with a fleet of synthetic devices, built
+// with "scons TESTS=1" and run on the host: registration, discovery
+// (binding each found resource to its registration), observe dispatch
+// (looking a notifying resource up and its kind's handler) and the
+// liveness sweep of a timer wheel in which every device goes silent.
+// The resources are constructed locally, nothing goes on the network.
+//
+//	sensor_registry_bench [devices]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "sensor_registry.h"
+#include "timer_wheel.h"
+
+#define BENCH_DEVICES 10000
+#define BENCH_NOTIFICATIONS 1000000
+#define BENCH_TIMEOUT 5000
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_us(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+static const char *kind_uris[] = { "/sensor/gas", "/a/fan", "/intel/chainable_led_edison", "/sensor/pri" };
+static const char *kind_types[] = { "gas.sensor", "fan.sensor", "led.sensor", "pri.sensor" };
+
+static int dispatched[SENSOR_KIND_MAX];
+
+static void count_observe(sensor_data &sensor)
+{
+	dispatched[sensor.s_kind]++;
+}
+
+int main(int argc, char *argv[])
+{
+	int devices = argc > 1 ? atoi(argv[1]) : BENCH_DEVICES;
+	SensorRegistry registry;
+	std::vector<std::shared_ptr<OCResource> > resources;
+	std::vector<std::string> interfaces(1, DEFAULT_INTERFACE);
+	bench_clock::time_point start;
+	double us;
+
+	if (devices <= 0)
+		devices = BENCH_DEVICES;
+
+	for (int i = 0; i < devices; i++) {
+		char host[64];
+		snprintf(host, sizeof(host), "coap://10.%d.%d.%d:5683", i >> 16, (i >> 8) & 0xff, i & 0xff);
+		resources.push_back(OCPlatform::constructResourceObject(host, kind_uris[i % 4], OC_ALL, true,
+			std::vector<std::string>(1, kind_types[i % 4]), interfaces));
+	}
+
+	start = bench_clock::now();
+	for (int i = 0; i < devices; i++)
+		registry.add("device" + std::to_string(i), kind_types[i % 4]);
+	us = elapsed_us(start);
+	printf("register   %6d devices  %10.0f us  %7.3f us/device\n", devices, us, us / devices);
+
+	// as foundResource: a known endpoint first, then a free registration
+	start = bench_clock::now();
+	for (auto &resource : resources) {
+		int id = registry.findByUri(resource->host() + resource->uri());
+		if (id < 0)
+			id = registry.findUnbound(resource->getResourceTypes()[0]);
+		if (id < 0) {
+			fprintf(stderr, "no registration left for %s\n", resource->host().c_str());
+			return 1;
+		}
+		registry.bind(id, resource, sensor_kind_from_uri(resource->uri()));
+		registry[id].s_active = true;
+	}
+	us = elapsed_us(start);
+	printf("discover   %6d devices  %10.0f us  %7.3f us/device\n", devices, us, us / devices);
+
+	// as onObserve: the callback carries the id, the kind picks the handler
+	void (*handlers[SENSOR_KIND_MAX])(sensor_data &) = {
+		nullptr, count_observe, count_observe, count_observe, count_observe
+	};
+	start = bench_clock::now();
+	for (int i = 0; i < BENCH_NOTIFICATIONS; i++) {
+		sensor_data &sensor = registry[(unsigned int)i * 7919 % devices];
+		if (handlers[sensor.s_kind])
+			handlers[sensor.s_kind](sensor);
+	}
+	us = elapsed_us(start);
+	printf("dispatch   %6d notifies %9.0f us  %7.3f us/notify\n", BENCH_NOTIFICATIONS, us, us / BENCH_NOTIFICATIONS);
+
+	// a rule picking its target by kind
+	start = bench_clock::now();
+	for (int i = 0; i < BENCH_NOTIFICATIONS; i++)
+		dispatched[0] += registry.firstActive((sensor_kind)(1 + i % 4)) >= 0;
+	us = elapsed_us(start);
+	printf("by kind    %6d lookups  %9.0f us  %7.3f us/lookup\n", BENCH_NOTIFICATIONS, us, us / BENCH_NOTIFICATIONS);
+
+	// every device refreshed once, then all of them expire
+	uint64_t now = 0;
+	int expired = 0;
+	TimerWheel wheel(100, now);
+	start = bench_clock::now();
+	for (int i = 0; i < devices; i++)
+		wheel.schedule(i, BENCH_TIMEOUT);
+	us = elapsed_us(start);
+	printf("refresh    %6d devices  %10.0f us  %7.3f us/device\n", devices, us, us / devices);
+
+	start = bench_clock::now();
+	for (now = 100; now <= BENCH_TIMEOUT + 100; now += 100)
+		wheel.advance(now, [&registry, &expired](int id) {
+			registry[id].s_active = false;
+			expired++;
+		});
+	us = elapsed_us(start);
+	printf("sweep      %6d expired  %10.0f us  %7.3f us/device\n", expired, us, us / devices);
+
+	if (expired != devices) {
+		fprintf(stderr, "%d of %d devices expired\n", expired, devices);
+		return 1;
+	}
+	return 0;
+}
@@ -20,15 +20,73 @@
 
 #include "sensor_resource.h"
 #include "ble_hr_sensor.h"
+#include "gateway_stats.h"
+#include "async_log.h"
 
-SensorResource::SensorResource(RulesResource *rr) : m_sensorName(""), m_sensorAddr(""), m_observation(0)
+static uint64_t monotonic_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string join_list(const std::vector<std::string> &list)
+{
+	std::string joined;
+
+	for (auto &item : list) {
+		if (!joined.empty())
+			joined += ",";
+		joined += item;
+	}
+
+	return joined;
+}
+
+static std::vector<std::string> split_list(const std::string &joined)
+{
+	std::vector<std::string> list;
+	std::istringstream stream(joined);
+	std::string item;
+
+	while (std::getline(stream, item, ',')) {
+		list.push_back(item);
+	}
+
+	return list;
+}
+
+// The resource type an unregistered sensor is rediscovered by; empty, for
+// an unfiltered discovery, when the resource named none.
+static std::string primary_type(const std::vector<std::string> &types)
+{
+	return types.empty() ? std::string() : types.front();
+}
+
+// One pipeline worker per core, at least one.
+static unsigned int observe_workers()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+SensorResource::SensorResource(RulesResource *rr, ConfigResource *cr, RegistryStore *store, SensorHistory *history,
+	AdmissionControl *admission) : m_sensorName(""), m_sensorAddr(""), m_version(0), m_notifiedVersion(0),
+	m_actuator(std::bind(&SensorResource::sendAction, this, PH::_1, PH::_2), ACTUATION_TIMEOUT),
+	m_liveness(LIVENESS_TICK, monotonic_ms()), m_sensorsChanged(false),
+	m_windows(observe_workers()),
+	m_pipeline(observe_workers(), OBSERVE_QUEUE_SIZE,
+		std::bind(&SensorResource::processEvent, this, PH::_1))
 {
 	std::string resourceURI = SENSOR_RESOURCE_ENDPOINT;
 	std::string resourceTypeName = SENSOR_RESOURCE_TYPE;
 	std::string resourceInterface = DEFAULT_INTERFACE;
-	EntityHandler cb = std::bind(&SensorResource::entityHandler, this,PH::_1);
+	EntityHandler cb = admission->wrap(std::bind(&SensorResource::entityHandler, this,PH::_1));
 
 	m_rr = rr;
+	m_cr = cr;
+	m_store = store;
+	m_history = history;
+	m_applyRule = std::bind(&SensorResource::applyRule, this, PH::_1);
+	m_sensorExpired = std::bind(&SensorResource::sensorExpired, this, PH::_1);
 
 	uint8_t resourceProperty = OC_DISCOVERABLE | OC_OBSERVABLE;
 	OCStackResult result = OCPlatform::registerResource(m_resourceHandle,
@@ -44,55 +102,57 @@ SensorResource::SensorResource(RulesResource *rr) : m_sensorName(""), m_sensorAd
 	}
 }
 
-bool SensorResource::status_check(sensor_data &sensor)
+void SensorResource::refreshLiveness(int id)
 {
-	SensorMapIter iter;
-	iter = m_sensorMap.find(sensor.s_name);
-	if ((sensor.s_active == false) && (sensor.s_resource != nullptr)) {
-		std::cout << "Sensor: " << sensor.s_name << " is offline" <<std::endl;
-		if (iter != m_sensorMap.end()) {
-			m_sensorMap.erase(iter);
-			sensor.s_resource = nullptr;
-		}
+	m_liveness.schedule(id, m_cr->m_timeouts[m_sensors[id].s_kind] * 1000);
+}
 
-		return true;
-	}
-	else if ((sensor.s_active == true) && (sensor.s_resource == nullptr)) {
-		//should not have this case, maybe there is a long delay
-		//of notification packet, we need to refind the resource
-		std::string address;
-		if (iter != m_sensorMap.end()) {
-			address = std::string(iter->second);
-			StartMonitor(address);
+// Called by the liveness wheel for a sensor that stayed silent for the
+// timeout of its kind. The wheel also holds the discovery retry of a
+// sensor that is not bound, which comes due here when its backoff is
+// over; the discoveries of one tick are batched, see livenessTick.
+void SensorResource::sensorExpired(int id)
+{
+	sensor_data &sensor = m_sensors[id];
+
+	sensor.s_active = false;
+	if (sensor.s_resource != nullptr) {
+		ALOG_INFO("Sensor: {} is offline", sensor.s_name);
+		sensorOffline(sensor.s_name);
+		m_sensors.unbind(id);
+		m_sensorsChanged = true;
+		if (sensor.s_reobserving) {
+			// the cached endpoint did not answer, look the sensor up
+			rediscover(id, m_retryTypes);
 		}
-		sensor.s_active = false;
 	}
-
-	return false;
+	else {
+		rediscover(id, m_retryTypes);
+	}
 }
 
-void SensorResource::activeCheck()
+void SensorResource::livenessTick()
 {
-	bool sensor_changed = false;
+	std::lock_guard<std::mutex> lock(m_resourceLock);
 
-	sensor_changed = status_check(m_gas) || status_check(m_fan)
-			|| status_check(m_led) || status_check(m_pri);
+	uint64_t now = monotonic_ms();
 
-	if (sensor_changed) {
-		ChangeSensorRepresentation();
+	m_liveness.advance(now, m_sensorExpired);
+	discover(m_retryTypes);
+	m_retryTypes.clear();
+
+	while (!m_multicasts.empty() && now - m_multicasts.front() >= 60000) {
+		m_multicasts.pop_front();
 	}
-}
+	gw_stats.multicasts_per_minute = m_multicasts.size();
 
-void SensorResource::resetStatus()
-{
-	std::cout << "Reset sensor active status" <<std::endl;
-	m_fan.s_active = false;
-	m_gas.s_active = false;
-	m_led.s_active = false;
-	m_pri.s_active = false;
+	if (m_sensorsChanged) {
+		m_sensorsChanged = false;
+		ChangeSensorRepresentation();
+	}
 }
 
-void SensorResource::registerBle(char *url)
+void SensorResource::registerBle(const std::string &name)
 {/*
 	uint8_t ifname[] = "eth0";
 	uint8_t ipAddr[20];
@@ -103,32 +163,41 @@ void SensorResource::registerBle(char *url)
 
 	std::cout << "BLE heart rate address" << address <<std::endl;
 */
-	m_sensorMap.insert(SensorMap::value_type("heartRate", BLE_HR_SENSOR_RESOURCE_TYPE));
+	std::lock_guard<std::mutex> lock(m_resourceLock);
+
+	mapSensor(name, BLE_HR_SENSOR_RESOURCE_TYPE);
 	ChangeSensorRepresentation();
 }
 
-void SensorResource::unregisterBle()
+void SensorResource::unregisterBle(const std::string &name)
 {
-	m_sensorMap.erase("heartRate");
+	std::lock_guard<std::mutex> lock(m_resourceLock);
 
+	unmapSensor(name);
 	ChangeSensorRepresentation();
 }
 
-void SensorResource::executeJumpingRule(int heartRate)
+// Feeds a value observed outside of the gateway's OCResource observers,
+// such as the BLE heart rate sensors, into the rule engine. Rules may name
+// the source or its kind. Returns false when the pipeline is full; the
+// value has not been taken then.
+bool SensorResource::observeValue(const std::string &source, const std::string &kind,
+	const std::string &attribute, int value)
 {
-	std::cout << "Crazy Jumping enable flag: " << m_rr->m_crazyJumping << "current heartRate: " << heartRate << std::endl;
-	if (m_rr->m_crazyJumping && m_led.s_active && m_led.s_resource) {
-		OCRepresentation ledrep;
-		PutCallback p (std::bind(&SensorResource::onPut, this, PH::_1, PH::_2, PH::_3));
-		if (heartRate >= m_rr->m_heartRate){
-			ledrep.setValue("ledColor", RED);
-		} else {
-			ledrep.setValue("ledColor", GREEN);
-
-		}
+	observe_event event;
+	uint32_t attributeId, kindId;
+
+	event.source = m_pipeline.intern(source, event.source_id);
+	event.kind = (kind == source) ? nullptr : m_pipeline.intern(kind, kindId);
+	event.attribute = m_pipeline.intern(attribute, attributeId);
+	event.value = value;
+	return m_pipeline.push(event);
+}
 
-		m_led.s_resource->put(ledrep, QueryParamsMap(), p);
-	}
+void SensorResource::flushActuations()
+{
+	std::lock_guard<std::mutex> lock(m_resourceLock);
+	m_actuator.flush(m_rr->m_dwell);
 }
 
 void SensorResource::onPut(const HeaderOptions& headerOptions, const OCRepresentation& rep, const int eCode)
@@ -138,15 +207,15 @@ void SensorResource::onPut(const HeaderOptions& headerOptions, const OCRepresent
 			if (rep.hasAttribute("fanstate")) {
 				std::string state = rep.getValue<std::string>("fanstate");
 				m_fanState = (state == "on" ? true:false);
-				std::cout << "\tfanstate: " << m_fanState << std::endl;
+				ALOG_DEBUG("\tfanstate: {}", m_fanState);
 			}
 		}
 		else {
-			std::cout << "onPut Response error: " << eCode << std::endl;
+			ALOG_ERROR("onPut Response error: {}", eCode);
 		}
 	}
 	catch(std::exception& e) {
-		std::cout << "Exception: " << e.what() << " in onPut" << std::endl;
+		ALOG_WARN("Exception: {} in onPut", e.what());
 	}
 }
 
@@ -154,93 +223,207 @@ void SensorResource::onGet(const HeaderOptions& headerOptions, const OCRepresent
 {
 	try {
 		if(eCode == OC_STACK_OK) {
-			std::cout << "Resource URI: " << rep.getUri() << std::endl;
+			ALOG_DEBUG("Resource URI: {}", rep.getUri());
 
 			if (rep.hasAttribute("fanstate")) {
 				std::string state = rep.getValue<std::string>("fanstate");
 				m_fanState = (state == "on" ? true:false);
-				std::cout << "\tfanstate: " << m_fanState << std::endl;
+				ALOG_DEBUG("\tfanstate: {}", m_fanState);
 			}
 		}
 		else {
-			std::cout << "onGET Response error: " << eCode << std::endl;
+			ALOG_ERROR("onGET Response error: {}", eCode);
 		}
 	}
 	catch(std::exception& e) {
-		std::cout << "Exception: " << e.what() << " in onGet" << std::endl;
+		ALOG_WARN("Exception: {} in onGet", e.what());
 	}
 }
 
-void SensorResource::executeGasRule(int density)
+int SensorResource::addSensor(const std::string &name, const std::string &type, bool registered)
 {
-	if (m_fan.s_active && m_fan.s_resource) {
-		OCRepresentation fanrep;
-		PutCallback p (std::bind(&SensorResource::onPut, this, PH::_1, PH::_2, PH::_3));
-		if ((density > m_rr->m_density) && (m_fanState == false)) {
-			std::cout << "Turning on the fan..."<<std::endl;
+	int id = m_sensors.add(name, type, registered);
+	sensor_data &sensor = m_sensors[id];
 
-			fanrep.setValue("fanstate", std::string("on"));
-			m_fan.s_resource->put(fanrep, QueryParamsMap(), p);
-		}
-		else if ((density <= m_rr->m_density) && (m_fanState == true)) {
-			std::cout << "Turning off the fan..."<<std::endl;
+	if (sensor.s_source == nullptr)
+		sensor.s_source = m_pipeline.intern(name, sensor.s_sourceId);
 
-			fanrep.setValue("fanstate", std::string("off"));
-			m_fan.s_resource->put(fanrep, QueryParamsMap(), p);
-		}
+	return id;
+}
+
+// Decodes an observation into an event for the rule workers. Events are
+// sharded by source, so one device's observations stay in order.
+void SensorResource::queueEvent(const sensor_data &sensor, const std::string &attribute, int value)
+{
+	observe_event event;
+	const std::string &kindName = sensor_kind_name(sensor.s_kind);
+
+	event.source_id = sensor.s_sourceId;
+	event.source = sensor.s_source;
+	// rules may also name a device by its kind, e.g. "gas"
+	event.kind = (kindName.empty() || kindName == sensor.s_name) ? nullptr : &kindName;
+	event.attribute = &attribute;
+	event.value = value;
+	m_pipeline.push(event);
+}
+
+// Runs on a pipeline worker, without m_resourceLock held. The worker is
+// the only one that sees events of this source, so its windows are
+// updated without locking.
+void SensorResource::processEvent(const observe_event &event)
+{
+	m_history->append(event.source_id, *event.source, event.attribute,
+		SensorHistory::now_ms(), event.value);
+
+	std::vector<std::unique_ptr<stream_windows> > &owned = m_windows[event.source_id % m_windows.size()];
+	size_t index = event.source_id / m_windows.size();
+	if (index >= owned.size())
+		owned.resize(index + 1);
+	if (!owned[index])
+		owned[index].reset(new stream_windows);
+	stream_windows &windows = *owned[index];
+	m_rr->m_engine.aggregate(windows, *event.attribute, event.value, monotonic_ms());
+
+	m_rr->m_engine.evaluate(*event.source, *event.attribute, event.value, windows, m_applyRule);
+
+	if (event.kind) {
+		m_rr->m_engine.evaluate(*event.kind, *event.attribute, event.value, windows, m_applyRule);
 	}
 }
 
-void SensorResource::onObserve(const HeaderOptions headerOptions, const OCRepresentation& rep,
-	const int& eCode, const int& sequenceNumber)
+void SensorResource::applyRule(const rule_action &action)
+{
+	std::lock_guard<std::mutex> lock(m_resourceLock);
+	int target = m_sensors.findByName(action.target);
+	if (target < 0 || !m_sensors[target].s_active || !m_sensors[target].s_resource) {
+		target = m_sensors.firstActive(sensor_kind_from_name(action.target));
+	}
+	if (target < 0) {
+		return;
+	}
+
+	m_actuator.request(target, action, m_rr->m_dwell);
+}
+
+// Called by the actuator with m_resourceLock held. Returns false when the
+// target was unbound since the rule picked it, e.g. by its liveness
+// timeout, so the actuation is dropped instead of sent.
+bool SensorResource::sendAction(int target, const rule_action &action)
+{
+	if (!m_sensors[target].s_resource) {
+		ALOG_INFO("Rule: {} is gone, dropping {}", action.target, action.attribute);
+		return false;
+	}
+
+	OCRepresentation rep;
+	switch (action.type) {
+		case RULE_VALUE_INT:
+			rep.setValue(action.attribute, action.i_value);
+			break;
+		case RULE_VALUE_BOOL:
+			rep.setValue(action.attribute, action.i_value != 0);
+			break;
+		case RULE_VALUE_STRING:
+			rep.setValue(action.attribute, action.s_value);
+			break;
+	}
+
+	ALOG_INFO("Rule: {}.{} changed", action.target, action.attribute);
+	PutCallback p (std::bind(&SensorResource::onActuated, this, target, action.attribute,
+				PH::_1, PH::_2, PH::_3));
+	m_sensors[target].s_resource->put(rep, QueryParamsMap(), p);
+	return true;
+}
+
+void SensorResource::onActuated(int target, const std::string &attribute, const HeaderOptions& headerOptions,
+	const OCRepresentation& rep, const int eCode)
+{
+	std::lock_guard<std::mutex> lock(m_resourceLock);
+	onPut(headerOptions, rep, eCode);
+	m_actuator.acknowledge(target, attribute, eCode == OC_STACK_OK, m_rr->m_dwell);
+}
+
+static const std::string DENSITY_ATTR = "density";
+static const std::string FANSTATE_ATTR = "fanstate";
+static const std::string LEDCOLOR_ATTR = "ledColor";
+static const std::string MOTION_ATTR = "motion";
+
+// Observe handlers indexed by sensor_kind. A kind without a handler only
+// refreshes the liveness of the sensor. Handlers queue the attribute they
+// read for the rule workers.
+const SensorResource::ObserveHandler SensorResource::observe_handlers[SENSOR_KIND_MAX] = {
+	nullptr,			// SENSOR_UNKNOWN
+	&SensorResource::onGasObserve,	// SENSOR_GAS
+	&SensorResource::onFanObserve,	// SENSOR_FAN
+	&SensorResource::onLedObserve,	// SENSOR_LED
+	&SensorResource::onPirObserve,	// SENSOR_PIR
+};
+
+void SensorResource::onGasObserve(sensor_data &sensor, const OCRepresentation& rep)
 {
 	int density = 0;
+
+	if (rep.getValue(DENSITY_ATTR, density)) {
+		queueEvent(sensor, DENSITY_ATTR, density);
+	}
+}
+
+void SensorResource::onFanObserve(sensor_data &sensor, const OCRepresentation& rep)
+{
+	std::string state;
+
+	if (rep.getValue(FANSTATE_ATTR, state)) {
+		m_fanState = (state == "on" ? true:false);
+		queueEvent(sensor, FANSTATE_ATTR, m_fanState);
+	}
+}
+
+void SensorResource::onLedObserve(sensor_data &sensor, const OCRepresentation& rep)
+{
 	int ledColor = 0;
+
+	if (rep.getValue(LEDCOLOR_ATTR, ledColor)) {
+		queueEvent(sensor, LEDCOLOR_ATTR, ledColor);
+	}
+}
+
+void SensorResource::onPirObserve(sensor_data &sensor, const OCRepresentation& rep)
+{
 	bool motion = false;
+
+	if (rep.getValue(MOTION_ATTR, motion)) {
+		queueEvent(sensor, MOTION_ATTR, motion);
+	}
+}
+
+void SensorResource::onObserve(int id, const HeaderOptions headerOptions, const OCRepresentation& rep,
+	const int& eCode, const int& sequenceNumber)
+{
+	std::lock_guard<std::mutex> lock(m_resourceLock);
 	try
 	{
 		if(eCode == OC_STACK_OK) {
-			if (rep.hasAttribute("density")) {
-				m_gas.s_active = true;
-				rep.getValue("density", density);
-				std::cout << "\tdensity: " << density << std::endl;
-
-				if (m_rr->m_kitchenMonitor) {
-					std::cout << "Kitchen Monitor is enabled" << std::endl;
-					executeGasRule(density);
-				}
+			sensor_data &sensor = m_sensors[id];
+			if (sensor.s_resource == nullptr) {
+				// a late notification from a sensor that went offline
+				reattach(id);
 			}
-
-			if (rep.hasAttribute("fanstate")) {
-				m_fan.s_active = true;
-				std::string state = rep.getValue<std::string>("fanstate");
-				m_fanState = (state == "on" ? true:false);
-				std::cout << "\tfanstate: " << m_fanState << std::endl;
-			}
-
-			if (rep.hasAttribute("ledColor")) {
-				m_led.s_active = true;
-				rep.getValue("ledColor", ledColor);
-				std::cout << "\tledColor: " << ledColor << std::endl;
-			}
-			if (rep.hasAttribute("motion")) {
-				m_pri.s_active = true;
-				rep.getValue("motion", motion);
-				std::cout << "\tmotion: " << motion << std::endl;
-				PutCallback p (std::bind(&SensorResource::onPut, this, PH::_1, PH::_2, PH::_3));
-				if ((motion == true) && (m_led.s_active == true)) {
-					OCRepresentation ledrep;
-					ledrep.setValue("ledColor", BLUE);
-					m_led.s_resource->put(ledrep, QueryParamsMap(), p);
-				}
+			sensor.s_reobserving = false;
+			sensor.s_discoveryBackoff = 0;
+			sensor.s_active = true;
+			refreshLiveness(id);
+
+			ObserveHandler handler = observe_handlers[sensor.s_kind];
+			if (handler) {
+				(this->*handler)(sensor, rep);
 			}
 		}
 		else {
-			std::cout << "onObserve Response error: " << eCode << std::endl;
+			ALOG_ERROR("onObserve Response error: {}", eCode);
 		}
 	}
 	catch(std::exception& e) {
-		std::cout << "Exception: " << e.what() << " in onObserve" << std::endl;
+		ALOG_WARN("Exception: {} in onObserve", e.what());
 	}
 }
 
@@ -252,85 +435,339 @@ void SensorResource::foundResource(std::shared_ptr<OCResource> resource)
 	std::lock_guard<std::mutex> lock(m_resourceLock);
 	try {
 		if(resource) {
-			std::cout<<"DISCOVERED Resource:"<<std::endl;
+			ALOG_DEBUG("DISCOVERED Resource:");
 			resourceURI = resource->uri();
-			std::cout << "\tURI of the resource: " << resourceURI << std::endl;
+			ALOG_DEBUG("\tURI of the resource: {}", resourceURI);
 
 			hostAddress = resource->host();
-			std::cout << "\tHost address of the resource: " << hostAddress << std::endl;
+			ALOG_DEBUG("\tHost address of the resource: {}", hostAddress);
 
-			std::cout << "\tList of resource types: " << std::endl;
+			ALOG_DEBUG("\tList of resource types:");
 			for(auto &resourceTypes : resource->getResourceTypes()) {
-				std::cout << "\t\t" << resourceTypes << std::endl;
+				ALOG_DEBUG("\t\t{}", resourceTypes);
 			}
 
-			std::cout << "\tList of resource interfaces: " << std::endl;
+			ALOG_DEBUG("\tList of resource interfaces:");
 			for(auto &resourceInterfaces : resource->getResourceInterfaces()) {
-				std::cout << "\t\t" << resourceInterfaces << std::endl;
+				ALOG_DEBUG("\t\t{}", resourceInterfaces);
 			}
 
-			GetCallback g (std::bind(&SensorResource::onGet, this, PH::_1, PH::_2, PH::_3));
-			ObserveCallback o (std::bind(&SensorResource::onObserve, this, PH::_1, PH::_2, PH::_3, PH::_4));
-			if (resourceURI == "/sensor/gas") {
-				std::cout << "\tFound Gas Sensor." << std::endl;
-				resource->observe(ObserveType::Observe, QueryParamsMap(), o);
+			sensor_kind kind = sensor_kind_from_uri(resourceURI);
+			if (kind == SENSOR_UNKNOWN) {
+				ALOG_DEBUG("Resource unknown.");
+				return;
+			}
 
-				m_gas.s_resource = resource;
-				m_gas.s_active = true;
+			int id = m_sensors.findByUri(hostAddress + resourceURI);
+			if (id >= 0 && m_sensors[id].s_resource != nullptr) {
+				// answered a discovery pass for other sensors
+				ALOG_DEBUG("\tAlready observed as sensor {}", m_sensors[id].s_name);
+				return;
+			}
+			for (auto &resourceTypes : resource->getResourceTypes()) {
+				if (id >= 0)
+					break;
+				id = m_sensors.findUnbound(resourceTypes);
+			}
+			if (id < 0) {
+				// discovered without a registration, keep tracking it
+				// under its own address and rediscover it by its type
+				id = addSensor(hostAddress + resourceURI, primary_type(resource->getResourceTypes()), false);
 			}
-			else if (resourceURI == "/a/fan") {
-				std::cout << "\tFound Fan Device." << std::endl;
-				resource->observe(ObserveType::Observe, QueryParamsMap(), o);
 
-				QueryParamsMap params;
-				resource->get(params, g);
+			ALOG_INFO("\tFound {} as sensor {}", resourceURI, m_sensors[id].s_name);
 
-				m_fan.s_resource = resource;
-				m_fan.s_active = true;
-			}
-			else if (resourceURI == "/intel/chainable_led_edison") {
-				std::cout << "\tFound Edison Led Device." << std::endl;
-				resource->observe(ObserveType::Observe, QueryParamsMap(), o);
+			observeResource(id, resource, kind);
+		}
+		else {
+			ALOG_WARN("Resource is invalid");
+		}
+	}
+	catch(std::exception& e) {
+		//log(e.what());
+	}
+}
 
-				QueryParamsMap params;
-				resource->get(params, g);
+// Called with m_resourceLock held.
+void SensorResource::observeResource(int id, std::shared_ptr<OCResource> resource, sensor_kind kind)
+{
+	GetCallback g (std::bind(&SensorResource::onGet, this, PH::_1, PH::_2, PH::_3));
+	ObserveCallback o (std::bind(&SensorResource::onObserve, this, id, PH::_1, PH::_2, PH::_3, PH::_4));
+	resource->observe(ObserveType::Observe, QueryParamsMap(), o);
 
-				m_led.s_resource = resource;
-				m_led.s_active = true;
-			}
-			else if (resourceURI == "/sensor/pri") {
-				std::cout << "\tFound Pri Device." << std::endl;
-				resource->observe(ObserveType::Observe, QueryParamsMap(), o);
+	if (kind == SENSOR_FAN || kind == SENSOR_LED) {
+		QueryParamsMap params;
+		resource->get(params, g);
+	}
 
-				m_pri.s_resource = resource;
-				m_pri.s_active = true;
+	m_sensors.bind(id, resource, kind);
+	refreshLiveness(id);
+	persistEndpoint(m_sensors[id]);
+	sensorOnline(m_sensors[id].s_name);
+}
+
+// Records where a sensor was resolved, so that a restarted gateway can
+// observe it again without discovery.
+void SensorResource::persistEndpoint(const sensor_data &sensor)
+{
+	std::string &endpoint = m_endpoints[sensor.s_name];
+	std::string host = sensor.s_resource->host();
+	std::string uri = sensor.s_resource->uri();
+
+	if (endpoint == host + uri) {
+		return;
+	}
+
+	endpoint = host + uri;
+	m_store->append(store_record{STORE_ENDPOINT, {sensor.s_name, host, uri,
+		join_list(sensor.s_resource->getResourceTypes()),
+		join_list(sensor.s_resource->getResourceInterfaces())}});
+}
+
+// Reloads the sensors and endpoints persisted by the previous run and
+// observes the known endpoints directly by unicast. Only the sensors that
+// were never resolved go through multicast discovery again.
+void SensorResource::restore()
+{
+	uint64_t start = monotonic_ms();
+	std::map<std::string, store_record> endpoints;
+	std::vector<int> resolved, unresolved;
+	std::set<std::string> types;
+
+	{
+		std::lock_guard<std::mutex> lock(m_resourceLock);
+
+		m_store->load([this, &endpoints](const store_record &record) {
+			if (record.fields.empty())
+				return;
+			if (record.type == STORE_SENSOR && record.fields.size() >= 2) {
+				m_sensorMap[record.fields[0]] = record.fields[1];
 			}
-			else {
-				std::cout << "Resource unknown." << std::endl;
+			else if (record.type == STORE_SENSOR_REMOVED) {
+				m_sensorMap.erase(record.fields[0]);
+				endpoints.erase(record.fields[0]);
 			}
+			else if (record.type == STORE_ENDPOINT && record.fields.size() >= 5) {
+				endpoints[record.fields[0]] = record;
+			}
+		});
+
+		for (auto &entry : m_sensorMap) {
+			int id = addSensor(entry.first, entry.second);
+			if (endpoints.find(entry.first) == endpoints.end())
+				unresolved.push_back(id);
 		}
-		else {
-			std::cout << "Resource is invalid" << std::endl;
+
+		for (auto &entry : endpoints) {
+			const std::vector<std::string> &fields = entry.second.fields;
+			std::vector<std::string> resourceTypes = split_list(fields[3]);
+			// sensors found without a registration are named after their endpoint
+			int id = addSensor(entry.first, primary_type(resourceTypes), false);
+			sensor_data &sensor = m_sensors[id];
+
+			sensor.s_host = fields[1];
+			sensor.s_path = fields[2];
+			sensor.s_resourceTypes = resourceTypes;
+			sensor.s_interfaces = split_list(fields[4]);
+			m_endpoints[entry.first] = fields[1] + fields[2];
+			resolved.push_back(id);
+		}
+
+		for (int id : resolved) {
+			rediscover(id);
 		}
+		for (int id : unresolved) {
+			rediscover(id, types);
+		}
+		discover(types);
+
+		ALOG_INFO("Restored {} sensors, {} observed by unicast in {} ms", m_sensorMap.size(), resolved.size(), (monotonic_ms() - start));
 	}
-	catch(std::exception& e) {
-		//log(e.what());
+}
+
+std::shared_ptr<OCResource> SensorResource::endpointResource(const sensor_data &sensor)
+{
+	try {
+		return OCPlatform::constructResourceObject(sensor.s_host, sensor.s_path, OC_ALL, true,
+			sensor.s_resourceTypes, sensor.s_interfaces);
+	}
+	catch (OC::OCException& e) {
+		ALOG_WARN("Exception: {} rebuilding {}", e.what(), sensor.s_name);
+	}
+
+	return nullptr;
+}
+
+// The notification came through the observation the sensor had before it
+// went offline, which is still in place; only the resource is rebuilt.
+void SensorResource::reattach(int id)
+{
+	sensor_data &sensor = m_sensors[id];
+	std::shared_ptr<OCResource> resource;
+
+	if (!sensor.s_host.empty())
+		resource = endpointResource(sensor);
+	if (resource == nullptr) {
+		rediscover(id);
+		return;
+	}
+
+	m_sensors.bind(id, resource, sensor_kind_from_uri(sensor.s_path));
+	sensorOnline(sensor.s_name);
+}
+
+void SensorResource::rediscover(int id)
+{
+	std::set<std::string> types;
+
+	rediscover(id, types);
+	discover(types);
+}
+
+// Finds the resource of a sensor that is not bound. The endpoint it was
+// last bound to is observed directly first; multicast discovery is the
+// fallback and is backed off exponentially, with jitter, per sensor.
+// Until the sensor is bound, its liveness timer is the retry at the end
+// of the backoff, so the backoff delays discovery but never ends it.
+// The resource types left to discover are added to types, so that a batch
+// of sensors shares one discovery pass. Called with m_resourceLock held.
+void SensorResource::rediscover(int id, std::set<std::string> &types)
+{
+	sensor_data &sensor = m_sensors[id];
+	uint64_t now = monotonic_ms();
+
+	if (!sensor.s_host.empty() && !sensor.s_reobserving) {
+		std::shared_ptr<OCResource> resource = endpointResource(sensor);
+
+		if (resource != nullptr) {
+			ALOG_INFO("Observing {} at {}{}", sensor.s_name, sensor.s_host, sensor.s_path);
+			sensor.s_reobserving = true;
+			gw_stats.unicast_observes++;
+			observeResource(id, resource, sensor_kind_from_uri(sensor.s_path));
+			return;
+		}
+	}
+
+	if (now < sensor.s_nextDiscovery) {
+		m_liveness.schedule(id, sensor.s_nextDiscovery - now);
+		return;
+	}
+
+	sensor.s_discoveryBackoff = sensor.s_discoveryBackoff == 0 ? DISCOVERY_BACKOFF_MIN :
+		std::min(sensor.s_discoveryBackoff * 2, DISCOVERY_BACKOFF_MAX);
+	sensor.s_nextDiscovery = now + sensor.s_discoveryBackoff / 2 + rand() % (sensor.s_discoveryBackoff / 2 + 1);
+	m_liveness.schedule(id, sensor.s_nextDiscovery - now);
+	types.insert(sensor.s_type);
+}
+
+// One multicast discovery for all of types; it is only filtered by
+// resource type when there is a single one.
+void SensorResource::discover(const std::set<std::string> &types)
+{
+	if (types.size() == 1) {
+		StartMonitor(*types.begin());
+	}
+	else if (!types.empty()) {
+		StartMonitor("");
 	}
 }
 
 void SensorResource::StartMonitor(std::string address)
 {
 	std::ostringstream resourceURI;
+
+	m_multicasts.push_back(monotonic_ms());
+	gw_stats.multicast_discoveries++;
 	try {
-		resourceURI << OC_MULTICAST_DISCOVERY_URI << "?rt=" << address;
+		resourceURI << OC_MULTICAST_DISCOVERY_URI;
+		if (!address.empty()) {
+			resourceURI << "?rt=" << address;
+		}
 		FindCallback f (std::bind(&SensorResource::foundResource, this, PH::_1));
 		OCPlatform::findResource("", resourceURI.str(), OC_ALL, f);
 	}
 	catch (OC::OCException& e) {
-		std::cout << "Exception: " << e.what() << " in StartMonitor" << std::endl;
+		ALOG_WARN("Exception: {} in StartMonitor", e.what());
+	}
+}
+
+// Every change of m_sensorMap goes through mapSensor/unmapSensor or
+// sensorOffline/sensorOnline, with m_resourceLock held, so it gets a
+// version and a change log entry. Only registrations and explicit
+// removals are persisted.
+void SensorResource::mapSensor(const std::string &name, const std::string &address)
+{
+	m_offline.erase(name);
+
+	SensorMapIter iter = m_sensorMap.find(name);
+	if (iter != m_sensorMap.end() && iter->second == address) {
+		return;
+	}
+
+	m_sensorMap[name] = address;
+	m_store->append(store_record{STORE_SENSOR, {name, address}});
+	logChange(name, address, false);
+}
+
+void SensorResource::unmapSensor(const std::string &name)
+{
+	bool mapped = m_sensorMap.erase(name) > 0;
+	bool offline = m_offline.erase(name) > 0;
+
+	if (m_endpoints.erase(name) > 0 || mapped || offline) {
+		m_store->append(store_record{STORE_SENSOR_REMOVED, {name}});
+	}
+	if (mapped) {
+		logChange(name, "", true);
 	}
 }
 
+// A sensor that timed out leaves the published map until it is bound
+// again. It stays registered, and its endpoint is kept for reattaching.
+void SensorResource::sensorOffline(const std::string &name)
+{
+	SensorMapIter iter = m_sensorMap.find(name);
+	if (iter == m_sensorMap.end()) {
+		return;
+	}
+
+	m_offline[name] = iter->second;
+	m_sensorMap.erase(iter);
+	logChange(name, "", true);
+}
+
+void SensorResource::sensorOnline(const std::string &name)
+{
+	SensorMapIter iter = m_offline.find(name);
+	if (iter == m_offline.end()) {
+		return;
+	}
+
+	m_sensorMap[name] = iter->second;
+	logChange(name, iter->second, false);
+	m_offline.erase(iter);
+	m_sensorsChanged = true;
+}
+
+void SensorResource::logChange(const std::string &name, const std::string &address, bool removed)
+{
+	m_changes.push_back(sensor_change{++m_version, name, address, removed});
+	if (m_changes.size() > SENSOR_CHANGE_LOG) {
+		m_changes.pop_front();
+	}
+}
+
+// True when the change log still holds every change made after version.
+bool SensorResource::hasChangesSince(int version)
+{
+	if (version < 0 || version > m_version) {
+		return false;
+	}
+
+	return m_changes.empty() ? version == m_version :
+		version >= m_changes.front().c_version - 1;
+}
+
 OCRepresentation SensorResource::get()
 {
 	OCRepresentation get_rep;
@@ -339,81 +776,158 @@ OCRepresentation SensorResource::get()
 	for (iter = m_sensorMap.begin(); iter != m_sensorMap.end(); iter++) {
 		get_rep.setValue(iter->first, std::string(iter->second));
 	}
+	get_rep.setValue("version", m_version);
 
 	return get_rep;
 }
 
-void SensorResource::put(OCRepresentation rep)
+// Builds the delta from version since to the current version.  Entries
+// changed several times are folded to their last state; "added" carries
+// name=address pairs and "removed" the names, both comma separated.
+OCRepresentation SensorResource::getChanges(int since)
 {
-	if (rep.hasAttribute("name")) {
-		m_sensorName = rep.getValue<std::string>("name");
-	}
+	OCRepresentation delta_rep;
+	std::map<std::string, const sensor_change *> latest;
+	std::string added, removed;
 
-	if (rep.hasAttribute("address")) {
-		m_sensorAddr = rep.getValue<std::string>("address");
+	for (auto iter = m_changes.rbegin(); iter != m_changes.rend() && iter->c_version > since; iter++) {
+		latest.insert(std::make_pair(iter->c_name, &*iter));
 	}
 
-	std::cout << "Registered sensor name : " << m_sensorName << " address : " << m_sensorAddr<< std::endl;
-	if ((!m_sensorName.empty()) && (!m_sensorAddr.empty())) {
-		if (m_sensorMap.find(m_sensorName) == m_sensorMap.end()) {
-			m_sensorMap.insert(SensorMap::value_type(m_sensorName, m_sensorAddr));
+	for (auto &entry : latest) {
+		const sensor_change *change = entry.second;
+		std::string &list = change->c_removed ? removed : added;
+
+		if (!list.empty()) {
+			list += ",";
+		}
+		list += change->c_name;
+		if (!change->c_removed) {
+			list += "=" + change->c_address;
 		}
-	}
-	else {
-		return;
 	}
 
-	if (m_sensorName == "gas") {
-		m_gas.s_name = m_sensorName;
-	}
-	else if (m_sensorName == "fan") {
-		m_fan.s_name = m_sensorName;
+	delta_rep.setUri(SENSOR_RESOURCE_ENDPOINT);
+	delta_rep.setValue("delta", true);
+	delta_rep.setValue("since", since);
+	delta_rep.setValue("version", m_version);
+	delta_rep.setValue("added", added);
+	delta_rep.setValue("removed", removed);
+
+	return delta_rep;
+}
+
+// GET /gw/sensor?since=<version> returns the changes after that version,
+// or the full snapshot once the change log no longer reaches back to it.
+OCRepresentation SensorResource::get(const QueryParamsMap &query)
+{
+	auto since = query.find("since");
+
+	if (since != query.end()) {
+		int version = atoi(since->second.c_str());
+
+		if (hasChangesSince(version)) {
+			return getChanges(version);
+		}
 	}
-	else if (m_sensorName == "led") {
-		m_led.s_name = m_sensorName;
+
+	return get();
+}
+
+// A PUT registers either one sensor with "name" and "address", or a batch
+// with "sensors" holding comma separated name=address pairs.
+void SensorResource::put(OCRepresentation rep)
+{
+	SensorMap registrations;
+	std::set<std::string> types;
+
+	if (rep.hasAttribute("sensors")) {
+		std::string entry;
+		std::istringstream sensors(rep.getValue<std::string>("sensors"));
+
+		while (std::getline(sensors, entry, ',')) {
+			size_t pos = entry.find('=');
+			if (pos != std::string::npos && pos > 0 && pos + 1 < entry.size()) {
+				registrations[entry.substr(0, pos)] = entry.substr(pos + 1);
+			}
+		}
 	}
-	else if (m_sensorName == "pri") {
-		m_pri.s_name = m_sensorName;
+	else {
+		if (rep.hasAttribute("name")) {
+			m_sensorName = rep.getValue<std::string>("name");
+		}
+
+		if (rep.hasAttribute("address")) {
+			m_sensorAddr = rep.getValue<std::string>("address");
+		}
+
+		if (m_sensorName.empty() || m_sensorAddr.empty()) {
+			return;
+		}
+		registrations[m_sensorName] = m_sensorAddr;
 	}
 
-	StartMonitor(m_sensorAddr);
+	std::lock_guard<std::mutex> lock(m_resourceLock);
+	for (auto &registration : registrations) {
+		ALOG_INFO("Registered sensor name : {} address : {}", registration.first, registration.second);
+		if (m_sensorMap.find(registration.first) == m_sensorMap.end()) {
+			mapSensor(registration.first, registration.second);
+		}
+		// a sensor restored from the registry store is already observed
+		int id = addSensor(registration.first, registration.second);
+		if (m_sensors[id].s_resource == nullptr) {
+			rediscover(id, types);
+		}
+	}
+	discover(types);
 }
 
 // ChangeSensorRepresentaion is an observation function,
 // which notifies any changes to the sensors to stack
-// via notifyObservers
+// via notifyObservers. Observers registered with mode=delta
+// only receive the entries changed since the last notification.
+// Called with m_resourceLock held.
 void SensorResource::ChangeSensorRepresentation()
 {
-	if (m_observation) {
-		std::cout << "Notifying observers with resource handle: " << m_resourceHandle << endl;
-
-		OCStackResult result = OC_STACK_OK;
+	if (m_notifiedVersion == m_version) {
+		return;
+	}
 
-		std::shared_ptr<OCResourceResponse> resourceResponse(new OCResourceResponse());
+	if (!m_interestedObservers.empty()) {
+		ALOG_DEBUG("Notifying observers with resource handle: {}", m_resourceHandle);
 
-		resourceResponse->setErrorCode(200);
-		resourceResponse->setResourceRepresentation(get(), DEFAULT_INTERFACE);
+		if (OC_STACK_NO_OBSERVERS == m_notifyFull.notify(m_resourceHandle,
+					m_interestedObservers.ids(), m_version,
+					[this]() { return get(); }, GATEWAY_QOS)) {
+			ALOG_INFO("No More observers, stopping notifications");
+			m_interestedObservers.clear();
+		}
+	}
 
-		result = OCPlatform::notifyListOfObservers(m_resourceHandle,
-					m_interestedObservers,
-					resourceResponse);
+	if (!m_deltaObservers.empty()) {
+		ALOG_DEBUG("Notifying delta observers from version {}", m_notifiedVersion);
 
-		if (OC_STACK_NO_OBSERVERS == result) {
-			std::cout << "No More observers, stopping notifications" << endl;
-			m_observation = 0;
+		if (OC_STACK_NO_OBSERVERS == m_notifyDelta.notify(m_resourceHandle,
+					m_deltaObservers.ids(), m_version,
+					[this]() { return hasChangesSince(m_notifiedVersion) ?
+						getChanges(m_notifiedVersion) : get(); },
+					GATEWAY_QOS)) {
+			ALOG_INFO("No More delta observers, stopping notifications");
+			m_deltaObservers.clear();
 		}
 	}
+
+	m_notifiedVersion = m_version;
 }
 
 OCEntityHandlerResult SensorResource::entityHandler(std::shared_ptr<OCResourceRequest> request)
 {
-	std::cout << "EH of sensor resource invoked " << std::endl;
+	ALOG_DEBUG("EH of sensor resource invoked");
 	OCEntityHandlerResult ehResult = OC_EH_ERROR;
 
 	if(request) {
 		int requestFlag = request->getRequestHandlerFlag();
-		std::cout << "In entity handler for sensors, URI is : "
-			<< request->getResourceUri() << std::endl;
+		ALOG_DEBUG("In entity handler for sensors, URI is : {}", request->getResourceUri());
 
 		if(requestFlag & RequestHandlerFlag::RequestFlag) {
 			auto pResponse = std::make_shared<OC::OCResourceResponse>();
@@ -422,29 +936,28 @@ OCEntityHandlerResult SensorResource::entityHandler(std::shared_ptr<OCResourceRe
 
 			if(request->getRequestType() == "GET") {
 				// Return all registered sensors
-				std::cout<< " Sensors Get Request"<<std::endl;
+				ALOG_DEBUG(" Sensors Get Request");
+				std::lock_guard<std::mutex> lock(m_resourceLock);
 				pResponse->setErrorCode(200);
-				pResponse->setResourceRepresentation(get(), "");
+				pResponse->setResourceRepresentation(get(request->getQueryParameters()), "");
 				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
 					ehResult = OC_EH_OK;
 				}
 			}
 			else if(request->getRequestType() == "PUT") {
 				// Register new sensor address
-				std::cout << " Sensors Put Request"<<std::endl;
+				ALOG_DEBUG(" Sensors Put Request");
 				put(request->getResourceRepresentation());
+				std::lock_guard<std::mutex> lock(m_resourceLock);
 				pResponse->setErrorCode(200);
 				pResponse->setResourceRepresentation(get(),"");
 				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
 					ehResult = OC_EH_OK;
-					if (!m_sensorMap.empty()) {
-						ChangeSensorRepresentation();
-					}
+					ChangeSensorRepresentation();
 				}
 			}
 			else {
-				std::cout <<" Sensors unsupported request type "
-				<< request->getRequestType() << std::endl;
+				ALOG_WARN(" Sensors unsupported request type {}", request->getRequestType());
 				pResponse->setResponseResult(OC_EH_ERROR);
 				OCPlatform::sendResponse(pResponse);
 				ehResult = OC_EH_ERROR;
@@ -454,16 +967,26 @@ OCEntityHandlerResult SensorResource::entityHandler(std::shared_ptr<OCResourceRe
 		if (requestFlag & RequestHandlerFlag::ObserverFlag) {
 			ObservationInfo observationInfo = request->getObservationInfo();
 			if (ObserveAction::ObserveRegister == observationInfo.action) {
-				cout << "Starting observer for registered sensors" << endl;
-				m_interestedObservers.push_back(observationInfo.obsId);
-				m_observation = 1;
+				QueryParamsMap query = request->getQueryParameters();
+				auto mode = query.find("mode");
+				std::lock_guard<std::mutex> lock(m_resourceLock);
+
+				// an observer registering again may switch modes
+				if (mode != query.end() && mode->second == "delta") {
+					ALOG_INFO("Starting delta observer for registered sensors");
+					m_interestedObservers.remove(observationInfo.obsId);
+					m_deltaObservers.add(observationInfo.obsId);
+				}
+				else {
+					ALOG_INFO("Starting observer for registered sensors");
+					m_deltaObservers.remove(observationInfo.obsId);
+					m_interestedObservers.add(observationInfo.obsId);
+				}
 			}
 			else if (ObserveAction::ObserveUnregister == observationInfo.action) {
-				m_interestedObservers.erase(std::remove(
-								m_interestedObservers.begin(),
-								m_interestedObservers.end(),
-								observationInfo.obsId),
-								m_interestedObservers.end());
+				std::lock_guard<std::mutex> lock(m_resourceLock);
+				m_interestedObservers.remove(observationInfo.obsId);
+				m_deltaObservers.remove(observationInfo.obsId);
 			}
 
 			ehResult = OC_EH_OK;
@@ -20,41 +20,117 @@
 
 #ifndef SENSOR_RESOURCE_H_
 #define SENSOR_RESOURCE_H_
+#include <deque>
+#include <set>
 #include "resource.h"
 #include "rules_resource.h"
+#include "config_resource.h"
 #include "homegateway.h"
+#include "sensor_registry.h"
+#include "actuator.h"
+#include "timer_wheel.h"
+#include "observe_pipeline.h"
+#include "registry_store.h"
+#include "admission.h"
+#include "sensor_history.h"
+#include "observer_set.h"
+#include "notify_mux.h"
 
 class SensorResource : public Resource
 {
 	public:
 	SensorMap m_sensorMap;
+	// host + uri of the endpoint last persisted for each sensor name
+	SensorMap m_endpoints;
+	// registrations of the sensors that timed out, until they are back
+	SensorMap m_offline;
 	std::string m_sensorName, m_sensorAddr;
-	sensor_data m_gas, m_fan, m_led, m_pri;
+	SensorRegistry m_sensors;
 	RulesResource *m_rr;
+	ConfigResource *m_cr;
+	RegistryStore *m_store;
+	SensorHistory *m_history;
 	bool m_fanState;
 	std::mutex m_resourceLock;
-	int m_observation;
-	ObservationIds m_interestedObservers;
-	SensorResource(RulesResource *rr);
-	bool status_check(sensor_data &sensor);
-	void activeCheck();
-	void resetStatus();
-	void registerBle(char *url);
-	void unregisterBle();
-	void executeJumpingRule(int heartRate);
+	ObserverSet m_interestedObservers;
+	ObserverSet m_deltaObservers;
+	// the full list and the changes, each encoded once per m_version
+	NotifyMux m_notifyFull;
+	NotifyMux m_notifyDelta;
+	int m_version;
+	int m_notifiedVersion;
+	std::deque<sensor_change> m_changes;
+	RuleActionCallback m_applyRule;
+	Actuator m_actuator;
+	TimerWheel m_liveness;
+	std::function<void(int id)> m_sensorExpired;
+	// resource types of the discovery retries that came due this tick
+	std::set<std::string> m_retryTypes;
+	bool m_sensorsChanged;
+	// start times of the multicast discoveries of the last minute
+	std::deque<uint64_t> m_multicasts;
+	// rule aggregates of each observed source. Source id n belongs to
+	// pipeline worker n % workers, which alone grows and uses
+	// m_windows[n % workers][n / workers].
+	std::vector<std::vector<std::unique_ptr<stream_windows> > > m_windows;
+	// declared last so the workers stop before the state they use goes away
+	ObservePipeline m_pipeline;
+	SensorResource(RulesResource *rr, ConfigResource *cr, RegistryStore *store, SensorHistory *history,
+		AdmissionControl *admission);
+	void restore();
+	void livenessTick();
+	void registerBle(const std::string &name);
+	void unregisterBle(const std::string &name);
+	bool observeValue(const std::string &source, const std::string &kind,
+		const std::string &attribute, int value);
+	void flushActuations();
 	private:
+	void refreshLiveness(int id);
+	void sensorExpired(int id);
 	void onPut(const HeaderOptions& headerOptions, const OCRepresentation& rep, const int eCode);
 	void onGet(const HeaderOptions& headerOptions, const OCRepresentation& rep, const int eCode);
-	void executeGasRule(int density);
-	void onObserve(const HeaderOptions headerOptions, const OCRepresentation& rep,
+	int addSensor(const std::string &name, const std::string &type, bool registered = true);
+	void queueEvent(const sensor_data &sensor, const std::string &attribute, int value);
+	void processEvent(const observe_event &event);
+	void applyRule(const rule_action &action);
+	bool sendAction(int target, const rule_action &action);
+	void onActuated(int target, const std::string &attribute, const HeaderOptions& headerOptions,
+		const OCRepresentation& rep, const int eCode);
+	void onObserve(int id, const HeaderOptions headerOptions, const OCRepresentation& rep,
 		const int& eCode, const int& sequenceNumber);
+	void onGasObserve(sensor_data &sensor, const OCRepresentation& rep);
+	void onFanObserve(sensor_data &sensor, const OCRepresentation& rep);
+	void onLedObserve(sensor_data &sensor, const OCRepresentation& rep);
+	void onPirObserve(sensor_data &sensor, const OCRepresentation& rep);
+	typedef void (SensorResource::*ObserveHandler)(sensor_data &sensor, const OCRepresentation& rep);
+	static const ObserveHandler observe_handlers[SENSOR_KIND_MAX];
 	void foundResource(std::shared_ptr<OCResource> resource);
+	void observeResource(int id, std::shared_ptr<OCResource> resource, sensor_kind kind);
+	std::shared_ptr<OCResource> endpointResource(const sensor_data &sensor);
+	void reattach(int id);
+	void rediscover(int id);
+	void rediscover(int id, std::set<std::string> &types);
+	void discover(const std::set<std::string> &types);
+	void persistEndpoint(const sensor_data &sensor);
 	void StartMonitor(std::string address);
+	void mapSensor(const std::string &name, const std::string &address);
+	void unmapSensor(const std::string &name);
+	void sensorOffline(const std::string &name);
+	void sensorOnline(const std::string &name);
+	void logChange(const std::string &name, const std::string &address, bool removed);
+	bool hasChangesSince(int version);
 	OCRepresentation get();
+	OCRepresentation getChanges(int since);
+	OCRepresentation get(const QueryParamsMap &query);
 	void put(OCRepresentation rep);
 	void ChangeSensorRepresentation();
 	protected:
 	virtual OCEntityHandlerResult entityHandler(std::shared_ptr<OCResourceRequest> request);
+	// drive onObserve, the change log and restore directly, see
+	// observe_bench.cpp, sensor_delta_bench.cpp and restore_bench.cpp
+	friend struct observe_bench;
+	friend struct delta_bench;
+	friend struct restore_bench;
 };
 
 #endif /* SENSOR_RESOURCE_H_ */
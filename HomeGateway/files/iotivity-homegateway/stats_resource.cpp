@@ -0,0 +1,98 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "stats_resource.h"
+#include "homegateway.h"
+#include "async_log.h"
+
+gateway_stats gw_stats;
+
+StatsResource::StatsResource()
+{
+	std::string resourceURI = STATS_RESOURCE_ENDPOINT;
+	std::string resourceTypeName = STATS_RESOURCE_TYPE;
+	std::string resourceInterface = DEFAULT_INTERFACE;
+	EntityHandler cb = std::bind(&StatsResource::entityHandler, this,PH::_1);
+	uint8_t resourceProperty = OC_DISCOVERABLE;
+	OCStackResult result = OCPlatform::registerResource(m_resourceHandle,
+	resourceURI,
+	resourceTypeName,
+	resourceInterface,
+	cb,
+	resourceProperty);
+
+	if(OC_STACK_OK != result) {
+		throw std::runtime_error(
+		std::string("Stats Resource failed to start")+std::to_string(result));
+	}
+}
+
+OCRepresentation StatsResource::get()
+{
+	m_rep.setUri(STATS_RESOURCE_ENDPOINT);
+	m_rep.setValue("putsSent", gw_stats.puts_sent.load());
+	m_rep.setValue("putsSaved", gw_stats.puts_saved.load());
+	m_rep.setValue("putsDropped", gw_stats.puts_dropped.load());
+	m_rep.setValue("putsTimedOut", gw_stats.puts_timed_out.load());
+	m_rep.setValue("eventsProcessed", gw_stats.events_processed.load());
+	m_rep.setValue("eventsDropped", gw_stats.events_dropped.load());
+	m_rep.setValue("multicastDiscoveries", gw_stats.multicast_discoveries.load());
+	m_rep.setValue("multicastsPerMinute", gw_stats.multicasts_per_minute.load());
+	m_rep.setValue("unicastObserves", gw_stats.unicast_observes.load());
+	m_rep.setValue("requestsQueued", gw_stats.requests_queued.load());
+	m_rep.setValue("requestsRejected", gw_stats.requests_rejected.load());
+	m_rep.setValue("requestsLimited", gw_stats.requests_limited.load());
+	m_rep.setValue("requestP99Us", gw_stats.request_p99_us.load());
+	m_rep.setValue("bleSamples", gw_stats.ble_samples.load());
+	m_rep.setValue("bleSpilled", gw_stats.ble_spilled.load());
+	m_rep.setValue("bleNotifies", gw_stats.ble_notifies.load());
+	return m_rep;
+}
+
+OCEntityHandlerResult StatsResource::entityHandler(std::shared_ptr<OCResourceRequest> request)
+{
+	OCEntityHandlerResult ehResult = OC_EH_ERROR;
+	if(request) {
+		if(request->getRequestHandlerFlag() == RequestHandlerFlag::RequestFlag) {
+			auto pResponse = std::make_shared<OC::OCResourceResponse>();
+			pResponse->setRequestHandle(request->getRequestHandle());
+			pResponse->setResourceHandle(request->getResourceHandle());
+
+			if(request->getRequestType() == "GET") {
+				pResponse->setErrorCode(200);
+				pResponse->setResourceRepresentation(get(), "");
+				if(OC_STACK_OK == OCPlatform::sendResponse(pResponse)) {
+					ehResult = OC_EH_OK;
+				}
+			}
+			else {
+				ALOG_WARN("Stats unsupported request type {}", request->getRequestType());
+				pResponse->setResponseResult(OC_EH_ERROR);
+				OCPlatform::sendResponse(pResponse);
+				ehResult = OC_EH_ERROR;
+			}
+		}
+		else {
+			ALOG_WARN("Stats unsupported request flag");
+		}
+	}
+
+	return ehResult;
+}
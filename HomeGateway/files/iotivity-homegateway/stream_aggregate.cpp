@@ -0,0 +1,249 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "stream_aggregate.h"
+
+#define MAX_WINDOW_MS (24 * 3600 * 1000)
+
+bool aggregate_spec::operator<(const aggregate_spec &other) const
+{
+	if (func != other.func)
+		return func < other.func;
+	if (percentile != other.percentile)
+		return percentile < other.percentile;
+	if (tumbling != other.tumbling)
+		return tumbling < other.tumbling;
+	return window_ms < other.window_ms;
+}
+
+bool parse_aggregate(const std::string &func, const std::string &window,
+		const std::string &mode, aggregate_spec &spec)
+{
+	static const struct
+	{
+		const char *name;
+		aggregate_func func;
+	} funcs[] = {
+		{ "min", AGGREGATE_MIN }, { "max", AGGREGATE_MAX },
+		{ "mean", AGGREGATE_MEAN }, { "ewma", AGGREGATE_EWMA },
+	};
+	static const struct
+	{
+		const char *suffix;
+		long ms;
+	} units[] = {
+		{ "ms", 1 }, { "s", 1000 }, { "m", 60 * 1000 }, { "h", 3600 * 1000 },
+	};
+	char *end = NULL;
+
+	spec.percentile = 0;
+	spec.func = AGGREGATE_PERCENTILE;
+	for (auto &entry : funcs) {
+		if (func == entry.name)
+			spec.func = entry.func;
+	}
+	if (spec.func == AGGREGATE_PERCENTILE) {
+		if (func.size() < 2 || func[0] != 'p')
+			return false;
+		long percentile = strtol(func.c_str() + 1, &end, 10);
+		if (*end != '\0' || percentile < 1 || percentile > 99)
+			return false;
+		spec.percentile = percentile;
+	}
+
+	long length = strtol(window.c_str(), &end, 10);
+	if (end == window.c_str() || length <= 0)
+		return false;
+	spec.window_ms = 0;
+	for (auto &unit : units) {
+		if (strcmp(end, unit.suffix) == 0 && length <= MAX_WINDOW_MS / unit.ms)
+			spec.window_ms = length * unit.ms;
+	}
+	if (spec.window_ms == 0)
+		return false;
+
+	spec.tumbling = (mode == "tumbling");
+	if (!mode.empty() && !spec.tumbling)
+		return false;
+	// an average without a window has nothing to tumble
+	return !(spec.tumbling && spec.func == AGGREGATE_EWMA);
+}
+
+static inline int bucket_of(int32_t value)
+{
+	if (value < 64)
+		return value < 0 ? 0 : value;
+	int exponent = 31 - __builtin_clz(value);
+	return 64 + (exponent - 6) * 16 + ((value >> (exponent - 4)) & 15);
+}
+
+// middle of the values that fall into 'bucket'
+static inline int32_t bucket_value(int bucket)
+{
+	if (bucket < 64)
+		return bucket;
+	int shift = (bucket - 64) / 16 + 2;
+	return ((16 + (bucket - 64) % 16) << shift) + ((1 << shift) - 1) / 2;
+}
+
+WindowAggregate::WindowAggregate(const aggregate_spec &spec) : m_spec(spec),
+	m_panes(spec.tumbling ? 1 : AGGREGATE_PANES), m_current(-1), m_sum(0), m_count(0),
+	m_ewma(0), m_lastTime(0)
+{
+	m_paneMs = spec.window_ms / m_panes;
+	if (m_paneMs < 1)
+		m_paneMs = 1;
+
+	if (spec.func == AGGREGATE_PERCENTILE) {
+		size_t size = (m_panes + 1) * AGGREGATE_BUCKETS;
+		m_histogram.reset(new uint32_t[size]);
+		memset(m_histogram.get(), 0, size * sizeof(uint32_t));
+	}
+
+	memset(m_pane, 0, sizeof(m_pane));
+	for (int i = 0; i < m_panes; i++)
+		clear(i);
+}
+
+void WindowAggregate::clear(int index)
+{
+	pane &p = m_pane[index];
+
+	m_sum -= p.sum;
+	m_count -= p.count;
+	if (m_histogram && p.count) {
+		uint32_t *counts = &m_histogram[index * AGGREGATE_BUCKETS];
+		uint32_t *total = &m_histogram[m_panes * AGGREGATE_BUCKETS];
+		for (int i = 0; i < AGGREGATE_BUCKETS; i++)
+			total[i] -= counts[i];
+		memset(counts, 0, AGGREGATE_BUCKETS * sizeof(uint32_t));
+	}
+
+	p.min = INT_MAX;
+	p.max = INT_MIN;
+	p.sum = 0;
+	p.count = 0;
+}
+
+// Moves the window to pane 'number', dropping the panes it passes.
+void WindowAggregate::advance(int64_t number)
+{
+	if (m_current < 0) {
+		m_current = number;
+		return;
+	}
+	if (number <= m_current)
+		return;
+
+	int64_t steps = number - m_current;
+	if (steps > m_panes)
+		steps = m_panes;
+	for (int64_t i = 1; i <= steps; i++)
+		clear((m_current + i) % m_panes);
+	m_current = number;
+}
+
+int32_t WindowAggregate::value() const
+{
+	int32_t result;
+
+	switch (m_spec.func) {
+		case AGGREGATE_MIN:
+			result = INT_MAX;
+			for (int i = 0; i < m_panes; i++) {
+				if (m_pane[i].count && m_pane[i].min < result)
+					result = m_pane[i].min;
+			}
+			return result;
+		case AGGREGATE_MAX:
+			result = INT_MIN;
+			for (int i = 0; i < m_panes; i++) {
+				if (m_pane[i].count && m_pane[i].max > result)
+					result = m_pane[i].max;
+			}
+			return result;
+		case AGGREGATE_MEAN:
+			return (int32_t)llround((double)m_sum / m_count);
+		default:
+			break;
+	}
+
+	// smallest bucket holding at least 'percentile' percent of the samples
+	const uint32_t *total = &m_histogram[m_panes * AGGREGATE_BUCKETS];
+	uint64_t rank = ((uint64_t)m_count * m_spec.percentile + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < AGGREGATE_BUCKETS; i++) {
+		seen += total[i];
+		if (seen >= rank)
+			return bucket_value(i);
+	}
+	return bucket_value(AGGREGATE_BUCKETS - 1);
+}
+
+bool WindowAggregate::add(int64_t now_ms, int32_t value, int32_t &result)
+{
+	if (m_spec.func == AGGREGATE_EWMA) {
+		int64_t elapsed = now_ms - m_lastTime;
+		if (m_count == 0)
+			m_ewma = value;
+		else if (elapsed > 0)
+			m_ewma += (1.0 - exp(-(double)elapsed / m_spec.window_ms)) * (value - m_ewma);
+		m_count = 1;
+		m_lastTime = now_ms;
+		result = (int32_t)lround(m_ewma);
+		return true;
+	}
+
+	int64_t number = now_ms / m_paneMs;
+	bool ready = false;
+
+	// a tumbling window reports once the period it covers is over
+	if (m_spec.tumbling && m_count && number > m_current) {
+		result = this->value();
+		ready = true;
+	}
+
+	advance(number);
+	int index = m_current % m_panes;
+	pane &p = m_pane[index];
+	if (value < p.min)
+		p.min = value;
+	if (value > p.max)
+		p.max = value;
+	p.sum += value;
+	p.count++;
+	m_sum += value;
+	m_count++;
+	if (m_histogram) {
+		int bucket = bucket_of(value);
+		m_histogram[index * AGGREGATE_BUCKETS + bucket]++;
+		m_histogram[m_panes * AGGREGATE_BUCKETS + bucket]++;
+	}
+
+	if (!m_spec.tumbling) {
+		result = this->value();
+		ready = true;
+	}
+	return ready;
+}
@@ -0,0 +1,108 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef STREAM_AGGREGATE_H_
+#define STREAM_AGGREGATE_H_
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+
+#define AGGREGATE_PANES 8
+#define AGGREGATE_BUCKETS 464
+
+enum aggregate_func
+{
+	AGGREGATE_MIN = 0,
+	AGGREGATE_MAX,
+	AGGREGATE_MEAN,
+	AGGREGATE_EWMA,
+	AGGREGATE_PERCENTILE
+};
+
+// What a rule asks for, e.g. "p90(gas.density, 10s)": the function, the
+// percentile for AGGREGATE_PERCENTILE and the window length. For
+// AGGREGATE_EWMA the window is the time constant of the average.
+struct aggregate_spec
+{
+	uint8_t func;
+	uint8_t percentile;
+	bool tumbling;
+	uint32_t window_ms;
+
+	bool operator==(const aggregate_spec &other) const
+	{
+		return func == other.func && percentile == other.percentile
+			&& tumbling == other.tumbling && window_ms == other.window_ms;
+	}
+	bool operator<(const aggregate_spec &other) const;
+};
+
+// Parses "<func>(" ... ")" arguments: 'func' is min, max, mean, ewma or
+// p<1-99>, 'window' a number with a ms, s, m or h suffix and 'mode'
+// empty or "tumbling".
+bool parse_aggregate(const std::string &func, const std::string &window,
+		const std::string &mode, aggregate_spec &spec);
+
+// Incremental aggregate of one device attribute. A sliding window is
+// split into AGGREGATE_PANES panes and covers the samples of the last
+// window_ms, give or take one pane; the oldest pane is dropped as time
+// moves on. A tumbling window produces one value for each window_ms long
+// period, on the first sample after the period ended. Adding a sample is
+// O(1): at most AGGREGATE_PANES panes expire, and reading the value
+// combines the panes or, for percentiles, walks a fixed log-linear
+// histogram (linear below 64, 16 buckets per octave above, so within
+// about 3% of the true value). Values below 0 count as 0 there.
+class WindowAggregate
+{
+	public:
+	WindowAggregate(const aggregate_spec &spec);
+
+	// Adds the sample 'value' observed at 'now_ms' and returns true with
+	// the aggregate in 'result' when there is one to act on.
+	bool add(int64_t now_ms, int32_t value, int32_t &result);
+
+	const aggregate_spec m_spec;
+
+	private:
+	struct pane
+	{
+		int32_t min, max;
+		int64_t sum;
+		uint32_t count;
+	};
+
+	void advance(int64_t number);
+	void clear(int index);
+	int32_t value() const;
+
+	int m_panes;
+	int64_t m_paneMs;
+	int64_t m_current;
+	pane m_pane[AGGREGATE_PANES];
+	int64_t m_sum;
+	uint32_t m_count;
+	// per pane and total bucket counts, only for percentiles
+	std::unique_ptr<uint32_t[]> m_histogram;
+	double m_ewma;
+	int64_t m_lastTime;
+};
+
+#endif /* STREAM_AGGREGATE_H_ */
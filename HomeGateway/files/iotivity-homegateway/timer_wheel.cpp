@@ -0,0 +1,132 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_RANGE (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+TimerWheel::TimerWheel(unsigned int tick_ms, uint64_t now_ms) : m_tick(tick_ms), m_now(now_ms / tick_ms)
+{
+	for (auto &slot : m_slots)
+		slot = -1;
+}
+
+void TimerWheel::link(int id)
+{
+	timer_node &node = m_nodes[id];
+	uint64_t delta = node.expires - m_now;
+	int level = 0;
+
+	while (level < TIMER_WHEEL_LEVELS - 1
+		&& delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+		level++;
+
+	node.slot = level * TIMER_WHEEL_SLOTS
+		+ ((node.expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+	node.prev = -1;
+	node.next = m_slots[node.slot];
+	if (node.next != -1)
+		m_nodes[node.next].prev = id;
+	m_slots[node.slot] = id;
+}
+
+void TimerWheel::unlink(int id)
+{
+	timer_node &node = m_nodes[id];
+
+	if (node.prev != -1)
+		m_nodes[node.prev].next = node.next;
+	else
+		m_slots[node.slot] = node.next;
+	if (node.next != -1)
+		m_nodes[node.next].prev = node.prev;
+
+	node.slot = -1;
+}
+
+void TimerWheel::schedule(int id, unsigned int timeout_ms)
+{
+	if ((size_t)id >= m_nodes.size()) {
+		timer_node node;
+		node.prev = node.next = node.slot = -1;
+		node.expires = 0;
+		m_nodes.resize(id + 1, node);
+	}
+
+	if (m_nodes[id].slot != -1)
+		unlink(id);
+
+	uint64_t ticks = (timeout_ms + m_tick - 1) / m_tick;
+	if (ticks < 1)
+		ticks = 1;
+	if (ticks >= TIMER_WHEEL_RANGE)
+		ticks = TIMER_WHEEL_RANGE - 1;
+
+	m_nodes[id].expires = m_now + ticks;
+	link(id);
+}
+
+void TimerWheel::cancel(int id)
+{
+	if (armed(id))
+		unlink(id);
+}
+
+bool TimerWheel::armed(int id) const
+{
+	return (size_t)id < m_nodes.size() && m_nodes[id].slot != -1;
+}
+
+void TimerWheel::cascade(int level)
+{
+	int slot = level * TIMER_WHEEL_SLOTS
+		+ ((m_now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+	int id = m_slots[slot];
+
+	m_slots[slot] = -1;
+	while (id != -1) {
+		int next = m_nodes[id].next;
+		link(id);
+		id = next;
+	}
+}
+
+void TimerWheel::advance(uint64_t now_ms, const std::function<void(int id)> &expire)
+{
+	uint64_t target = now_ms / m_tick;
+
+	while (m_now < target) {
+		m_now++;
+
+		for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+			if ((m_now >> (TIMER_WHEEL_BITS * (level - 1))) & TIMER_WHEEL_MASK)
+				break;
+			cascade(level);
+		}
+
+		int slot = m_now & TIMER_WHEEL_MASK;
+		int id;
+		while ((id = m_slots[slot]) != -1) {
+			unlink(id);
+			expire(id);
+		}
+	}
+}
@@ -0,0 +1,71 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <functional>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// Hierarchical timer wheel holding one timer per id. Arming, re-arming
+// and cancelling a timer are O(1); advancing only touches the timers in
+// the slots that come due, plus an occasional cascade from the coarser
+// levels. Timers are kept in index-linked lists so ids can be the
+// indexes of entries in a growing vector.
+class TimerWheel
+{
+	public:
+	TimerWheel(unsigned int tick_ms, uint64_t now_ms);
+
+	// (Re)arms the timer of 'id' to fire 'timeout_ms' after the current
+	// time of the wheel.
+	void schedule(int id, unsigned int timeout_ms);
+	void cancel(int id);
+	bool armed(int id) const;
+
+	// Moves the wheel forward to 'now_ms' and calls 'expire' for every
+	// timer that came due. 'expire' may schedule or cancel timers.
+	void advance(uint64_t now_ms, const std::function<void(int id)> &expire);
+
+	private:
+	struct timer_node
+	{
+		int prev, next;
+		int slot;
+		uint64_t expires;
+	};
+
+	void link(int id);
+	void unlink(int id);
+	void cascade(int level);
+
+	unsigned int m_tick;
+	uint64_t m_now;
+	std::vector<timer_node> m_nodes;
+	int m_slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+};
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,157 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Drives the liveness wheel the way the gateway does, built with
+// "scons TESTS=1" and run on the host: a fleet of devices with per-kind
+// timeouts reports on a staggered period, one in a hundred goes silent
+// half way through, and the wheel advances every LIVENESS_TICK. Prints
+// the CPU time spent per tick against the old reset/check pass over
+// every device, and fails if a device that kept reporting expired, a
+// silent one did not, or one was found later than its timeout plus a
+// tick.
+//
+//	timer_wheel_bench [devices]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "timer_wheel.h"
+
+#define BENCH_DEVICES 50000
+#define BENCH_TICK 100
+#define BENCH_DURATION 120000
+#define BENCH_SILENT_AT (BENCH_DURATION / 2)
+#define BENCH_SILENT_EVERY 100
+#define LEGACY_TIMEOUT 5000
+#define LEGACY_INTERVAL 4000
+
+// gas, fan, LED and motion timeouts as a site might configure them
+static const unsigned int kind_timeouts[] = { 5000, 10000, 30000, 60000 };
+
+static double cpu_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+struct device
+{
+	unsigned int timeout;
+	unsigned int period;
+	uint64_t next_report;
+	uint64_t last_report;
+	bool silent;
+	bool active;
+	int64_t expired_at;
+};
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_DEVICES;
+	std::vector<device> devices;
+	TimerWheel wheel(BENCH_TICK, 0);
+	double wheel_us = 0, worst_us = 0, legacy_us = 0;
+	int ticks = 0, refreshes = 0, expired = 0;
+	int legacy_passes = 0, legacy_inactive = 0;
+	int failures = 0;
+
+	if (count <= 0)
+		count = BENCH_DEVICES;
+
+	for (int i = 0; i < count; i++) {
+		device d;
+		d.timeout = kind_timeouts[i % 4];
+		// a notification every third of the timeout, spread over it
+		d.period = d.timeout / 3;
+		d.next_report = (unsigned int)i * 7919 % d.period;
+		d.last_report = 0;
+		d.silent = false;
+		d.active = true;
+		d.expired_at = -1;
+		devices.push_back(d);
+		wheel.schedule(i, d.timeout);
+	}
+
+	for (uint64_t now = BENCH_TICK; now <= BENCH_DURATION; now += BENCH_TICK) {
+		if (now == BENCH_SILENT_AT)
+			for (int i = 0; i < count; i += BENCH_SILENT_EVERY)
+				devices[i].silent = true;
+
+		// the notifications of this tick, then the tick itself
+		for (int i = 0; i < count; i++) {
+			device &d = devices[i];
+			if (d.silent || d.next_report > now)
+				continue;
+			d.last_report = d.next_report;
+			d.next_report += d.period;
+			wheel.schedule(i, d.timeout);
+			refreshes++;
+		}
+		double start = cpu_us();
+		wheel.advance(now, [&devices, &expired, now](int id) {
+			devices[id].expired_at = now;
+			expired++;
+		});
+		double us = cpu_us() - start;
+		wheel_us += us;
+		if (us > worst_us)
+			worst_us = us;
+		ticks++;
+
+		// the reset pass and, ACTIVE_INTERVAL later, the check pass
+		if (now % LEGACY_TIMEOUT == 0 || now % LEGACY_TIMEOUT == LEGACY_INTERVAL) {
+			bool reset = now % LEGACY_TIMEOUT == 0;
+			start = cpu_us();
+			for (auto &d : devices) {
+				if (reset)
+					d.active = !d.silent;
+				else
+					legacy_inactive += !d.active;
+			}
+			legacy_us += cpu_us() - start;
+			legacy_passes++;
+		}
+	}
+
+	for (int i = 0; i < count; i++) {
+		const device &d = devices[i];
+		if (!d.silent && d.expired_at >= 0) {
+			fprintf(stderr, "device %d expired at %lld while reporting\n", i, (long long)d.expired_at);
+			failures++;
+		} else if (d.silent && d.expired_at < 0) {
+			fprintf(stderr, "silent device %d never expired\n", i);
+			failures++;
+		} else if (d.silent && (uint64_t)d.expired_at > d.last_report + d.timeout + BENCH_TICK) {
+			fprintf(stderr, "device %d expired %lld ms after its last report, timeout %u\n",
+				i, (long long)(d.expired_at - d.last_report), d.timeout);
+			failures++;
+		}
+	}
+
+	printf("devices    %6d  refreshes %d  expired %d\n", count, refreshes, expired);
+	printf("wheel      %6d ticks   %8.2f us/tick  worst %8.2f us\n", ticks, wheel_us / ticks, worst_us);
+	printf("reset/check %5d passes %8.2f us/pass  %8.2f us/tick  %d found inactive\n",
+		legacy_passes, legacy_us / legacy_passes, legacy_us / ticks, legacy_inactive);
+
+	return failures ? 1 : 0;
+}
@@ -198,16 +198,10 @@ OCRepresentation ledEdsn::getRep()
 
 OCStackResult ledEdsn::notify()
 {
-	shared_ptr<OCResourceResponse> resourceResponse(
-					new OCResourceResponse());
-
-		resourceResponse->setErrorCode(200);
-
-		resourceResponse->setResourceRepresentation(
-					getRep(), DEFAULT_INTERFACE);
-
-	return OCPlatform::notifyListOfObservers(m_ledResource,
-					m_ledObservers, resourceResponse);
+	// the representation only depends on the setting, which so serves
+	// as its version
+	return m_ledNotify.notify(m_ledResource, m_ledObservers.ids(), m_setting,
+					[this]() { return getRep(); }, QualityOfService::HighQos);
 }
 
 bool ledEdsn::set_led_setting(int setting)
@@ -319,17 +313,14 @@ OCEntityHandlerResult ledEdsn::ledEntityHandler(shared_ptr<OCResourceRequest> Re
 
 			cout << "Register observer" << observationInfo.obsId << endl;
 
-			m_ledObservers.push_back(observationInfo.obsId);
+			m_ledObservers.add(observationInfo.obsId);
 
 			if(1 == m_ledObservers.size())
 				my_led.startPrecence();
 
 		}else if (ObserveAction::ObserveUnregister ==
 						observationInfo.action) {
-			m_ledObservers.erase(
-				remove(m_ledObservers.begin(), m_ledObservers.end(),
-				observationInfo.obsId),
-				m_ledObservers.end());
+			m_ledObservers.remove(observationInfo.obsId);
 
 			cout << "Unregister observer" << observationInfo.obsId << endl;
 
@@ -340,44 +331,47 @@ OCEntityHandlerResult ledEdsn::ledEntityHandler(shared_ptr<OCResourceRequest> Re
 
 	return result;
 }
-void setupPins()
+void setupPins(Hal *hal)
 {
-	my_led.red = mraa_gpio_init(RED);
+	my_led.red = hal->gpio(RED);
 	if (my_led.red != NULL) {
-		mraa_gpio_dir(my_led.red, MRAA_GPIO_OUT);
-		mraa_gpio_write(my_led.red, 1);
+		my_led.red->setOutput(true);
+		my_led.red->write(1);
 	}
 
-	my_led.blue = mraa_gpio_init(BLUE);
+	my_led.blue = hal->gpio(BLUE);
 	if (my_led.blue != NULL) {
-		mraa_gpio_dir(my_led.blue, MRAA_GPIO_OUT);
-		mraa_gpio_write(my_led.blue, 1);
+		my_led.blue->setOutput(true);
+		my_led.blue->write(1);
 	}
 
-	my_led.green = mraa_gpio_init(GREEN);
+	my_led.green = hal->gpio(GREEN);
 	if (my_led.green != NULL) {
-		mraa_gpio_dir(my_led.green, MRAA_GPIO_OUT);
-		mraa_gpio_write(my_led.green, 1);
+		my_led.green->setOutput(true);
+		my_led.green->write(1);
 	}
 }
 
 void turnon_led(int color)
 {
+	if (my_led.red == NULL || my_led.blue == NULL || my_led.green == NULL)
+		return;
+
 	switch (color){
 		case RED:
-			mraa_gpio_write(my_led.red, 0);
-			mraa_gpio_write(my_led.blue, 1);
-			mraa_gpio_write(my_led.green, 1);
+			my_led.red->write(0);
+			my_led.blue->write(1);
+			my_led.green->write(1);
 			break;
 		case BLUE:
-			mraa_gpio_write(my_led.red, 1);
-			mraa_gpio_write(my_led.blue, 0);
-			mraa_gpio_write(my_led.green, 1);
+			my_led.red->write(1);
+			my_led.blue->write(0);
+			my_led.green->write(1);
 			break;
 		case GREEN:
-			mraa_gpio_write(my_led.red, 1);
-			mraa_gpio_write(my_led.blue, 1);
-			mraa_gpio_write(my_led.green, 0);
+			my_led.red->write(1);
+			my_led.blue->write(1);
+			my_led.green->write(0);
 			break;
 		default:
 			cout << "invalue command" << endl;
@@ -400,7 +394,12 @@ int main()
 	sigaction(SIGINT, &sa, NULL);
 	cout << "Press Ctrl-C to quit...." << endl;
 
-	setupPins();
+	std::unique_ptr<Hal> hal(hal_create_default());
+	if (!hal) {
+		cerr << "No hardware backend, see " << HAL_ENV << endl;
+		return 1;
+	}
+	setupPins(hal.get());
 	my_led.configuration();
 
 	loop = g_main_loop_new(NULL, FALSE);
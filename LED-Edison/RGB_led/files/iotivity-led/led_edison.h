@@ -27,7 +27,9 @@
 #include "ocstack.h"
 #include "OCPlatform.h"
 #include "OCApi.h"
-#include "mraa.h"
+#include "hal.h"
+#include "observer_set.h"
+#include "notify_mux.h"
 
 using namespace std;
 using namespace OC;
@@ -49,7 +51,8 @@ class ledEdsn
     shared_ptr<PlatformConfig> m_platformConfig;
     OCRepresentation m_ledRepresentation;
     OCResourceHandle m_ledResource;
-    ObservationIds m_ledObservers;
+    ObserverSet m_ledObservers;
+    NotifyMux m_ledNotify;
 
     OCResourceHandle m_hgConfResource;
     OCResourceHandle m_hgDiscResource;
@@ -58,7 +61,7 @@ class ledEdsn
 
     OCEntityHandlerResult ledEntityHandler(shared_ptr<OCResourceRequest>);
 public:
-    mraa_gpio_context red, blue, green;
+    HalGpio *red, *blue, *green;
     int m_setting;
     bool inPrecence;
     ledEdsn();
@@ -213,16 +213,10 @@ OCRepresentation ledEdsn::getRep()
 
 OCStackResult ledEdsn::notify()
 {
-	shared_ptr<OCResourceResponse> resourceResponse(
-					new OCResourceResponse());
-
-		resourceResponse->setErrorCode(200);
-
-		resourceResponse->setResourceRepresentation(
-					getRep(), DEFAULT_INTERFACE);
-
-	return OCPlatform::notifyListOfObservers(m_ledResource,
-					m_ledObservers, resourceResponse);
+	// the representation only depends on the setting, which so serves
+	// as its version
+	return m_ledNotify.notify(m_ledResource, m_ledObservers.ids(), m_setting,
+					[this]() { return getRep(); }, QualityOfService::LowQos);
 }
 
 bool ledEdsn::set_led_setting(int setting)
@@ -336,17 +330,14 @@ OCEntityHandlerResult ledEdsn::ledEntityHandler(shared_ptr<OCResourceRequest> Re
 
 			cout << "Register observer" << observationInfo.obsId << endl;
 
-			m_ledObservers.push_back(observationInfo.obsId);
+			m_ledObservers.add(observationInfo.obsId);
 
 			if(1 == m_ledObservers.size())
 				my_led.startPrecence();
 
 		}else if (ObserveAction::ObserveUnregister ==
 						observationInfo.action) {
-			m_ledObservers.erase(
-				remove(m_ledObservers.begin(), m_ledObservers.end(),
-				observationInfo.obsId),
-				m_ledObservers.end());
+			m_ledObservers.remove(observationInfo.obsId);
 
 			cout << "Unregister observer" << observationInfo.obsId << endl;
 
@@ -359,9 +350,9 @@ OCEntityHandlerResult ledEdsn::ledEntityHandler(shared_ptr<OCResourceRequest> Re
 }
 
 void clk(){
-	mraa_gpio_write(my_led.clockPin, 0);
+	my_led.clockPin->write(0);
 	usleep(_CLK_PULSE_DELAY);
-	mraa_gpio_write(my_led.clockPin, 1);
+	my_led.clockPin->write(1);
 	usleep(_CLK_PULSE_DELAY);
 }
 
@@ -369,9 +360,9 @@ void sendByte(uint8_t b){
 	// send one bit at a time
 	for (int i=0; i<8; i++){
 		if ((b & 0x80) != 0)
-			mraa_gpio_write(my_led.dataPin, 1);
+			my_led.dataPin->write(1);
 		else
-			mraa_gpio_write(my_led.dataPin, 0);
+			my_led.dataPin->write(0);
 		clk();
 		b <<= 1;
 	}
@@ -420,6 +411,9 @@ void sendColorRGB(uint8_t led, uint8_t red, uint8_t green, uint8_t blue){
 
 void turnon_led(int color)
 {
+	if (my_led.clockPin == NULL || my_led.dataPin == NULL || my_led.ledState == NULL)
+		return;
+
 	switch (color){
 		case RED:
 			for (uint8_t i=0; i<_NUM_LED; i++){
@@ -441,18 +435,18 @@ void turnon_led(int color)
 	}
 }
 
-int initChainableLED(){
-	my_led.clockPin = mraa_gpio_init(_CLK_PIN);
+int initChainableLED(Hal *hal){
+	my_led.clockPin = hal->gpio(_CLK_PIN);
 	if (my_led.clockPin != NULL){
-		mraa_gpio_dir(my_led.clockPin, MRAA_GPIO_OUT);
+		my_led.clockPin->setOutput(true);
 	}
 	else {
 		cerr << "Could not initialize clock pin" << endl;
 		return 1;
 	}
-	my_led.dataPin = mraa_gpio_init(_DATA_PIN);
+	my_led.dataPin = hal->gpio(_DATA_PIN);
 	if (my_led.dataPin != NULL){
-		mraa_gpio_dir(my_led.dataPin, MRAA_GPIO_OUT);
+		my_led.dataPin->setOutput(true);
 	}
 	else {
 		cerr << "Could not initialize data pin" << endl;
@@ -487,7 +481,12 @@ int main()
 	sigaction(SIGINT, &sa, NULL);
 	cout << "Press Ctrl-C to quit...." << endl;
 
-	if (initChainableLED() != 0) {
+	std::unique_ptr<Hal> hal(hal_create_default());
+	if (!hal) {
+		cerr << "No hardware backend, see " << HAL_ENV << endl;
+		return 1;
+	}
+	if (initChainableLED(hal.get()) != 0) {
 		cerr << "Failed initializing the LED" << endl;
 	}
 	if (!my_led.createResource()) {
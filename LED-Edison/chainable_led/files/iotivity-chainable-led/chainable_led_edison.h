@@ -27,7 +27,9 @@
 #include "ocstack.h"
 #include "OCPlatform.h"
 #include "OCApi.h"
-#include "mraa.h"
+#include "hal.h"
+#include "observer_set.h"
+#include "notify_mux.h"
 
 using namespace std;
 using namespace OC;
@@ -54,7 +56,7 @@ void clk(void);
 void sendByte(uint8_t byte);
 void sendColor(uint8_t red, uint8_t green, uint8_t blue);
 void sendColorRGB(uint8_t led, uint8_t red, uint8_t green, uint8_t blue);
-int initChainableLED(void);
+int initChainableLED(Hal *hal);
 
 class ledEdsn
 {
@@ -62,7 +64,8 @@ class ledEdsn
     shared_ptr<PlatformConfig> m_platformConfig;
     OCRepresentation m_ledRepresentation;
     OCResourceHandle m_ledResource;
-    ObservationIds m_ledObservers;
+    ObserverSet m_ledObservers;
+    NotifyMux m_ledNotify;
 
     OCResourceHandle m_hgConfResource;
     OCResourceHandle m_hgDiscResource;
@@ -85,7 +88,7 @@ public:
     void stopPrecence();
     virtual ~ledEdsn();
 
-    mraa_gpio_context clockPin, dataPin;
+    HalGpio *clockPin, *dataPin;
     uint8_t* ledState;
 };
 
@@ -1,4 +1,6 @@
 #include <mutex>
+#include <map>
+#include <sstream>
 #include "OCPlatform.h"
 #include "IoTivity.h"
 #include "IoTivityClient.h"
@@ -10,6 +12,9 @@ namespace IoTivity
 
     int densityDefineValue = 15;
 
+    /* Last /gw/sensor version applied, -1 until the first snapshot */
+    int gatewayVersion = -1;
+
     void updateExistSensors(const std::string key, const std::string type, const OC::OCRepresentation &rep)
     {
         std::string sensorUri;
@@ -37,13 +42,99 @@ namespace IoTivity
         }
     }
 
+    const std::string *sensorType(const std::string &key)
+    {
+        static const std::map< std::string, std::string > types = {
+            {"fan", IOTIVITY_FAN},
+            {"gas", IOTIVITY_GAS},
+            {"led", IOTIVITY_LED},
+            {"pri", IOTIVITY_MOTION},
+            {"heartRate", IOTIVITY_HEARTRATE}
+        };
+        auto iter = types.find(key);
+
+        return iter == types.end() ? nullptr : &iter->second;
+    }
+
+    void applySensorDelta(const std::string &key, const std::string &address, bool removed)
+    {
+        const std::string *type = sensorType(key);
+        std::shared_ptr< OC::OCResource > resource;
+
+        if (type == nullptr)
+            return;
+
+        resource = IoTivityClient::Instance().lookupSensor(*type);
+        if (!removed && resource == nullptr)
+        {
+            std::cout << "Added resource " << *type << std::endl;
+            OC::OCPlatform::findResource("", address, ::OC_ALL, foundResource);
+        }
+        else if (removed && resource != nullptr)
+        {
+            std::cout << "Rmove resource " << resource->uri() << std::endl;
+            IoTivityClient::Instance().notifySensorRemoved(resource);
+        }
+    }
+
+    /* Applies a delta notification: "added" holds name=address pairs and
+     * "removed" names, both comma separated. A delta that does not start
+     * at our version means one was missed, so ask the gateway for the
+     * changes since the version we have instead.
+     */
+    void updateSensorChanges(const OC::OCRepresentation &rep)
+    {
+        int since = -1, version = -1;
+        std::string added, removed, entry;
+
+        rep.getValue("since", since);
+        rep.getValue("version", version);
+        if (since != gatewayVersion)
+        {
+            std::shared_ptr< OC::OCResource > gateway = IoTivityClient::Instance().lookupSensor(IOTIVITY_GATWAY);
+
+            std::cout << "Missed sensor changes " << gatewayVersion << " to " << since << std::endl;
+            if (gateway != nullptr)
+            {
+                OC::QueryParamsMap query;
+                query["since"] = std::to_string(gatewayVersion);
+                gateway->get(query, onGet);
+            }
+            return;
+        }
+
+        rep.getValue("added", added);
+        rep.getValue("removed", removed);
+
+        std::istringstream addedStream(added);
+        while (std::getline(addedStream, entry, ','))
+        {
+            size_t pos = entry.find('=');
+            if (pos != std::string::npos)
+                applySensorDelta(entry.substr(0, pos), entry.substr(pos + 1), false);
+        }
+
+        std::istringstream removedStream(removed);
+        while (std::getline(removedStream, entry, ','))
+            applySensorDelta(entry, "", true);
+
+        gatewayVersion = version;
+    }
+
     void updateSensors(const OC::OCRepresentation &rep)
     {
+        if (rep.hasAttribute("delta"))
+        {
+            updateSensorChanges(rep);
+            return;
+        }
+
         updateExistSensors("fan", IOTIVITY_FAN, rep);
         updateExistSensors("gas", IOTIVITY_GAS, rep);
         updateExistSensors("led", IOTIVITY_LED, rep);
         updateExistSensors("pri", IOTIVITY_MOTION, rep);
         updateExistSensors("heartRate", IOTIVITY_HEARTRATE, rep);
+        rep.getValue("version", gatewayVersion);
     }
 
     void onObserve(const OC::HeaderOptions headerOptions, const OC::OCRepresentation& rep,
@@ -141,7 +232,12 @@ namespace IoTivity
 
                 if (IoTivityClient::Instance().lookupSensor(resource->uri()) == nullptr)
                 {
-                    resource->observe(OC::ObserveType::Observe, OC::QueryParamsMap(), onObserve);
+                    OC::QueryParamsMap observeQuery;
+
+                    /* the gateway only needs to send what changed */
+                    if (resource->uri() == IOTIVITY_GATWAY)
+                        observeQuery["mode"] = "delta";
+                    resource->observe(OC::ObserveType::Observe, observeQuery, onObserve);
 
                     IoTivityClient::Instance().notifySensorAdded(resource);
                 }
@@ -25,6 +25,7 @@ namespace IoTivity
     private:
         friend void updateExistSensors(const std::string key, const std::string type, const OC::OCRepresentation &rep);
         friend void getSensors(const OC::OCRepresentation &rep);
+        friend void applySensorDelta(const std::string &key, const std::string &address, bool removed);
         friend void foundResource(std::shared_ptr< OC::OCResource > resource);
         friend void onGet(const OC::HeaderOptions& headerOptions, const OC::OCRepresentation& rep, const int eCode);
         friend void onPut(const OC::HeaderOptions& headerOptions, const OC::OCRepresentation &rep, const int eCode);
@@ -0,0 +1,233 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "async_log.h"
+
+#define ALOG_RING_SIZE 1024	// power of two
+#define ALOG_IDLE_WAIT 50
+
+static const char level_names[] = "DIWE";
+
+// Bounded multi-producer ring after Dmitry Vyukov's array queue, drained
+// by the single output thread.
+class AsyncLog
+{
+	public:
+	AsyncLog() : m_head(0), m_tail(0), m_running(true), m_sleeping(false), m_dropped(0)
+	{
+		for (size_t i = 0; i < ALOG_RING_SIZE; i++)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		m_thread = std::thread(&AsyncLog::run, this);
+	}
+
+	~AsyncLog()
+	{
+		m_running = false;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_wakeup.notify_one();
+		}
+		m_thread.join();
+	}
+
+	void push(const alog_record &record)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			cell &c = m_cells[pos & (ALOG_RING_SIZE - 1)];
+			size_t seq = c.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					c.record = record;
+					c.sequence.store(pos + 1, std::memory_order_release);
+					break;
+				}
+			}
+			else if (diff < 0) {
+				m_dropped++;
+				return;
+			}
+			else {
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		if (m_sleeping.load()) {
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_wakeup.notify_one();
+		}
+	}
+
+	unsigned long dropped() const
+	{
+		return m_dropped.load();
+	}
+
+	private:
+	struct cell
+	{
+		std::atomic<size_t> sequence;
+		alog_record record;
+	};
+
+	bool pop(alog_record &record)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		cell &c = m_cells[pos & (ALOG_RING_SIZE - 1)];
+
+		if ((intptr_t)c.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0)
+			return false;
+
+		record = c.record;
+		m_head.store(pos + 1, std::memory_order_relaxed);
+		c.sequence.store(pos + ALOG_RING_SIZE, std::memory_order_release);
+		return true;
+	}
+
+	void format(const alog_record &record, std::string &line)
+	{
+		char prefix[32];
+		time_t seconds = record.time_us / 1000000;
+		struct tm tm;
+		int next = 0;
+
+		localtime_r(&seconds, &tm);
+		snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %c ", tm.tm_hour, tm.tm_min,
+			tm.tm_sec, (int)(record.time_us % 1000000 / 1000), level_names[record.level]);
+		line = prefix;
+
+		for (const char *p = record.format; *p; p++) {
+			if (p[0] != '{' || p[1] != '}' || next >= record.count) {
+				line += *p;
+				continue;
+			}
+
+			const alog_arg &arg = record.args[next++];
+			char number[32];
+			switch (arg.type) {
+			case alog_arg::INT:
+				snprintf(number, sizeof(number), "%lld", arg.i);
+				line += number;
+				break;
+			case alog_arg::UINT:
+				snprintf(number, sizeof(number), "%llu", arg.u);
+				line += number;
+				break;
+			case alog_arg::DOUBLE:
+				snprintf(number, sizeof(number), "%g", arg.d);
+				line += number;
+				break;
+			case alog_arg::TEXT:
+				line.append(record.text + arg.text.offset, arg.text.length);
+				break;
+			case alog_arg::POINTER:
+				snprintf(number, sizeof(number), "%p", arg.p);
+				line += number;
+				break;
+			}
+			p++;
+		}
+		line += '\n';
+	}
+
+	void run()
+	{
+		alog_record record;
+		std::string line;
+
+		for (;;) {
+			if (pop(record)) {
+				format(record, line);
+				fwrite(line.data(), 1, line.size(), stdout);
+				continue;
+			}
+
+			fflush(stdout);
+			if (!m_running)
+				break;
+
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_sleeping = true;
+			// re-check after announcing the sleep so a racing push is
+			// not left waiting for the timeout
+			if (m_head.load() == m_tail.load() && m_running)
+				m_wakeup.wait_for(lock, std::chrono::milliseconds(ALOG_IDLE_WAIT));
+			m_sleeping = false;
+		}
+	}
+
+	cell m_cells[ALOG_RING_SIZE];
+	char m_pad0[64];
+	std::atomic<size_t> m_head;
+	char m_pad1[64];
+	std::atomic<size_t> m_tail;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_sleeping;
+	std::atomic<unsigned long> m_dropped;
+	std::mutex m_lock;
+	std::condition_variable m_wakeup;
+	std::thread m_thread;
+};
+
+static AsyncLog &async_log()
+{
+	static AsyncLog log;
+
+	return log;
+}
+
+void alog_text(alog_record &record, const char *text, size_t length)
+{
+	alog_arg *arg = alog_next(record);
+	if (!arg)
+		return;
+
+	if (length > (size_t)(ALOG_TEXT_SIZE - record.text_used))
+		length = ALOG_TEXT_SIZE - record.text_used;
+	memcpy(record.text + record.text_used, text, length);
+
+	arg->type = alog_arg::TEXT;
+	arg->text.offset = record.text_used;
+	arg->text.length = length;
+	record.text_used += length;
+}
+
+void alog_submit(alog_record &record)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	record.time_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+	async_log().push(record);
+}
+
+unsigned long alog_dropped()
+{
+	return async_log().dropped();
+}
@@ -0,0 +1,184 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef ASYNC_LOG_H_
+#define ASYNC_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+// Asynchronous logger for the hot paths. A log statement copies its
+// format string pointer and arguments into a lock-free ring; a background
+// thread formats and writes them, flushing only when the ring runs dry.
+// When the ring is full the record is dropped and counted rather than
+// blocking the caller.
+//
+// Statements below ALOG_LEVEL are compiled out, arguments included:
+//
+//	ALOG_DEBUG("sensor {} density {}", sensor.s_name, density);
+//
+// Each {} in the format takes the next argument. Format strings must be
+// literals; string arguments are copied.
+
+#define ALOG_LEVEL_DEBUG 0
+#define ALOG_LEVEL_INFO 1
+#define ALOG_LEVEL_WARN 2
+#define ALOG_LEVEL_ERROR 3
+#define ALOG_LEVEL_NONE 4
+
+#ifndef ALOG_LEVEL
+#define ALOG_LEVEL ALOG_LEVEL_INFO
+#endif
+
+#define ALOG_MAX_ARGS 6
+#define ALOG_TEXT_SIZE 128
+
+#define ALOG(level, ...) \
+	do { \
+		if ((level) >= ALOG_LEVEL) \
+			alog_write((level), __VA_ARGS__); \
+	} while (0)
+
+#define ALOG_DEBUG(...) ALOG(ALOG_LEVEL_DEBUG, __VA_ARGS__)
+#define ALOG_INFO(...) ALOG(ALOG_LEVEL_INFO, __VA_ARGS__)
+#define ALOG_WARN(...) ALOG(ALOG_LEVEL_WARN, __VA_ARGS__)
+#define ALOG_ERROR(...) ALOG(ALOG_LEVEL_ERROR, __VA_ARGS__)
+
+struct alog_arg
+{
+	enum { INT, UINT, DOUBLE, TEXT, POINTER } type;
+	union {
+		long long i;
+		unsigned long long u;
+		double d;
+		const void *p;
+		struct {
+			uint16_t offset;
+			uint16_t length;
+		} text;
+	};
+};
+
+struct alog_record
+{
+	uint8_t level;
+	uint8_t count;
+	uint16_t text_used;
+	uint64_t time_us;
+	const char *format;
+	alog_arg args[ALOG_MAX_ARGS];
+	char text[ALOG_TEXT_SIZE];
+};
+
+void alog_text(alog_record &record, const char *text, size_t length);
+void alog_submit(alog_record &record);
+// Records dropped because the ring was full.
+unsigned long alog_dropped();
+
+inline alog_arg *alog_next(alog_record &record)
+{
+	return record.count < ALOG_MAX_ARGS ? &record.args[record.count++] : nullptr;
+}
+
+inline void alog_capture(alog_record &record, long long value)
+{
+	alog_arg *arg = alog_next(record);
+	if (arg) {
+		arg->type = alog_arg::INT;
+		arg->i = value;
+	}
+}
+
+inline void alog_capture(alog_record &record, unsigned long long value)
+{
+	alog_arg *arg = alog_next(record);
+	if (arg) {
+		arg->type = alog_arg::UINT;
+		arg->u = value;
+	}
+}
+
+inline void alog_capture(alog_record &record, int value) { alog_capture(record, (long long)value); }
+inline void alog_capture(alog_record &record, long value) { alog_capture(record, (long long)value); }
+inline void alog_capture(alog_record &record, short value) { alog_capture(record, (long long)value); }
+inline void alog_capture(alog_record &record, char value) { alog_capture(record, (long long)value); }
+inline void alog_capture(alog_record &record, bool value) { alog_capture(record, (long long)value); }
+inline void alog_capture(alog_record &record, unsigned int value) { alog_capture(record, (unsigned long long)value); }
+inline void alog_capture(alog_record &record, unsigned long value) { alog_capture(record, (unsigned long long)value); }
+inline void alog_capture(alog_record &record, unsigned short value) { alog_capture(record, (unsigned long long)value); }
+inline void alog_capture(alog_record &record, unsigned char value) { alog_capture(record, (unsigned long long)value); }
+
+inline void alog_capture(alog_record &record, double value)
+{
+	alog_arg *arg = alog_next(record);
+	if (arg) {
+		arg->type = alog_arg::DOUBLE;
+		arg->d = value;
+	}
+}
+
+inline void alog_capture(alog_record &record, const char *value)
+{
+	alog_text(record, value ? value : "(null)", value ? strlen(value) : 6);
+}
+
+inline void alog_capture(alog_record &record, char *value) { alog_capture(record, (const char *)value); }
+
+inline void alog_capture(alog_record &record, const std::string &value)
+{
+	alog_text(record, value.data(), value.size());
+}
+
+inline void alog_capture(alog_record &record, const void *value)
+{
+	alog_arg *arg = alog_next(record);
+	if (arg) {
+		arg->type = alog_arg::POINTER;
+		arg->p = value;
+	}
+}
+
+inline void alog_pack(alog_record &)
+{
+}
+
+template <typename T, typename... Args>
+inline void alog_pack(alog_record &record, const T &value, const Args&... args)
+{
+	alog_capture(record, value);
+	alog_pack(record, args...);
+}
+
+template <typename... Args>
+void alog_write(int level, const char *format, const Args&... args)
+{
+	alog_record record;
+
+	record.level = level;
+	record.count = 0;
+	record.text_used = 0;
+	record.format = format;
+	alog_pack(record, args...);
+	alog_submit(record);
+}
+
+#endif /* ASYNC_LOG_H_ */
@@ -0,0 +1,51 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <stdlib.h>
+#include <iostream>
+#include "hal.h"
+
+Hal *hal_create(const std::string &spec)
+{
+	if (spec == "mraa")
+		return hal_mraa_create();
+	if (spec == "sim")
+		return hal_sim_create("");
+	if (spec.compare(0, 4, "sim:") == 0)
+		return hal_sim_create(spec.substr(4));
+
+	std::cerr << "Unknown hardware backend " << spec << std::endl;
+	return NULL;
+}
+
+Hal *hal_create_default()
+{
+	const char *spec = getenv(HAL_ENV);
+
+	return hal_create(spec && *spec ? spec : HAL_DEFAULT);
+}
+
+#ifndef HAVE_MRAA
+Hal *hal_mraa_create()
+{
+	std::cerr << "Built without libmraa" << std::endl;
+	return NULL;
+}
+#endif
@@ -0,0 +1,95 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <string>
+
+// the environment variable naming the backend the daemons run on
+#define HAL_ENV "DEVICE_HAL"
+#ifdef HAVE_MRAA
+#define HAL_DEFAULT "mraa"
+#else
+#define HAL_DEFAULT "sim"
+#endif
+
+enum HalEdge
+{
+	HAL_EDGE_RISING,
+	HAL_EDGE_FALLING,
+	HAL_EDGE_BOTH
+};
+
+typedef void (*HalEdgeHandler)(void *context);
+
+// A digital pin. Deleting it releases the pin.
+class HalGpio
+{
+	public:
+	virtual ~HalGpio() {}
+
+	virtual bool setOutput(bool output) = 0;
+	virtual int read() = 0;
+	virtual bool write(int level) = 0;
+	// Calls 'handler' for every 'edge' of the pin, on a thread of the
+	// backend's. Returns false when the pin cannot interrupt.
+	virtual bool watch(HalEdge edge, HalEdgeHandler handler, void *context) = 0;
+	// No handler is called once unwatch() returns.
+	virtual void unwatch() = 0;
+};
+
+// An analog input. Deleting it releases the pin.
+class HalAio
+{
+	public:
+	virtual ~HalAio() {}
+
+	virtual unsigned int read() = 0;
+	virtual bool setBits(int bits) = 0;
+};
+
+// Where the daemons' pins come from. Pins are opened and used from any
+// thread; they must all be deleted before their Hal.
+class Hal
+{
+	public:
+	virtual ~Hal() {}
+
+	// NULL when the pin cannot be opened.
+	virtual HalGpio *gpio(int pin) = 0;
+	virtual HalAio *aio(unsigned int pin) = 0;
+};
+
+// Creates the backend 'spec' names:
+//
+//   mraa                        the board, through libmraa
+//   sim[:<script>]              in-process pins, see hal_sim.cpp; without
+//                               a script inputs read 0 and never change
+//
+// Returns NULL for an empty or unknown spec or a bad script.
+Hal *hal_create(const std::string &spec);
+// The backend named by HAL_ENV, or HAL_DEFAULT.
+Hal *hal_create_default();
+
+Hal *hal_mraa_create();
+Hal *hal_sim_create(const std::string &script);
+
+#endif /* HAL_H_ */
@@ -0,0 +1,116 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include "hal.h"
+#include "mraa.h"
+
+class MraaGpio : public HalGpio
+{
+	public:
+	MraaGpio(mraa_gpio_context gpio) : m_gpio(gpio), m_watched(false) {}
+
+	~MraaGpio()
+	{
+		unwatch();
+		mraa_gpio_close(m_gpio);
+	}
+
+	bool setOutput(bool output)
+	{
+		return mraa_gpio_dir(m_gpio, output ? MRAA_GPIO_OUT : MRAA_GPIO_IN) == MRAA_SUCCESS;
+	}
+
+	int read()
+	{
+		return mraa_gpio_read(m_gpio);
+	}
+
+	bool write(int level)
+	{
+		return mraa_gpio_write(m_gpio, level) == MRAA_SUCCESS;
+	}
+
+	bool watch(HalEdge edge, HalEdgeHandler handler, void *context)
+	{
+		mraa_gpio_edge_t mode = edge == HAL_EDGE_RISING ? MRAA_GPIO_EDGE_RISING :
+			edge == HAL_EDGE_FALLING ? MRAA_GPIO_EDGE_FALLING : MRAA_GPIO_EDGE_BOTH;
+
+		if (m_watched)
+			return false;
+		m_watched = mraa_gpio_isr(m_gpio, mode, handler, context) == MRAA_SUCCESS;
+		return m_watched;
+	}
+
+	void unwatch()
+	{
+		if (m_watched)
+			mraa_gpio_isr_exit(m_gpio);
+		m_watched = false;
+	}
+
+	private:
+	mraa_gpio_context m_gpio;
+	bool m_watched;
+};
+
+class MraaAio : public HalAio
+{
+	public:
+	MraaAio(mraa_aio_context aio) : m_aio(aio) {}
+
+	~MraaAio()
+	{
+		mraa_aio_close(m_aio);
+	}
+
+	unsigned int read()
+	{
+		return mraa_aio_read(m_aio);
+	}
+
+	bool setBits(int bits)
+	{
+		return mraa_aio_set_bit(m_aio, bits) == MRAA_SUCCESS;
+	}
+
+	private:
+	mraa_aio_context m_aio;
+};
+
+class MraaHal : public Hal
+{
+	public:
+	HalGpio *gpio(int pin)
+	{
+		mraa_gpio_context gpio = mraa_gpio_init(pin);
+		return gpio ? new MraaGpio(gpio) : NULL;
+	}
+
+	HalAio *aio(unsigned int pin)
+	{
+		mraa_aio_context aio = mraa_aio_init(pin);
+		return aio ? new MraaAio(aio) : NULL;
+	}
+};
+
+Hal *hal_mraa_create()
+{
+	return new MraaHal();
+}
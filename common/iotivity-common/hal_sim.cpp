@@ -0,0 +1,625 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// In-process pins, so the device daemons run on an ordinary host and
+// many of them on one machine can load a gateway. What the inputs do
+// comes from a script, one setting per line, '#' to the end of a line
+// being a comment:
+//
+//   gpio <pin> <wave> [bounce=<n>]
+//   aio <pin> <wave> [noise=<n>] [spike=<n>]
+//   latency gpio|aio|edge <us> [<jitter us>]
+//   phase random
+//   seed <n>
+//
+// A wave is a list of <value>@<ms>, each value held that long, and
+// starts over when it ends; a last value without @<ms> is held for good,
+// so "400" is a constant and "400@5000 600" a step after 5 s. On a
+// digital input every change is an edge for the pin's handler; 'bounce'
+// adds that many 1 ms glitches after it. An analog input reads the wave
+// plus up to 'noise' either way, and every 'spike'-th reading full scale.
+//
+// 'latency' makes every gpio or aio read and write, or the call of an
+// edge handler, take that long. With 'phase random' each pin starts at a
+// random point of its wave, drawn from 'seed' (the process id if not
+// given), so that nodes started together do not move in lockstep.
+// Pins not in the script read 0; outputs hold what was written.
+//
+// One thread per process fires the edges of all watched pins. The time
+// from an edge being due to its handler returning is reported every
+// SIM_LATENCY_REPORT edges of a pin.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "hal.h"
+
+#define SIM_LATENCY_REPORT 100
+#define SIM_AIO_BITS 10
+
+typedef std::chrono::steady_clock SimClock;
+
+struct SimWave
+{
+	// value and ms it is held; 0 ms holds it for good
+	std::vector<std::pair<int, int> > segments;
+	int bounce;
+	int noise;
+	int spike;
+
+	SimWave() : segments(1, std::make_pair(0, 0)), bounce(0), noise(0), spike(0) {}
+
+	// ms the wave takes before it starts over, 0 when it ends in a hold
+	int64_t period() const
+	{
+		int64_t total = 0;
+		for (auto &segment : segments) {
+			if (segment.second <= 0)
+				return 0;
+			total += segment.second;
+		}
+		return total;
+	}
+
+	// The segment 'elapsed' ms in and the ms left of it, -1 for a hold.
+	size_t locate(int64_t elapsed, int64_t &left) const
+	{
+		int64_t total = period();
+
+		if (total > 0)
+			elapsed %= total;
+		for (size_t i = 0; i < segments.size(); i++) {
+			if (segments[i].second <= 0 || elapsed < segments[i].second) {
+				left = segments[i].second <= 0 ? -1 : segments[i].second - elapsed;
+				return i;
+			}
+			elapsed -= segments[i].second;
+		}
+		left = -1;
+		return segments.size() - 1;
+	}
+};
+
+struct SimDelay
+{
+	int us;
+	int jitter;
+};
+
+static std::atomic<unsigned int> sim_seed(0);
+
+static std::minstd_rand &sim_random()
+{
+	static thread_local std::minstd_rand random(sim_seed ^
+		std::hash<std::thread::id>()(std::this_thread::get_id()));
+	return random;
+}
+
+static void sim_delay(const SimDelay &delay)
+{
+	int us = delay.us;
+
+	if (delay.jitter > 0)
+		us += (int)(sim_random()() % (2 * delay.jitter + 1)) - delay.jitter;
+	if (us > 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+class SimHal;
+
+class SimGpio : public HalGpio
+{
+	public:
+	SimGpio(SimHal *hal, int pin, const SimWave &wave, int64_t phase);
+	~SimGpio();
+
+	bool setOutput(bool output);
+	int read();
+	bool write(int level);
+	bool watch(HalEdge edge, HalEdgeHandler handler, void *context);
+	void unwatch();
+
+	// level of an output, or of a watched input as of its last edge
+	std::atomic<int> m_level;
+
+	private:
+	friend class SimHal;
+
+	SimHal *m_hal;
+	int m_pin;
+	SimWave m_wave;
+	SimClock::time_point m_start;
+	std::atomic<bool> m_output;
+	std::atomic<bool> m_watched;
+
+	// the rest is the edge thread's, guarded by SimHal::m_lock
+	HalEdge m_edge;
+	HalEdgeHandler m_handler;
+	void *m_context;
+	size_t m_segment;
+	SimClock::time_point m_segmentEnd;
+	int m_bounces;
+	SimClock::time_point m_bounceAt;
+	uint64_t m_edges;
+	double m_total;
+	double m_worst;
+
+	int64_t elapsed(SimClock::time_point now) const;
+	void arm(SimClock::time_point now);
+	SimClock::time_point due() const;
+	// Moves on to what is due at 'at'; the new level or -1 if none.
+	int advance(SimClock::time_point at);
+};
+
+class SimAio : public HalAio
+{
+	public:
+	SimAio(SimHal *hal, const SimWave &wave, int64_t phase);
+
+	unsigned int read();
+	bool setBits(int bits);
+
+	private:
+	SimHal *m_hal;
+	SimWave m_wave;
+	SimClock::time_point m_start;
+	std::atomic<unsigned int> m_reads;
+	unsigned int m_max;
+};
+
+class SimHal : public Hal
+{
+	public:
+	SimHal();
+	~SimHal();
+
+	bool load(const std::string &path);
+
+	HalGpio *gpio(int pin);
+	HalAio *aio(unsigned int pin);
+
+	bool watch(SimGpio *gpio);
+	void unwatch(SimGpio *gpio);
+
+	SimDelay m_gpioLatency;
+	SimDelay m_aioLatency;
+	SimDelay m_edgeLatency;
+
+	private:
+	std::map<int, SimWave> m_gpioWaves;
+	std::map<int, SimWave> m_aioWaves;
+	bool m_randomPhase;
+	std::minstd_rand m_phases;
+
+	std::mutex m_lock;
+	std::condition_variable m_changed;
+	std::condition_variable m_idle;
+	std::vector<SimGpio *> m_watched;
+	SimGpio *m_dispatching;
+	bool m_running;
+	std::thread m_thread;
+
+	int64_t phase(const SimWave &wave);
+	bool watching(SimGpio *gpio, SimClock::time_point due) const;
+	void run();
+	void dispatch(SimGpio *gpio, SimClock::time_point due);
+};
+
+SimGpio::SimGpio(SimHal *hal, int pin, const SimWave &wave, int64_t phase) :
+	m_level(0), m_hal(hal), m_pin(pin), m_wave(wave),
+	m_start(SimClock::now() - std::chrono::milliseconds(phase)), m_output(false),
+	m_watched(false), m_edge(HAL_EDGE_BOTH), m_handler(NULL), m_context(NULL), m_segment(0),
+	m_bounces(0), m_edges(0), m_total(0), m_worst(0)
+{
+}
+
+SimGpio::~SimGpio()
+{
+	unwatch();
+}
+
+bool SimGpio::setOutput(bool output)
+{
+	m_output = output;
+	return true;
+}
+
+int64_t SimGpio::elapsed(SimClock::time_point now) const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start).count();
+}
+
+int SimGpio::read()
+{
+	int64_t left;
+
+	sim_delay(m_hal->m_gpioLatency);
+	if (m_output || m_watched)
+		return m_level;
+	return m_wave.segments[m_wave.locate(elapsed(SimClock::now()), left)].first != 0;
+}
+
+bool SimGpio::write(int level)
+{
+	sim_delay(m_hal->m_gpioLatency);
+	m_level = level != 0;
+	return true;
+}
+
+bool SimGpio::watch(HalEdge edge, HalEdgeHandler handler, void *context)
+{
+	if (m_output || m_watched)
+		return false;
+	m_edge = edge;
+	m_handler = handler;
+	m_context = context;
+	m_watched = m_hal->watch(this);
+	return m_watched;
+}
+
+void SimGpio::unwatch()
+{
+	if (m_watched)
+		m_hal->unwatch(this);
+	m_watched = false;
+}
+
+void SimGpio::arm(SimClock::time_point now)
+{
+	int64_t left;
+
+	m_segment = m_wave.locate(elapsed(now), left);
+	m_segmentEnd = left < 0 ? SimClock::time_point::max() : now + std::chrono::milliseconds(left);
+	m_bounces = 0;
+	m_level = m_wave.segments[m_segment].first != 0;
+}
+
+SimClock::time_point SimGpio::due() const
+{
+	return m_bounces > 0 && m_bounceAt < m_segmentEnd ? m_bounceAt : m_segmentEnd;
+}
+
+int SimGpio::advance(SimClock::time_point at)
+{
+	if (m_bounces > 0 && m_bounceAt < m_segmentEnd) {
+		m_bounces--;
+		m_bounceAt += std::chrono::milliseconds(1);
+		m_level = !m_level;
+		return m_level;
+	}
+
+	m_segment = (m_segment + 1) % m_wave.segments.size();
+	int ms = m_wave.segments[m_segment].second;
+	m_segmentEnd = ms > 0 ? at + std::chrono::milliseconds(ms) : SimClock::time_point::max();
+	m_bounces = 0;
+
+	int level = m_wave.segments[m_segment].first != 0;
+	if (level == m_level)
+		return -1;
+	m_level = level;
+	if (m_wave.bounce > 0) {
+		m_bounces = 2 * m_wave.bounce;
+		m_bounceAt = at + std::chrono::milliseconds(1);
+	}
+	return level;
+}
+
+SimAio::SimAio(SimHal *hal, const SimWave &wave, int64_t phase) :
+	m_hal(hal), m_wave(wave), m_start(SimClock::now() - std::chrono::milliseconds(phase)),
+	m_reads(0), m_max((1 << SIM_AIO_BITS) - 1)
+{
+}
+
+unsigned int SimAio::read()
+{
+	int64_t left;
+
+	sim_delay(m_hal->m_aioLatency);
+	if (m_wave.spike > 0 && ++m_reads % m_wave.spike == 0)
+		return m_max;
+
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		SimClock::now() - m_start).count();
+	int value = m_wave.segments[m_wave.locate(elapsed, left)].first;
+	if (m_wave.noise > 0)
+		value += (int)(sim_random()() % (2 * m_wave.noise + 1)) - m_wave.noise;
+	return value < 0 ? 0 : (unsigned int)value > m_max ? m_max : value;
+}
+
+bool SimAio::setBits(int bits)
+{
+	if (bits <= 0 || bits > 16)
+		return false;
+	m_max = (1 << bits) - 1;
+	return true;
+}
+
+SimHal::SimHal() : m_randomPhase(false), m_dispatching(NULL), m_running(false)
+{
+	m_gpioLatency = m_aioLatency = m_edgeLatency = SimDelay{0, 0};
+	sim_seed = getpid();
+	m_phases.seed(sim_seed);
+}
+
+SimHal::~SimHal()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_running = false;
+	}
+	m_changed.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+// Reads a "key=<n>" word into 'value'.
+static bool sim_option(const std::string &word, const char *key, int &value)
+{
+	size_t length = strlen(key);
+
+	if (word.compare(0, length, key) != 0)
+		return false;
+	value = atoi(word.c_str() + length);
+	return true;
+}
+
+static bool sim_wave(std::istringstream &words, std::map<int, SimWave> &waves)
+{
+	SimWave wave;
+	std::string word;
+	int pin;
+
+	if (!(words >> pin))
+		return false;
+	wave.segments.clear();
+	while (words >> word) {
+		if (sim_option(word, "bounce=", wave.bounce) || sim_option(word, "noise=", wave.noise) ||
+				sim_option(word, "spike=", wave.spike))
+			continue;
+		// nothing can follow a hold
+		if (!wave.segments.empty() && wave.segments.back().second <= 0)
+			return false;
+
+		const char *text = word.c_str();
+		char *end;
+		int value = strtol(text, &end, 10);
+		int ms = 0;
+		if (end == text)
+			return false;
+		if (*end == '@') {
+			text = end + 1;
+			ms = strtol(text, &end, 10);
+			if (end == text || ms <= 0)
+				return false;
+		}
+		if (*end)
+			return false;
+		wave.segments.push_back(std::make_pair(value, ms));
+	}
+	if (wave.segments.empty())
+		return false;
+	waves[pin] = wave;
+	return true;
+}
+
+bool SimHal::load(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+	std::string line;
+	int number = 0;
+
+	if (!file) {
+		std::cerr << "Cannot read hardware script " << path << std::endl;
+		return false;
+	}
+	while (std::getline(file, line)) {
+		size_t comment = line.find('#');
+		std::istringstream words(comment == std::string::npos ? line : line.substr(0, comment));
+		std::string kind, what;
+		unsigned int seed;
+		bool ok = false;
+
+		number++;
+		if (!(words >> kind))
+			continue;
+		if (kind == "gpio") {
+			ok = sim_wave(words, m_gpioWaves);
+		}
+		else if (kind == "aio") {
+			ok = sim_wave(words, m_aioWaves);
+		}
+		else if (kind == "latency" && words >> what) {
+			SimDelay delay{0, 0};
+			ok = (bool)(words >> delay.us);
+			words >> delay.jitter;
+			if (what == "gpio")
+				m_gpioLatency = delay;
+			else if (what == "aio")
+				m_aioLatency = delay;
+			else if (what == "edge")
+				m_edgeLatency = delay;
+			else
+				ok = false;
+		}
+		else if (kind == "phase" && words >> what) {
+			ok = what == "random";
+			m_randomPhase = ok;
+		}
+		else if (kind == "seed" && words >> seed) {
+			sim_seed = seed;
+			m_phases.seed(seed);
+			ok = true;
+		}
+
+		if (!ok) {
+			std::cerr << path << ":" << number << ": cannot make sense of \"" << line << "\"" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int64_t SimHal::phase(const SimWave &wave)
+{
+	int64_t period = wave.period();
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	return m_randomPhase && period > 0 ? m_phases() % period : 0;
+}
+
+HalGpio *SimHal::gpio(int pin)
+{
+	auto wave = m_gpioWaves.find(pin);
+
+	if (wave == m_gpioWaves.end())
+		return new SimGpio(this, pin, SimWave(), 0);
+	return new SimGpio(this, pin, wave->second, phase(wave->second));
+}
+
+HalAio *SimHal::aio(unsigned int pin)
+{
+	auto wave = m_aioWaves.find(pin);
+
+	if (wave == m_aioWaves.end())
+		return new SimAio(this, SimWave(), 0);
+	return new SimAio(this, wave->second, phase(wave->second));
+}
+
+bool SimHal::watch(SimGpio *gpio)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		gpio->arm(SimClock::now());
+		m_watched.push_back(gpio);
+		if (!m_running) {
+			m_running = true;
+			m_thread = std::thread(&SimHal::run, this);
+		}
+	}
+	m_changed.notify_all();
+	return true;
+}
+
+void SimHal::unwatch(SimGpio *gpio)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	for (size_t i = 0; i < m_watched.size(); i++) {
+		if (m_watched[i] == gpio) {
+			m_watched[i] = m_watched.back();
+			m_watched.pop_back();
+			break;
+		}
+	}
+	// the edge thread may be waiting for this pin's next edge
+	m_changed.notify_all();
+	// a handler may unwatch its own pin
+	if (std::this_thread::get_id() != m_thread.get_id())
+		m_idle.wait(lock, [this, gpio] { return m_dispatching != gpio; });
+}
+
+// Whether 'gpio' is still watched and still next due at 'due'; the
+// second check catches a new pin allocated where an unwatched one was.
+bool SimHal::watching(SimGpio *gpio, SimClock::time_point due) const
+{
+	for (SimGpio *watched : m_watched) {
+		if (watched == gpio)
+			return gpio->due() == due;
+	}
+	return false;
+}
+
+void SimHal::run()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	while (m_running) {
+		SimClock::time_point due = SimClock::time_point::max();
+		SimGpio *next = NULL;
+
+		for (SimGpio *gpio : m_watched) {
+			if (gpio->due() < due) {
+				due = gpio->due();
+				next = gpio;
+			}
+		}
+		if (next == NULL) {
+			m_changed.wait(lock);
+			continue;
+		}
+		m_changed.wait_until(lock, due);
+		// woken early, or the pins changed; 'next' may have been unwatched
+		// and deleted while the lock was released
+		if (SimClock::now() < due || !m_running || !watching(next, due))
+			continue;
+
+		int level = next->advance(due);
+		if (level < 0 || (next->m_edge == HAL_EDGE_RISING && !level) ||
+				(next->m_edge == HAL_EDGE_FALLING && level))
+			continue;
+
+		m_dispatching = next;
+		lock.unlock();
+		dispatch(next, due);
+		lock.lock();
+		m_dispatching = NULL;
+		m_idle.notify_all();
+	}
+}
+
+void SimHal::dispatch(SimGpio *gpio, SimClock::time_point due)
+{
+	sim_delay(m_edgeLatency);
+	gpio->m_handler(gpio->m_context);
+
+	double latency = std::chrono::duration<double, std::micro>(SimClock::now() - due).count();
+	gpio->m_total += latency;
+	if (latency > gpio->m_worst)
+		gpio->m_worst = latency;
+	if (++gpio->m_edges % SIM_LATENCY_REPORT == 0) {
+		std::cout << "Sim GPIO " << gpio->m_pin << ": edge to handled " <<
+			(int)(gpio->m_total / SIM_LATENCY_REPORT) << " us on average, " <<
+			(int)gpio->m_worst << " us at worst" << std::endl;
+		gpio->m_total = gpio->m_worst = 0;
+	}
+}
+
+Hal *hal_sim_create(const std::string &script)
+{
+	SimHal *hal = new SimHal();
+
+	if (!script.empty() && !hal->load(script)) {
+		delete hal;
+		return NULL;
+	}
+	return hal;
+}
@@ -0,0 +1,111 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// Checks of the simulated HAL, built with "scons TESTS=1" from the
+// sensors and run on the host, best under AddressSanitizer. Exits
+// non-zero on the first failure.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "hal.h"
+
+// a pin that changes every 50 ms, for good
+#define TEST_SCRIPT "gpio 3 0@50 1@50\n"
+#define TEST_PIN 3
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+static void count_edge(void *context)
+{
+	(*(std::atomic<int> *)context)++;
+}
+
+static Hal *create_hal()
+{
+	char script[] = "/tmp/hal_sim_test.XXXXXX";
+	int fd = mkstemp(script);
+
+	if (fd < 0)
+		return NULL;
+	bool written = write(fd, TEST_SCRIPT, sizeof(TEST_SCRIPT) - 1) == sizeof(TEST_SCRIPT) - 1;
+	close(fd);
+	Hal *hal = written ? hal_sim_create(script) : NULL;
+	unlink(script);
+	return hal;
+}
+
+// A watched pin gets an edge every 50 ms.
+static int test_edges(Hal *hal)
+{
+	std::atomic<int> edges(0);
+	std::unique_ptr<HalGpio> pin(hal->gpio(TEST_PIN));
+
+	CHECK(pin != nullptr);
+	CHECK(pin->watch(HAL_EDGE_BOTH, count_edge, &edges));
+	std::this_thread::sleep_for(std::chrono::milliseconds(525));
+	pin->unwatch();
+	int seen = edges;
+	CHECK(seen >= 9 && seen <= 11);
+
+	// none after unwatch() returned
+	std::this_thread::sleep_for(std::chrono::milliseconds(120));
+	CHECK(edges == seen);
+	return 0;
+}
+
+// Pins deleted while the edge thread waits for their next edge: the
+// thread must not touch them afterwards.
+static int test_delete_while_waiting(Hal *hal)
+{
+	std::atomic<int> edges(0);
+
+	for (int i = 0; i < 20; i++) {
+		HalGpio *pin = hal->gpio(TEST_PIN);
+		CHECK(pin != NULL);
+		CHECK(pin->watch(HAL_EDGE_BOTH, count_edge, &edges));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		delete pin;
+	}
+	// past the edges the deleted pins were waiting for
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(edges == 0);
+	return 0;
+}
+
+int main()
+{
+	std::unique_ptr<Hal> hal(create_hal());
+
+	CHECK(hal != nullptr);
+	if (test_edges(hal.get()) || test_delete_while_waiting(hal.get()))
+		return 1;
+
+	printf("hal_sim_test passed\n");
+	return 0;
+}
@@ -0,0 +1,74 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#include <algorithm>
+#include "notify_mux.h"
+#include "ocstack.h"
+
+// notifyListOfObservers takes at most this many ids at once
+#define NOTIFY_MAX_IDS 255
+
+NotifyMux::NotifyMux() : m_version(0)
+{
+}
+
+EncodedRepresentation NotifyMux::encode(uint64_t version,
+	const std::function<OC::OCRepresentation()> &build)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_encoded && m_version == version)
+			return m_encoded;
+	}
+
+	// encoded outside the lock; a racing notifier of the same version
+	// at worst encodes it twice
+	EncodedRepresentation encoded = std::make_shared<const std::string>(
+		build().getJSONRepresentation());
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_version = version;
+	m_encoded = encoded;
+	return encoded;
+}
+
+OCStackResult NotifyMux::notify(OCResourceHandle handle, const OC::ObservationIds &observers,
+	uint64_t version, const std::function<OC::OCRepresentation()> &build,
+	OC::QualityOfService qos)
+{
+	OCStackResult result = OC_STACK_NO_OBSERVERS;
+
+	if (observers.empty())
+		return result;
+
+	EncodedRepresentation encoded = encode(version, build);
+	// the stack only reads the payload and the ids
+	unsigned char *payload = (unsigned char *)const_cast<char *>(encoded->c_str());
+	OCObservationId *ids = const_cast<OCObservationId *>(observers.data());
+
+	for (size_t sent = 0; sent < observers.size(); sent += NOTIFY_MAX_IDS) {
+		size_t count = std::min<size_t>(observers.size() - sent, NOTIFY_MAX_IDS);
+		OCStackResult part = OCNotifyListOfObservers(handle, ids + sent, (uint8_t)count,
+			payload, static_cast<OCQualityOfService>(qos));
+		if (part != OC_STACK_NO_OBSERVERS)
+			result = part;
+	}
+	return result;
+}
@@ -0,0 +1,59 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef NOTIFY_MUX_H_
+#define NOTIFY_MUX_H_
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "OCApi.h"
+
+// A representation as sent to observers. Immutable once encoded, so one
+// buffer serves every observer and every resource it goes out on.
+typedef std::shared_ptr<const std::string> EncodedRepresentation;
+
+// NotifyMux fans one published state out to observers. The state is
+// encoded once per version; notifying again at the same version, from
+// this resource or any other resource that shares the mux, sends the
+// same buffer without building an OCResourceResponse or serializing the
+// representation again.
+class NotifyMux
+{
+	public:
+	NotifyMux();
+
+	// The encoding of 'version'; 'build' is only called when that
+	// version has not been encoded yet.
+	EncodedRepresentation encode(uint64_t version, const std::function<OC::OCRepresentation()> &build);
+
+	// Sends 'version' to 'observers' of 'handle'.
+	OCStackResult notify(OCResourceHandle handle, const OC::ObservationIds &observers, uint64_t version,
+			const std::function<OC::OCRepresentation()> &build, OC::QualityOfService qos);
+
+	private:
+	std::mutex m_lock;
+	uint64_t m_version;
+	EncodedRepresentation m_encoded;
+};
+
+#endif /* NOTIFY_MUX_H_ */
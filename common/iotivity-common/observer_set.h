@@ -0,0 +1,102 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+#ifndef OBSERVER_SET_H_
+#define OBSERVER_SET_H_
+
+#include <stdint.h>
+#include <vector>
+#include "OCApi.h"
+
+// The observers of a resource. The ids are kept packed in an
+// ObservationIds vector, so the set can be handed to notifyListOfObservers
+// as it is, and a table indexed by id holds each one's position in it.
+// Adding, removing and looking up an observer are O(1); removing moves
+// the last id into the hole. Registering an id twice keeps one entry.
+//
+// Observation ids are small integers handed out by the stack, which
+// keeps the table small. Not thread safe; callers lock as they would
+// around their ObservationIds.
+class ObserverSet
+{
+	public:
+	typedef OC::ObservationIds::value_type id_type;
+
+	// Returns false when 'id' was already in the set.
+	bool add(id_type id)
+	{
+		size_t index = id;
+
+		if (index >= m_position.size())
+			m_position.resize(index + 1, 0);
+		else if (m_position[index])
+			return false;
+
+		m_ids.push_back(id);
+		m_position[index] = m_ids.size();
+		return true;
+	}
+
+	// Returns false when 'id' was not in the set.
+	bool remove(id_type id)
+	{
+		size_t index = id;
+
+		if (index >= m_position.size() || !m_position[index])
+			return false;
+
+		uint32_t position = m_position[index] - 1;
+		id_type last = m_ids.back();
+		m_ids[position] = last;
+		m_position[(size_t)last] = position + 1;
+		m_ids.pop_back();
+		m_position[index] = 0;
+		return true;
+	}
+
+	bool contains(id_type id) const
+	{
+		size_t index = id;
+
+		return index < m_position.size() && m_position[index];
+	}
+
+	void clear()
+	{
+		for (id_type id : m_ids)
+			m_position[(size_t)id] = 0;
+		m_ids.clear();
+	}
+
+	size_t size() const { return m_ids.size(); }
+	bool empty() const { return m_ids.empty(); }
+
+	OC::ObservationIds::const_iterator begin() const { return m_ids.begin(); }
+	OC::ObservationIds::const_iterator end() const { return m_ids.end(); }
+
+	const OC::ObservationIds &ids() const { return m_ids; }
+
+	private:
+	OC::ObservationIds m_ids;
+	// position in m_ids plus one, 0 when absent
+	std::vector<uint32_t> m_position;
+};
+
+#endif /* OBSERVER_SET_H_ */
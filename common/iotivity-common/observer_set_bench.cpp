@@ -0,0 +1,128 @@
+//******************************************************************
+//
+// Copyright 2014 Intel Mobile Communications GmbH All Rights Reserved.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+// ObserverSet against the ObservationIds vectors it replaced, built with
+// "scons TESTS=1" from the gateway and run on the host. A thousand
+// observers are spread over four resources, as many as the 8 bit
+// observation ids of one resource allow, and come and go at random,
+// some registering twice. The vectors are searched with std::find
+// before adding and compacted with erase(remove(...)) on removal. Both
+// must end up with the same observers.
+//
+//	observer_set_bench [operations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include "observer_set.h"
+
+#define BENCH_RESOURCES 4
+#define BENCH_OBSERVERS_PER_RESOURCE 250
+#define BENCH_OPERATIONS 2000000
+#define BENCH_SEED 2014
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct operation
+{
+	int resource;
+	OC::OCObservationId id;
+	bool add;
+};
+
+static double elapsed_ns(bench_clock::time_point start, int count)
+{
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / count;
+}
+
+int main(int argc, char *argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_OPERATIONS;
+	std::mt19937 random(BENCH_SEED);
+	std::vector<operation> operations;
+	ObserverSet sets[BENCH_RESOURCES];
+	OC::ObservationIds vectors[BENCH_RESOURCES];
+	unsigned long notified = 0;
+
+	if (count <= 0)
+		count = BENCH_OPERATIONS;
+
+	// everybody observes, then the churn
+	for (int r = 0; r < BENCH_RESOURCES; r++)
+		for (int i = 0; i < BENCH_OBSERVERS_PER_RESOURCE; i++)
+			operations.push_back(operation{r, (OC::OCObservationId)i, true});
+	while ((int)operations.size() < count)
+		operations.push_back(operation{(int)(random() % BENCH_RESOURCES),
+			(OC::OCObservationId)(random() % BENCH_OBSERVERS_PER_RESOURCE), random() % 2 == 0});
+
+	bench_clock::time_point start = bench_clock::now();
+	for (auto &op : operations) {
+		if (op.add)
+			sets[op.resource].add(op.id);
+		else
+			sets[op.resource].remove(op.id);
+	}
+	double set_ns = elapsed_ns(start, operations.size());
+
+	start = bench_clock::now();
+	for (auto &op : operations) {
+		OC::ObservationIds &ids = vectors[op.resource];
+		if (op.add) {
+			if (std::find(ids.begin(), ids.end(), op.id) == ids.end())
+				ids.push_back(op.id);
+		}
+		else {
+			ids.erase(std::remove(ids.begin(), ids.end(), op.id), ids.end());
+		}
+	}
+	double vector_ns = elapsed_ns(start, operations.size());
+
+	// a notification walks every observer of every resource
+	const int notifications = 10000;
+	start = bench_clock::now();
+	for (int n = 0; n < notifications; n++)
+		for (auto &set : sets)
+			for (OC::OCObservationId id : set)
+				notified += id;
+	double walk_ns = elapsed_ns(start, notifications);
+
+	size_t observers = 0;
+	for (int r = 0; r < BENCH_RESOURCES; r++) {
+		std::set<OC::OCObservationId> expected(vectors[r].begin(), vectors[r].end());
+		std::set<OC::OCObservationId> actual(sets[r].begin(), sets[r].end());
+		if (expected != actual || actual.size() != sets[r].size()) {
+			fprintf(stderr, "resource %d: the set and the vector hold different observers\n", r);
+			return 1;
+		}
+		observers += sets[r].size();
+	}
+
+	printf("%d resources, %d observers each at first, %d operations\n",
+		BENCH_RESOURCES, BENCH_OBSERVERS_PER_RESOURCE, (int)operations.size());
+	printf("ObserverSet      %8.1f ns/operation\n", set_ns);
+	printf("find/erase-remove %7.1f ns/operation\n", vector_ns);
+	printf("walk %d observers %7.1f ns/notification\n", (int)observers, walk_ns);
+	// keeps the walk from being optimised away
+	fprintf(stderr, "checksum %lu\n", notified);
+	return 0;
+}